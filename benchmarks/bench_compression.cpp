@@ -0,0 +1,91 @@
+/**
+ * \brief Compares querying an endpoint with and without compression.
+ * 
+ * For each mode, the endpoint is queried several times on one Client and the response is parsed
+ * into Tables. The bytes on the wire, the bytes after decoding, and the median times of the query
+ * and of the whole run are printed for each mode.
+ * 
+ * Usage: compression_benchmark endpoint [repeats]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "client.hpp"
+#include "data_objects.hpp"
+#include "tables.hpp"
+
+namespace
+{
+/**
+ * \brief Returns the median of the samples
+*/
+double median(std::vector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+/**
+ * \brief Queries the endpoint repeatedly and prints the results for one mode
+ * 
+ * \returns false if any query failed
+*/
+bool run(const char* endpoint, bool compressed, int repeats)
+{
+    Client client(endpoint, compressed);
+    std::vector<double> query_seconds;
+    std::vector<double> total_seconds;
+
+    for (int i_repeat = 0; i_repeat < repeats; i_repeat++)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        client.query_endpoint();
+        if (client.get_error() != Client::ErrorType::NONE)
+        {
+            std::cerr << "Query failed" << std::endl;
+            return false;
+        }
+
+        Tables tables;
+        DataObjects json_objects(std::string(client.get_response()));
+        std::vector<Record> batch;
+        while (json_objects.next_batch(batch))
+        {
+            tables.add_records(batch.data(), batch.size());
+            batch.clear();
+        }
+
+        query_seconds.push_back(client.get_transfer_stats().seconds);
+        total_seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    const auto& stats = client.get_transfer_stats();
+    std::cout << (compressed ? "compressed" : "plain     ");
+    std::cout << "  wire bytes: " << stats.bytes_on_wire;
+    std::cout << "  decoded bytes: " << stats.bytes_decoded;
+    std::cout << "  median query: " << median(query_seconds) << " s";
+    std::cout << "  median total: " << median(total_seconds) << " s" << std::endl;
+    return true;
+}
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " endpoint [repeats]" << std::endl;
+        return 1;
+    }
+    const int repeats = (argc > 2) ? std::max(1, std::atoi(argv[2])) : 5;
+
+    if (!run(argv[1], false, repeats) || !run(argv[1], true, repeats))
+    {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * \brief Measures the insert and lookup throughput of FlatHashMap against the standard maps.
+ *
+ * The maps are filled the way Tables fills its index of citizen ids: a number of ids are inserted,
+ * each mapped to its row, and then each is looked up in a shuffled order. The string keys are looked
+ * up the way SymbolTable interns the strings of the records: a few hundred distinct strings, each
+ * looked up many times. Millions of operations per second are printed for each map.
+ *
+ * Usage: hash_map_benchmark [entries]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "flat_hash_map.hpp"
+
+namespace
+{
+constexpr size_t N_STRINGS = 300;           /// Number of distinct strings, about as many as the names, cities and hobbies
+constexpr size_t STRING_LOOKUPS = 20000000; /// Number of lookups of the strings
+
+/**
+ * \brief Generator of pseudo-random numbers from a fixed seed, so every run is the same
+*/
+class Random
+{
+public:
+    size_t below(size_t n)
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>(m_state >> 33) % n;
+    }
+
+private:
+    uint64_t m_state = 1;
+};
+
+/**
+ * \brief Returns millions of operations per second
+*/
+double mops(size_t n_ops, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+    return n_ops / std::chrono::duration<double>(end - start).count() / 1e6;
+}
+
+/**
+ * \brief Inserts the ids into a map, mapped to their position, then looks each up in the lookup order
+*/
+template <typename Map>
+void bench_ids(const char* name, const std::vector<unsigned int>& ids, const std::vector<unsigned int>& lookups)
+{
+    Map map;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i_id = 0; i_id < ids.size(); i_id++)
+    {
+        map.emplace(ids[i_id], static_cast<unsigned int>(i_id));
+    }
+    const auto inserted = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (const unsigned int id : lookups)
+    {
+        sum += map.find(id)->second;
+    }
+    const auto looked_up = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(48) << name
+              << "  insert: " << std::setw(8) << mops(ids.size(), start, inserted) << " M/s"
+              << "  lookup: " << std::setw(8) << mops(lookups.size(), inserted, looked_up) << " M/s"
+              << "  (" << sum << ")" << std::endl;
+}
+
+/**
+ * \brief Looks up the strings in the lookup order, inserting each the first time it is seen
+*/
+template <typename Map>
+void bench_strings(const char* name, const std::vector<std::string>& strings, const std::vector<unsigned int>& lookups)
+{
+    Map map;
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t sum = 0;
+    for (const unsigned int i_string : lookups)
+    {
+        const std::string_view key(strings[i_string]);
+        auto existing = map.find(key);
+        if (existing == map.end())
+        {
+            existing = map.emplace(key, static_cast<unsigned int>(map.size())).first;
+        }
+        sum += existing->second;
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    std::cout << std::left << std::setw(48) << name
+              << "  lookup: " << std::setw(8) << mops(lookups.size(), start, end) << " M/s"
+              << "  (" << sum << ")" << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const long n_entries = (argc > 1) ? std::atol(argv[1]) : 10000000;
+    if (n_entries <= 0)
+    {
+        std::cerr << "Usage: " << argv[0] << " [entries]" << std::endl;
+        return 1;
+    }
+
+    // Ids in the order of a response, mostly running on from each other, then looked up in any order
+    Random random;
+    std::vector<unsigned int> ids(n_entries);
+    for (size_t i_id = 0; i_id < ids.size(); i_id++)
+    {
+        ids[i_id] = static_cast<unsigned int>(600000 + i_id);
+    }
+    std::vector<unsigned int> lookups(ids);
+    for (size_t i_id = lookups.size() - 1; i_id > 0; i_id--)
+    {
+        std::swap(lookups[i_id], lookups[random.below(i_id + 1)]);
+    }
+
+    std::cout << n_entries << " citizen ids" << std::endl;
+    bench_ids<std::map<unsigned int, unsigned int>>("std::map<unsigned int, unsigned int>", ids, lookups);
+    bench_ids<std::unordered_map<unsigned int, unsigned int>>("std::unordered_map<unsigned int, unsigned int>", ids, lookups);
+    bench_ids<FlatHashMap<unsigned int, unsigned int>>("FlatHashMap<unsigned int, unsigned int>", ids, lookups);
+
+    std::vector<std::string> strings(N_STRINGS);
+    for (size_t i_string = 0; i_string < strings.size(); i_string++)
+    {
+        strings[i_string] = "String " + std::to_string(i_string * 7919);
+    }
+    std::vector<unsigned int> string_lookups(STRING_LOOKUPS);
+    for (auto& i_string : string_lookups)
+    {
+        i_string = static_cast<unsigned int>(random.below(N_STRINGS));
+    }
+
+    std::cout << N_STRINGS << " strings" << std::endl;
+    bench_strings<std::map<std::string_view, unsigned int>>("std::map<std::string_view, Symbol>", strings, string_lookups);
+    bench_strings<std::unordered_map<std::string_view, unsigned int>>("std::unordered_map<std::string_view, Symbol>", strings, string_lookups);
+    bench_strings<FlatHashMap<std::string_view, unsigned int>>("FlatHashMap<std::string_view, Symbol>", strings, string_lookups);
+    return 0;
+}
@@ -0,0 +1,169 @@
+/**
+ * \brief Measures the memory and time taken by the tables for a synthetic data set.
+ *
+ * Records like those of the endpoint are generated a batch at a time, from a few dozen names,
+ * cities and hobbies, and added to Tables. The resident memory of the process is printed before
+ * and after, with the times taken to add the records and to query the tables. The records are
+ * generated from a fixed seed, so every run adds the same records.
+ *
+ * Given a number of shards, the records are added to ShardedTables instead, which adds each shard's
+ * part of a batch on a thread of its own while the next batch is generated.
+ *
+ * Usage: tables_benchmark [records] [shards]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data_objects.hpp"
+#include "sharded_tables.hpp"
+#include "tables.hpp"
+
+namespace
+{
+const char* const NAMES[] = {
+    "Elijah", "Charlotte", "Nora", "Luke", "Barry", "Morris", "Robin", "Paul", "John", "George",
+    "Ringo", "Yoko", "Olivia", "Emma", "Amelia", "Sophia", "Isabella", "Mia", "Evelyn", "Harper",
+    "Liam", "Noah", "Oliver", "James", "William", "Benjamin", "Lucas", "Henry", "Theodore", "Jack",
+    "Levi", "Alexander", "Jackson", "Mateo", "Daniel", "Michael", "Mason", "Sebastian", "Ethan", "Logan",
+};
+const char* const CITIES[] = {
+    "Palm Springs", "Washington", "Las Vegas", "San Francisco", "Los Angeles", "New York City",
+    "Chicago", "Houston", "Phoenix", "Philadelphia", "San Antonio", "San Diego", "Dallas", "Austin",
+    "Jacksonville", "Fort Worth", "Columbus", "Charlotte", "Indianapolis", "Seattle", "Denver",
+    "Nashville", "Oklahoma City", "El Paso", "Boston", "Portland", "Louisville", "Memphis",
+    "Detroit", "Baltimore",
+};
+const char* const HOBBIES[] = {
+    "Reading", "Walking", "Shopping", "Bicycling", "Fishing", "Calligraphy", "Martial Arts",
+    "Movie Watching", "Golf", "Television", "Video Games", "Woodworking", "Housework", "Music",
+    "Painting", "Genealogy", "Skiing", "Running", "Team Sports", "Jewelry Making",
+};
+
+template <typename T, size_t N>
+constexpr size_t count(const T (&)[N])
+{
+    return N;
+}
+
+/**
+ * \brief Generator of pseudo-random numbers from a fixed seed, so every run is the same
+*/
+class Random
+{
+public:
+    size_t below(size_t n)
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>(m_state >> 33) % n;
+    }
+
+private:
+    uint64_t m_state = 1;
+};
+
+/**
+ * \brief Returns the resident memory of this process in KiB
+*/
+long resident_kib()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmRSS:") == 0)
+        {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Fills the batch with the next records
+*/
+void generate(Random& random, int first_id, size_t n_records, std::vector<Record>& batch)
+{
+    batch.resize(n_records);
+    for (size_t i_record = 0; i_record < n_records; i_record++)
+    {
+        Record& record = batch[i_record];
+        record.has_id = true;
+        record.id = first_id + static_cast<int>(i_record);
+        record.name = NAMES[random.below(count(NAMES))];
+        record.age = static_cast<int>(random.below(100));
+        record.city = CITIES[random.below(count(CITIES))];
+        record.friends.resize(random.below(5));
+        for (auto& f : record.friends)
+        {
+            f.name = NAMES[random.below(count(NAMES))];
+            f.hobbies.clear();
+            for (size_t i_hobby = 1 + random.below(3); i_hobby > 0; i_hobby--)
+            {
+                f.hobbies.push_back(HOBBIES[random.below(count(HOBBIES))]);
+            }
+        }
+    }
+}
+
+/**
+ * \brief Adds the records to the tables as a single update, then queries them, printing the memory and times taken
+*/
+template <typename AnyTables>
+void run(AnyTables& tables, long n_records)
+{
+    Random random;
+    std::vector<Record> batch;
+    generate(random, 0, DataObjects::DEFAULT_BATCH_SIZE, batch);
+    const long before_kib = resident_kib();
+
+    const auto start = std::chrono::steady_clock::now();
+    tables.begin_update();
+    for (long first_id = 0; first_id < n_records; first_id += DataObjects::DEFAULT_BATCH_SIZE)
+    {
+        const size_t n_batch = static_cast<size_t>(std::min<long>(DataObjects::DEFAULT_BATCH_SIZE, n_records - first_id));
+        generate(random, static_cast<int>(first_id), n_batch, batch);
+        tables.add_records(batch.data(), batch.size());
+    }
+    tables.end_update();
+    const auto added = std::chrono::steady_clock::now();
+    const Results results = tables.query_results();
+    const auto queried = std::chrono::steady_clock::now();
+    const long after_kib = resident_kib();
+
+    std::cout << "records: " << n_records;
+    std::cout << "  tables: " << (after_kib - before_kib) / 1024 << " MiB";
+    std::cout << "  add: " << std::chrono::duration<double>(added - start).count() << " s";
+    std::cout << "  query: " << std::chrono::duration<double>(queried - added).count() << " s";
+    std::cout << "  most common hobby: " << results.most_common_hobby << std::endl;
+}
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    const long n_records = (argc > 1) ? std::atol(argv[1]) : 10000000;
+    const long n_shards = (argc > 2) ? std::atol(argv[2]) : 0;
+    if ((n_records <= 0) || (n_shards < 0))
+    {
+        std::cerr << "Usage: " << argv[0] << " [records] [shards]" << std::endl;
+        return 1;
+    }
+
+    if (n_shards == 0)
+    {
+        Tables tables;
+        run(tables, n_records);
+    }
+    else
+    {
+        ShardedTables tables(static_cast<unsigned int>(n_shards));
+        run(tables, n_records);
+    }
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <curl/curl.h>
+
+#include "data_objects.hpp"
+
+/**
+ * \brief Checks made on the start of a response, before any of it is passed on
+ *
+ * The HTTP status and the first bytes of the response are checked, so that an error page is abandoned
+ * on its first chunk rather than downloaded in full and then failing to parse. Client and MultiClient
+ * share these checks, each reporting them with its own ErrorType, which has NONE, HTTP_STATUS and
+ * NON_JSON_BODY.
+*/
+template <typename ErrorType>
+struct BodyCheck
+{
+    CURL* curl;         /// Handle of the transfer
+    bool passed;        /// Set once the response is known to be json; later chunks are not checked
+    ErrorType error;    /// Set if the checks failed and the transfer was aborted
+
+    /**
+     * \brief Checks a chunk of the response, unless an earlier chunk has already passed
+     *
+     * \returns false if the transfer should be aborted
+    */
+    bool check_chunk(const char* data, size_t size)
+    {
+        if (passed)
+        {
+            return true;
+        }
+
+        long response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        if ((response_code < 200) || (response_code >= 300))
+        {
+            error = ErrorType::HTTP_STATUS;
+            return false;
+        }
+
+        switch (DataObjects::classify_start(data, size))
+        {
+        case DataObjects::BodyStart::JSON:
+            passed = true;
+            return true;
+        case DataObjects::BodyStart::NOT_JSON:
+            error = ErrorType::NON_JSON_BODY;
+            return false;
+        default:
+            // Only whitespace so far
+            return true;
+        }
+    }
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+/**
+ * \brief Bounded queue for handing chunks of the response from one thread to another
+ *
+ * The producer (the curl write callback) blocks when the queue is full, so a slow consumer
+ * applies back pressure to the download rather than the whole response being buffered.
+*/
+class ChunkQueue
+{
+public:
+    /**
+     * \brief Constructor
+     *
+     * \param capacity: Maximum number of chunks held before push() blocks
+    */
+    ChunkQueue(size_t capacity);
+
+    /**
+     * \brief Adds a chunk to the queue, waiting for space if the queue is full
+     *
+     * \returns false if the queue has been closed, in which case the chunk is discarded
+    */
+    bool push(std::string &&chunk);
+
+    /**
+     * \brief Removes the oldest chunk from the queue, waiting for one if the queue is empty
+     *
+     * \param chunk: Receives the chunk
+     *
+     * \returns false once the queue has been closed and all chunks have been consumed
+    */
+    bool pop(std::string &chunk);
+
+    /**
+     * \brief Closes the queue
+     *
+     * The producer calls this at the end of the stream. The consumer may call this to stop
+     * the producer early, eg. if the data cannot be parsed. Any blocked push() or pop() is woken.
+    */
+    void close();
+
+private:
+    const size_t m_capacity;            /// Maximum number of chunks in the queue
+    std::deque<std::string> m_chunks;   /// Chunks waiting to be consumed
+    bool m_closed;                      /// Set once no further chunks will be accepted
+    std::mutex m_mutex;                 /// Protects all of the above
+    std::condition_variable m_not_full; /// Signalled when a chunk is removed, or the queue is closed
+    std::condition_variable m_not_empty;/// Signalled when a chunk is added, or the queue is closed
+};
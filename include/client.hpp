@@ -1,10 +1,20 @@
 #pragma once
 
+#include <chrono>
+#include <random>
+#include <string>
+
+#include "response_cache.hpp"
+
 typedef void CURL; /// Forward delcaration
+typedef void CURLM; /// Forward delcaration
+class ChunkQueue;
 
 /**
  * \brief Implementation to connect to client and return the text data.
  * 
+ * The curl handle lives as long as the Client, so repeated queries reuse its connection to the
+ * endpoint rather than setting up a new one each time.
 */
 class Client
 {
@@ -13,22 +23,99 @@ public:
      * \brief Constructor
      * 
      * \param endpoint: Connect to this endpoint
+     * \param compressed: Offer every content encoding curl supports (eg. gzip), which curl decodes
+     * as the response arrives, so callers always receive the plain text
     */
-    Client(const char* endpoint);
+    Client(const char* endpoint, bool compressed = true);
 
     /**
      * \brief Destructor
     */
     ~Client();
 
+    /**
+     * \brief How failed queries are retried, and when a second request is sent for a slow one
+    */
+    struct RetryPolicy
+    {
+        int max_attempts = 1;                               /// Attempts per query, including the first; 1 disables retries
+        std::chrono::milliseconds initial_backoff{100};     /// Bound on the wait before the first retry; doubled for each retry after
+        std::chrono::milliseconds max_backoff{5000};        /// Bound on the wait before any retry
+        std::chrono::milliseconds hedge_after{0};           /// If non-zero, query_endpoint() sends a second request when the first has taken this long
+    };
+
+    /**
+     * \brief Sets how failed queries are retried
+     * 
+     * Transport failures, 5xx, 408 and 429 statuses and bodies which aren't json are retried, after
+     * waiting for a random time up to a bound which grows exponentially with each retry. Other
+     * errors would only recur, so are returned straight away.
+     * 
+     * With hedging enabled, query_endpoint() sends a second, identical request if the first hasn't
+     * finished within hedge_after, and keeps whichever response arrives first in full. This cuts
+     * the tail latency caused by a stalled connection, at the cost of sometimes downloading twice.
+     * Hedging doesn't apply to query_endpoint(ChunkQueue&) or to the ranges of a ranged query.
+    */
+    void set_retry_policy(const RetryPolicy &policy);
+
+    /**
+     * \brief Sets the cache of responses used by query_endpoint()
+     * 
+     * If the endpoint's response is cached, the query is made conditional on it having changed,
+     * using its ETag or Last-Modified date. On a 304 Not Modified, get_response() returns the
+     * cached body and is_not_modified() returns true. A response which arrives in full is cached
+     * if the server sent either validator. The cache doesn't apply to query_endpoint(ChunkQueue&)
+     * or query_endpoint_ranged(), and a hedged request is never conditional.
+     * 
+     * \param cache: Cache of responses, which must outlive the queries; nullptr disables caching
+    */
+    void set_cache(ResponseCache* cache);
+
     /**
      * \brief Connects to the endpoint and acquires the text data.
      * 
+     * The status and the first bytes of the response are checked as soon as they arrive. An error
+     * status or a body which isn't json aborts the transfer straight away, with error HTTP_STATUS
+     * or NON_JSON_BODY respectively.
+     * 
      * This will set the error, which should be checked using get_error().
      * If that is ErrorType::NONE, then the buffer can be acquired using get_response().
     */
     void query_endpoint();
 
+    /**
+     * \brief Connects to the endpoint and streams the text data into a queue as it arrives.
+     * 
+     * Each chunk received is pushed onto the queue, blocking while the queue is full. The queue
+     * is closed when the transfer ends, whether or not it was successful. If the consumer closes
+     * the queue first, the transfer is aborted. A failed query is only retried if nothing has
+     * been pushed onto the queue yet. The error should be checked using get_error()
+     * once the queue has been drained. get_response() is not populated by this call. The start of
+     * the response is checked as for query_endpoint(), so no chunk of an error page is pushed.
+     * 
+     * \param queue: Queue to receive the chunks of the response
+    */
+    void query_endpoint(ChunkQueue &queue);
+
+    static constexpr size_t MIN_RANGE_SEGMENT_SIZE = 64 * 1024; /// Smallest segment worth its own connection
+
+    /**
+     * \brief Connects to the endpoint and acquires the text data over several connections in parallel.
+     * 
+     * A HEAD request determines the size of the response, which is then split into contiguous
+     * segments, each requested with an HTTP Range header on its own connection. The segments are
+     * written straight into their place in the response buffer. If the server doesn't advertise
+     * "Accept-Ranges: bytes", or the size is unknown, or any segment fails, this falls back to
+     * query_endpoint(). The segments are requested without compression, since a range of a
+     * compressed response cannot be decoded on its own.
+     * 
+     * This will set the error, which should be checked using get_error().
+     * If that is ErrorType::NONE, then the buffer can be acquired using get_response().
+     * 
+     * \param n_segments: Maximum number of segments to request in parallel
+    */
+    void query_endpoint_ranged(size_t n_segments);
+
     /**
      * \brief Returns the buffer acquired from the endpoint
      * 
@@ -36,13 +123,37 @@ public:
     */
     const std::string &get_response() const;
 
+    /**
+     * \brief Returns true if the endpoint responded to the last query that the cached response
+     * hasn't changed, in which case get_response() is the cached body
+    */
+    bool is_not_modified() const;
+
+    /**
+     * \brief Statistics of a query
+    */
+    struct TransferStats
+    {
+        size_t bytes_on_wire = 0;   /// Bytes of the body as received, before decoding
+        size_t bytes_decoded = 0;   /// Bytes of the body after decoding
+        double seconds = 0;         /// Time taken by the query, including any HEAD request and retries
+        int n_requests = 0;         /// Number of requests sent, including retries and hedged requests
+    };
+
+    /**
+     * \brief Returns the statistics of the last query
+    */
+    const TransferStats &get_transfer_stats() const;
+
     /**
      * \brief Error codes associated with this class
     */
     enum class ErrorType {
-        NONE,       /// No error
-        INIT,       /// Initialising connection failed
-        QUERY,      /// Failed to query the endpoint
+        NONE,           /// No error
+        INIT,           /// Initialising connection failed
+        QUERY,          /// Failed to query the endpoint
+        HTTP_STATUS,    /// The endpoint responded with a status other than 2xx
+        NON_JSON_BODY,  /// The response doesn't start with a json object or array, eg. an HTML error page
     };
 
     /**
@@ -52,8 +163,63 @@ public:
 protected:
 
 private:
+    /**
+     * \brief Queries the endpoint into m_response, retrying as set by the policy
+    */
+    void query_with_retries();
+
+    /**
+     * \brief Queries the endpoint into m_response, sending a second request if the first is slow
+    */
+    void query_hedged();
+
+    /**
+     * \brief Returns true if the last error may not recur
+    */
+    bool is_retryable() const;
+
+    /**
+     * \brief Waits before a retry, for a random time up to the bound for this attempt
+    */
+    void wait_before_retry(int attempt);
+
+    /**
+     * \brief Performs the request using the write callback already set on m_curl
+     * 
+     * Records the bytes received and the time taken in m_stats. The caller records the bytes decoded.
+     * 
+     * \param rejected: Set by the write callback if it aborted the transfer after checking the
+     * start of the response
+    */
+    void perform_query(const ErrorType &rejected);
+
+    /**
+     * \brief Requests the segments of a response of known size in parallel into m_response
+     * 
+     * \returns NONE if every segment was received in full, HTTP_STATUS or NON_JSON_BODY if the
+     * first segment was rejected, otherwise QUERY
+    */
+    ErrorType query_ranges(size_t content_length, size_t n_segments);
+
+    /**
+     * \brief Queries the endpoint, conditional on the cached response having changed
+     * 
+     * On a 304, m_response is loaded from the cache. A new response is stored in the cache.
+    */
+    void query_conditional();
+
     CURL* m_curl;                   /// CURL object for performing the query
+    CURLM* m_multi;                 /// CURL multi object for hedged queries; created when first needed
     const std::string m_enpoint;    /// Endpoint to query
+    const bool m_compressed;        /// Whether compressed responses are accepted
+    RetryPolicy m_policy;           /// How failed queries are retried
+    std::minstd_rand m_random;      /// Source of the jitter in the waits before retries
+    ResponseCache* m_cache;         /// Cache of responses; nullptr if not caching
+    bool m_conditional;             /// Set while a conditional query is being made, so a 304 isn't an error
+    bool m_not_modified;            /// The last query was answered with 304 Not Modified
+    ResponseCache::Validators m_validators; /// Validators sent with the last response, if it is to be cached
+    TransferStats m_stats;          /// Statistics of the last query
     std::string m_response;         /// Response from querying endpoint
+    long m_response_code;           /// HTTP status of the last response
     ErrorType m_error;              /// Last error encountered
 };
\ No newline at end of file
@@ -1,24 +1,95 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 #include <rapidjson/document.h>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include "query_tables.hpp"
 
 /**
  * \brief Splits the json response into individual records for easy processing
  * 
  * This class uses rapidjson to output each record acquired from the endpoint.
+ * The response can either be passed in full to the constructor, or pushed in
+ * chunks as it arrives using feed() and finish(). When fed in chunks, records
+ * are returned as soon as they are complete, and the buffer only needs to hold
+ * the data that has not been returned yet.
+ * 
+ * The elements of an array at the top level of the response are found and parsed
+ * one at a time, so however large the array, only one record is parsed at once.
 */
 class DataObjects
 {
 public:
+    static constexpr size_t DEFAULT_ARENA_SIZE = 64 * 1024; /// Default number of bytes in which each block is parsed
+    static constexpr size_t DEFAULT_BATCH_SIZE = 1024;      /// Default number of records gathered by next_batch()
+
     /**
      * \brief Constructor
      * 
-     * This class takes ownership of the buffer.
+     * This class takes ownership of the buffer. The records are parsed in place, so the strings
+     * of the values returned by get_next_object() point into this buffer.
      * 
      * \param json: buffer expected to be in json format - the result of querying the endpoint
+     * \param arena_size: Number of bytes set aside for the values of each block. A block needing
+     * more is given further chunks of this size, which are freed before the next block.
+    */
+    DataObjects(const std::string &&json, size_t arena_size = DEFAULT_ARENA_SIZE);
+
+    /**
+     * \brief Constructor for a response held elsewhere, eg. in a memory mapped file
+     * 
+     * The data is parsed where it is rather than copied into a buffer, so it must remain valid
+     * and unchanged for the life of this object.
+     * 
+     * \param data: Start of the response
+     * \param size: Number of bytes in the response
+     * \param arena_size: Number of bytes set aside for the values of each block
+    */
+    DataObjects(const char* data, size_t size, size_t arena_size = DEFAULT_ARENA_SIZE);
+
+    /**
+     * \brief Constructor for a response that will arrive in chunks
+     * 
+     * The buffer is initially empty. Chunks are appended with feed(), and finish() is called
+     * once the whole response has been fed.
+     * 
+     * \param arena_size: Number of bytes set aside for the values of each block
+    */
+    explicit DataObjects(size_t arena_size = DEFAULT_ARENA_SIZE);
+
+    /**
+     * \brief Appends a chunk of the response to the buffer
+     * 
+     * \param data: Start of the chunk
+     * \param size: Number of bytes in the chunk
     */
-    DataObjects(const std::string &&json);
+    void feed(const char* data, size_t size);
+
+    /**
+     * \brief Marks the end of the response
+     * 
+     * Until this is called, an incomplete block at the end of the buffer is assumed to be
+     * waiting for more data rather than being ill formatted.
+    */
+    void finish();
+
+    /**
+     * \brief Skips ill formatted json rather than stopping at it
+     * 
+     * By default, the first ill formatted block sets the error and nothing after it is parsed. In
+     * recovery mode, the bytes from the start of the ill formatted json up to the next plausible
+     * start of a record, a brace followed by a key or a closing brace, are skipped instead, and
+     * parsing carries on from there. Each range skipped is logged as a warning through the Logger,
+     * which rate limits them, and kept, see get_skipped(). The response still fails with a FORMAT error if more than the given fraction
+     * of it is skipped, which is known as soon as the whole response is in the buffer.
+     * 
+     * \param max_skipped_fraction: Largest fraction of the response's bytes which may be skipped
+    */
+    void set_recovery(double max_skipped_fraction);
 
     /**
      * \brief Gets the next record from the json response
@@ -28,10 +99,124 @@ public:
      * get_error() if nullptr is returned. Error code NONE means parsing was successful, but there
      * are no more objects. Error code FORMAT means the parsing was unsuccessful.
      * 
+     * If finish() has not yet been called, nullptr with error code NONE may also mean that the
+     * next object is not complete yet. Feed more data and call this again.
+     * 
      * \returns Next json object in the buffer, or nullptr
     */
     const rapidjson::Value* get_next_object();
 
+    /**
+     * \brief Parses the next json block of the response with a SAX handler, rather than into a document
+     * 
+     * The block is found as for get_next_object(), but instead of building values, rapidjson
+     * calls the handler's Null(), Bool(), Int(), String(), StartObject(), Key(), EndObject(),
+     * StartArray(), EndArray() etc. as it reads the block. Strings passed to the handler are only
+     * valid for the duration of the call. Don't mix this with get_next_object() on the same object.
+     * 
+     * Each element of an array at the top level is a block of its own, which the handler is given
+     * between StartArray() and EndArray(). So a handler can tell the records of an array from
+     * records at the top level, without having to keep anything between calls.
+     * 
+     * In recovery mode, a block which fails to parse is skipped, and the handler's reset() is
+     * called so that it forgets the part of the block it has seen, before the next block is parsed.
+     * 
+     * false is returned when get_next_object() would return nullptr, and get_error() is checked in
+     * the same way. A handler may have seen part of a block which then fails to parse.
+     * 
+     * \returns true if a block was parsed
+    */
+    template <typename Handler>
+    bool parse_next_block(Handler &handler)
+    {
+        size_t block_offset;
+        size_t block_length;
+        for (Found found = find_next_block(block_offset, block_length); found != Found::NOTHING;
+             found = find_next_block(block_offset, block_length))
+        {
+            // An element of an array at the top level is parsed on its own, so it's put in an array of its own
+            if (found == Found::ELEMENT)
+            {
+                handler.StartArray();
+            }
+
+            // The reader's stack is taken from the same arena as the document's parse stack
+            m_stack_arena->Clear();
+            rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>, Arena> reader(m_stack_arena.get());
+            rapidjson::MemoryStream stream(get_data() + block_offset, block_length);
+            if (!reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, handler).IsError())
+            {
+                if (found == Found::ELEMENT)
+                {
+                    handler.EndArray(1);
+                }
+                return true;
+            }
+
+            if (!handle_parse_error(block_offset, block_length))
+            {
+                return false;
+            }
+            handler.reset();
+        }
+        return false;
+    }
+
+    /**
+     * \brief Parses the next blocks of the response into a batch of validated records
+     * 
+     * Blocks are parsed with a RecordHandler, as for parse_next_block(), until the batch holds at
+     * least n records. Each element of an array at the top level is a block of its own, so the
+     * batch holds at most n records unless an element holds more than one. The batch is meant
+     * for Tables::add_records(), which adds the records more cheaply together than one at a time.
+     * Records which fail validation are counted by get_bad_records().
+     * 
+     * \param batch: Vector to which the valid records are appended
+     * \param n: Number of records after which no more blocks are parsed
+     * \returns false once no more blocks could be parsed and nothing was appended. Check
+     * get_error() as for get_next_object().
+    */
+    bool next_batch(std::vector<Record> &batch, size_t n = DEFAULT_BATCH_SIZE);
+
+    /**
+     * \brief Returns the number of records which have failed validation in next_batch()
+    */
+    int get_bad_records() const;
+
+    /**
+     * \brief How the start of a response compares with what can be parsed
+    */
+    enum class BodyStart {
+        UNKNOWN,    /// Only whitespace so far
+        JSON,       /// Starts with an object or an array
+        NOT_JSON,   /// Starts with anything else, eg. an HTML error page
+    };
+
+    /**
+     * \brief Classifies the start of a response from its first non-whitespace byte
+     * 
+     * This lets the download be abandoned on the first chunk, rather than failing to parse the
+     * whole response once it has arrived.
+     * 
+     * \param data: Start of the response, or of the next chunk if the previous ones were UNKNOWN
+     * \param size: Number of bytes available
+    */
+    static BodyStart classify_start(const char* data, size_t size);
+
+    /**
+     * \brief Bytes of the response which were skipped in recovery mode
+    */
+    struct SkippedRange
+    {
+        size_t begin;   /// Offset of the first byte skipped, from the start of the response
+        size_t end;     /// Offset following the last byte skipped
+    };
+
+    /**
+     * \brief Returns the ranges of the response skipped so far in recovery mode, in order
+    */
+    const std::vector<SkippedRange>& get_skipped() const;
+
     /**
      * \brief Error types associated with this class
     */
@@ -48,8 +233,177 @@ protected:
     ErrorType m_error;                  /// Last error encountered
 
 private:
-    const std::string m_buffer;         /// buffer containing response to be parsed
+    static constexpr size_t PARSE_STACK_SIZE = 16 * 1024; /// Number of bytes set aside for rapidjson's parse stack
+
+    /**
+     * \brief Allocator of the memory for a block, which is reset rather than freed between blocks
+    */
+    typedef rapidjson::MemoryPoolAllocator<> Arena;
+
+    /**
+     * \brief Document whose values and parse stack are both allocated from arenas
+    */
+    typedef rapidjson::GenericDocument<rapidjson::UTF8<>, Arena, Arena> ArenaDocument;
+
+    /**
+     * \brief What find_next_block() found next in the response
+    */
+    enum class Found {
+        NOTHING,    /// No complete block yet, or an error
+        BLOCK,      /// A block at the top level
+        ELEMENT,    /// An element of an array at the top level
+    };
+
+    /**
+     * \brief Where the scan is in an array at the top level, whose elements are found one at a time
+    */
+    enum class ArrayState {
+        NONE,       /// Not in an array
+        FIRST,      /// After the opening bracket, expecting a value or the closing bracket
+        VALUE,      /// After a comma, expecting a value
+        COMMA,      /// After a value, expecting a comma or the closing bracket
+    };
+
+    /**
+     * \brief State of the scan for the next json block
+     * 
+     * This is kept between calls, so that when a block is split across chunks the scan resumes
+     * where it stopped. Offsets are relative to m_last_block_end.
+    */
+    struct ScanState
+    {
+        enum BraceType {BRACE, SQUARE, NONE};
+        BraceType type = NONE;  /// Type of brace which opened the block, or NONE if it hasn't started
+        size_t position = 0;    /// Offset of the next character to scan
+        size_t json_start = 0;  /// Offset of the opening brace of the block
+        int n_brace = 0;        /// Depth of nesting of the braces of this type
+        bool in_quotes = false; /// The scan is inside a string
+        bool escaped = false;   /// The previous character was a backslash escaping the next one
+    };
+
+    /**
+     * \brief Finds the next complete json block, and moves m_last_block_end past it
+     * 
+     * An array at the top level isn't a block itself. Its brackets and commas are skipped, and
+     * each of its elements is found as a block.
+     * 
+     * Sets the error if the response is empty, or its remainder is not json.
+     * 
+     * \param block_offset: Set to the offset of the block in the response being parsed, if one is found
+     * \param block_length: Set to the number of bytes in the block
+     * \returns What was found
+    */
+    Found find_next_block(size_t &block_offset, size_t &block_length);
+
+    /**
+     * \brief Finds the next element of the array at the top level, or else its closing bracket
+     * 
+     * Sets the error if the array is ill formatted, eg. its elements aren't separated by commas,
+     * or it isn't closed by the end of the response.
+     * 
+     * In recovery mode, the scan carries on past ill formatted elements.
+     * 
+     * \returns true if an element was found. false if there is no complete element, in which case
+     * m_array is NONE if the array was closed, or abandoned at the end of the response.
+    */
+    bool find_next_element(size_t &block_offset, size_t &block_length);
+
+    /**
+     * \brief Reports the remainder of the response which is not json, and sets the error
+    */
+    void report_ill_formatted();
+
+    /**
+     * \brief Handles ill formatted json, reporting it as for report_ill_formatted() unless in recovery mode
+     * 
+     * \param skip_from: Offset in the buffer of the first byte to skip in recovery mode
+     * \param search_from: Offset in the buffer from which to search for the next record
+     * \returns true if the scan carries on from the next record, false if the error is set
+    */
+    bool handle_ill_formatted(size_t skip_from, size_t search_from);
+
+    /**
+     * \brief Handles a block which rapidjson failed to parse, reporting it as for report_parse_error() unless in recovery mode
+     * 
+     * In recovery mode the whole block is skipped, since the scan has found where it ends.
+     * 
+     * \returns true if the scan carries on from the next record, false if the error is set
+    */
+    bool handle_parse_error(size_t block_offset, size_t block_length);
+
+    /**
+     * \brief Skips the buffer up to the next plausible start of a record, in recovery mode
+     * 
+     * Records the range skipped, and sets the error if too much of the response has been skipped.
+     * Within an array at the top level, the record found is taken to be the array's next element.
+     * 
+     * \returns false if the error has been set
+    */
+    bool skip_to_next_record(size_t skip_from, size_t search_from);
+
+    /**
+     * \brief Records a range of the buffer as skipped, and warns of it
+    */
+    void add_skipped(size_t begin, size_t end);
+
+    /**
+     * \brief Sets the error if more of the response has been skipped than allowed by set_recovery()
+     * 
+     * This can only be known once the whole response is in the buffer.
+     * 
+     * \returns false if the error has been set
+    */
+    bool check_skipped();
+
+    /**
+     * \brief Reports a block which rapidjson failed to parse, and sets the error
+    */
+    void report_parse_error(size_t block_offset, size_t block_length);
+
+    /**
+     * \brief Scans the buffer from m_last_block_end to identify the next json block
+     * 
+     * The response does not always contain commas between objects. Sometimes the
+     * objects are arrays and sometimes not. This function's responsibility is to
+     * identify the start of a valid object and the end of that object, which will
+     * successfully be parsed by the rapidjson document. So this might find a
+     * single object if the buffer is not organised as an array. If it is organised
+     * as an array at the top level, the scan stops after the opening bracket, with
+     * m_scan.type set to SQUARE, and the elements are found by find_next_element().
+     * Arrays within an element are found whole.
+     * 
+     * \returns true if a complete block, or the opening bracket of an array at the top level, was
+     * found, in which case it is located by m_scan.json_start and m_scan.position. false if the
+     * end of the buffer was reached first.
+    */
+    bool scan_json_block();
+
+    /**
+     * \brief Returns the start of the response being parsed, which is m_view if set, otherwise m_buffer
+    */
+    const char* get_data() const;
+
+    /**
+     * \brief Returns the number of bytes of the response being parsed
+    */
+    size_t get_size() const;
+
+    std::string m_buffer;               /// buffer containing response to be parsed
+    const char* m_view;                 /// Response held elsewhere, parsed in place of m_buffer; nullptr if not used
+    size_t m_view_size;                 /// Number of bytes at m_view
     size_t m_last_block_end;            /// Index determining the current position in the buffer
-    rapidjson::Document m_json_doc;     /// response parsed into rapidjson object
-    size_t m_next_array_index;          /// Index of the current object in the array, if the buffer represents a json array
+    bool m_finished;                    /// True once the whole response is in the buffer
+    size_t m_discarded;                 /// Number of bytes already parsed and removed from the front of the buffer
+    ScanState m_scan;                   /// State of the scan for the block following m_last_block_end
+    std::vector<char> m_value_memory;   /// Memory of m_value_arena, reused for every block
+    std::vector<char> m_stack_memory;   /// Memory of m_stack_arena, reused for every block
+    std::unique_ptr<Arena> m_value_arena;   /// Allocates the values of the current block. On the heap, so it stays put when this object is moved.
+    std::unique_ptr<Arena> m_stack_arena;   /// Allocates the parse stack of the current block
+    ArenaDocument m_json_doc;           /// response parsed into rapidjson object
+    ArrayState m_array;                 /// Where the scan is in an array at the top level
+    bool m_recover;                     /// Skip ill formatted json rather than stopping at it
+    double m_max_skipped_fraction;      /// Largest fraction of the response which may be skipped in recovery mode
+    std::vector<SkippedRange> m_skipped;    /// Ranges of the response skipped in recovery mode
+    size_t m_n_skipped_bytes;           /// Total number of bytes in m_skipped
+    int m_n_bad_records;                /// Number of records which failed validation in next_batch()
 };
\ No newline at end of file
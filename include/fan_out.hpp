@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include "data_objects.hpp"
+#include "multi_client.hpp"
+#include "tables_interface.hpp"
+
+/**
+ * \brief Populates one set of tables from several endpoints queried at the same time
+ * 
+ * Each endpoint's response is split into records by its own DataObjects as the chunks arrive,
+ * and every record is added to the same Tables. The records of an endpoint are only added after
+ * those of every endpoint before it in the list, so the tables are the same as if the responses
+ * had been concatenated in that order, however the transfers are timed. Records without an id
+ * are numbered on from those of the endpoints before, a citizen in the responses of several
+ * endpoints takes the record of the last of them, and of citizens with as many friends as each
+ * other, the first in the concatenated responses is the user with most friends.
+ * 
+ * The records of the first endpoint whose transfer hasn't ended are added as they are parsed.
+ * Those of the endpoints after it are parsed as they arrive, but are held until its turn.
+*/
+class FanOut
+{
+public:
+    /**
+     * \brief Constructor
+     * 
+     * \param client: Client connected to the endpoints
+     * \param tables: Tables to populate with the records in the responses
+    */
+    FanOut(MultiClient& client, TablesInterface& tables);
+
+    /**
+     * \brief Skips ill formatted json rather than stopping at it, as for DataObjects::set_recovery()
+     * 
+     * \param max_skipped_fraction: Largest fraction of each response which may be skipped
+    */
+    void set_recovery(double max_skipped_fraction);
+
+    /**
+     * \brief Queries the endpoints and populates the tables, returning once all are complete
+     * 
+     * This will set the error, which should be checked using get_error().
+    */
+    void run();
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,       /// No error
+        QUERY,      /// The client failed to acquire a response
+        FORMAT,     /// A response contains ill formatted json
+    };
+
+    /**
+     * \brief Returns the error encountered during the last run
+    */
+    ErrorType get_error() const;
+
+    /**
+     * \brief Returns the number of records rejected by the tables during the last run
+    */
+    int get_bad_records() const;
+protected:
+
+private:
+    /**
+     * \brief Adds every record of an endpoint that is complete so far to the tables, or holds them until its turn
+     * 
+     * \returns false if the response is ill formatted
+    */
+    bool add_records(size_t endpoint_index);
+
+    /**
+     * \brief Adds the records held for the endpoints after those whose transfers have ended, in order
+     * 
+     * \param all: Add the records of every endpoint, whether or not the transfers before it have ended
+    */
+    void add_held_records(bool all);
+
+    MultiClient& m_client;                      /// Client used to acquire the responses
+    TablesInterface& m_tables;                  /// Tables populated with the records
+    std::vector<DataObjects> m_json_objects;    /// Parser for the response from each endpoint
+    ErrorType m_error;                          /// Last error encountered
+    int m_n_bad_records;                        /// Number of records rejected by the tables
+    std::vector<Record> m_batch;                /// Records parsed from a chunk, waiting to be added to the tables
+    std::vector<std::vector<Record>> m_held;    /// Records of each endpoint, held until those before it are added
+    std::vector<bool> m_done;                   /// Set once the transfer of each endpoint has ended
+    size_t m_next_endpoint;                     /// First endpoint whose transfer hasn't ended; its records are added as they are parsed
+    bool m_recover;                             /// Skip ill formatted json rather than stopping at it
+    double m_max_skipped_fraction;              /// Largest fraction of each response which may be skipped
+};
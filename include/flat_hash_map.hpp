@@ -0,0 +1,304 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Hash map holding its entries in a single array, found by linear probing
+ *
+ * Unlike std::map and std::unordered_map, no entry has an allocation of its own. A key is hashed
+ * to a slot, and the slots are scanned from there to the entry or the first empty slot, which is
+ * mostly within the one cache line. Each slot holds a few bits of the hash of its key, so keys
+ * are only compared where these match. Erasing an entry moves the entries after it back to fill the
+ * gap, rather than leaving a tombstone, so lookups don't slow down as entries come and go.
+ *
+ * The keys and values must be default constructible. Inserting an entry may move the others,
+ * which invalidates references and iterators to them, unless room was reserved for it with
+ * reserve(). Erasing an entry may move the others likewise. The entries are in no particular order.
+*/
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class FlatHashMap
+{
+    struct Slot
+    {
+        std::pair<Key, Value> entry;
+        uint8_t tag = EMPTY;    /// EMPTY, or 7 bits of the hash of the key with the top bit set
+    };
+
+public:
+    using value_type = std::pair<Key, Value>;
+
+    /**
+     * \brief Iterator over the entries. The key of an entry must not be changed through it.
+    */
+    template <typename Entry>
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::remove_const<Entry>::type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Entry*;
+        using reference = Entry&;
+
+        Entry& operator*() const { return m_slot->entry; }
+        Entry* operator->() const { return &m_slot->entry; }
+        Iterator& operator++() { ++m_slot; skip_unused(); return *this; }
+        Iterator operator++(int) { Iterator previous = *this; ++(*this); return previous; }
+        bool operator==(const Iterator& other) const { return m_slot == other.m_slot; }
+        bool operator!=(const Iterator& other) const { return m_slot != other.m_slot; }
+
+    private:
+        friend class FlatHashMap;
+        using SlotPointer = typename std::conditional<std::is_const<Entry>::value, const Slot*, Slot*>::type;
+
+        Iterator(SlotPointer slot, SlotPointer end) : m_slot(slot), m_end(end) { skip_unused(); }
+        void skip_unused() { while ((m_slot != m_end) && (m_slot->tag == EMPTY)) ++m_slot; }
+
+        SlotPointer m_slot; /// Slot of the entry
+        SlotPointer m_end;  /// One past the last slot
+    };
+    using iterator = Iterator<value_type>;
+    using const_iterator = Iterator<const value_type>;
+
+    /**
+     * \brief Returns the number of entries
+    */
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() { return iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+    iterator end() { return iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+    const_iterator begin() const { return const_iterator(m_slots.data(), m_slots.data() + m_slots.size()); }
+    const_iterator end() const { return const_iterator(m_slots.data() + m_slots.size(), m_slots.data() + m_slots.size()); }
+
+    /**
+     * \brief Returns the entry with the key, or end() if there isn't one
+    */
+    iterator find(const Key& key);
+    const_iterator find(const Key& key) const;
+
+    /**
+     * \brief Returns the value of the key, inserting a default value if the key isn't in the map
+    */
+    Value& operator[](const Key& key);
+
+    /**
+     * \brief Inserts an entry, unless the key is already in the map
+     *
+     * \return The entry with the key, and true if it was inserted
+    */
+    std::pair<iterator, bool> emplace(const Key& key, Value value);
+
+    /**
+     * \brief Erases the entry with the key
+     *
+     * \return The number of entries erased, 0 or 1
+    */
+    size_t erase(const Key& key);
+
+    /**
+     * \brief Erases every entry, keeping the slots for the entries to come
+    */
+    void clear();
+
+    /**
+     * \brief Makes room for a number of entries in all, so inserting up to that many moves no entry
+    */
+    void reserve(size_t n_entries);
+
+private:
+    static constexpr size_t MIN_SLOTS = 8;  /// Number of slots once the first entry is inserted
+    static constexpr uint8_t EMPTY = 0;     /// Tag of an empty slot
+
+    /**
+     * \brief Returns the most entries the slots may hold. A quarter are kept empty, to keep the scans short.
+    */
+    static size_t max_entries(size_t n_slots) { return n_slots - n_slots / 4; }
+
+    /**
+     * \brief Returns the slot a hash sends its key to
+     *
+     * The hash is multiplied by 2^64 divided by the golden ratio, and its top bits taken, so that
+     * keys which differ only in their high bits, eg. multiples of the number of slots, are spread out.
+    */
+    size_t home_slot(size_t hash) const
+    {
+        return static_cast<size_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> m_shift);
+    }
+
+    /**
+     * \brief Returns the tag of the slot of a key with this hash
+    */
+    static uint8_t tag_of(size_t hash) { return static_cast<uint8_t>(hash) | 0x80; }
+
+    /**
+     * \brief Returns the slot holding the key, or the empty slot where it would be inserted. There must be a slot.
+    */
+    size_t find_slot(const Key& key, size_t hash) const;
+
+    /**
+     * \brief Moves the entries into a new array of slots
+    */
+    void rehash(size_t n_slots);
+
+    std::vector<Slot> m_slots;  /// Number of slots is 0 or a power of 2
+    size_t m_size = 0;          /// Number of entries
+    unsigned int m_shift = 64;  /// 64 minus log2 of the number of slots
+};
+
+template <typename Key, typename Value, typename Hash>
+typename FlatHashMap<Key, Value, Hash>::iterator FlatHashMap<Key, Value, Hash>::find(const Key& key)
+{
+    if (m_size == 0)
+    {
+        return end();
+    }
+    const size_t slot = find_slot(key, Hash()(key));
+    return (m_slots[slot].tag != EMPTY) ? iterator(m_slots.data() + slot, m_slots.data() + m_slots.size()) : end();
+}
+
+template <typename Key, typename Value, typename Hash>
+typename FlatHashMap<Key, Value, Hash>::const_iterator FlatHashMap<Key, Value, Hash>::find(const Key& key) const
+{
+    if (m_size == 0)
+    {
+        return end();
+    }
+    const size_t slot = find_slot(key, Hash()(key));
+    return (m_slots[slot].tag != EMPTY) ? const_iterator(m_slots.data() + slot, m_slots.data() + m_slots.size()) : end();
+}
+
+template <typename Key, typename Value, typename Hash>
+Value& FlatHashMap<Key, Value, Hash>::operator[](const Key& key)
+{
+    return emplace(key, Value()).first->second;
+}
+
+template <typename Key, typename Value, typename Hash>
+std::pair<typename FlatHashMap<Key, Value, Hash>::iterator, bool> FlatHashMap<Key, Value, Hash>::emplace(const Key& key, Value value)
+{
+    // The slots only grow for a new key, so looking up a key already in the map moves nothing
+    const size_t hash = Hash()(key);
+    size_t slot = m_slots.empty() ? 0 : find_slot(key, hash);
+    if (!m_slots.empty() && (m_slots[slot].tag != EMPTY))
+    {
+        return {iterator(m_slots.data() + slot, m_slots.data() + m_slots.size()), false};
+    }
+    if (m_size + 1 > max_entries(m_slots.size()))
+    {
+        rehash(m_slots.empty() ? MIN_SLOTS : 2 * m_slots.size());
+        slot = find_slot(key, hash);
+    }
+
+    m_slots[slot].entry.first = key;
+    m_slots[slot].entry.second = std::move(value);
+    m_slots[slot].tag = tag_of(hash);
+    m_size++;
+    return {iterator(m_slots.data() + slot, m_slots.data() + m_slots.size()), true};
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t FlatHashMap<Key, Value, Hash>::erase(const Key& key)
+{
+    if (m_size == 0)
+    {
+        return 0;
+    }
+    size_t hole = find_slot(key, Hash()(key));
+    if (m_slots[hole].tag == EMPTY)
+    {
+        return 0;
+    }
+
+    // Move back each entry after the hole which would still be found from its home slot, until an empty slot
+    const size_t mask = m_slots.size() - 1;
+    m_slots[hole].tag = EMPTY;
+    for (size_t slot = (hole + 1) & mask; m_slots[slot].tag != EMPTY; slot = (slot + 1) & mask)
+    {
+        const size_t home = home_slot(Hash()(m_slots[slot].entry.first));
+        if (((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            m_slots[hole].entry = std::move(m_slots[slot].entry);
+            m_slots[hole].tag = m_slots[slot].tag;
+            m_slots[slot].tag = EMPTY;
+            hole = slot;
+        }
+    }
+    m_slots[hole].entry = value_type();
+    m_size--;
+    return 1;
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key, Value, Hash>::clear()
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.tag != EMPTY)
+        {
+            slot.entry = value_type();
+            slot.tag = EMPTY;
+        }
+    }
+    m_size = 0;
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key, Value, Hash>::reserve(size_t n_entries)
+{
+    size_t n_slots = m_slots.empty() ? MIN_SLOTS : m_slots.size();
+    while (max_entries(n_slots) < n_entries)
+    {
+        n_slots *= 2;
+    }
+    if (n_slots > m_slots.size())
+    {
+        rehash(n_slots);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t FlatHashMap<Key, Value, Hash>::find_slot(const Key& key, size_t hash) const
+{
+    const size_t mask = m_slots.size() - 1;
+    const uint8_t tag = tag_of(hash);
+    size_t slot = home_slot(hash);
+    while ((m_slots[slot].tag != EMPTY) && !((m_slots[slot].tag == tag) && (m_slots[slot].entry.first == key)))
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+template <typename Key, typename Value, typename Hash>
+void FlatHashMap<Key, Value, Hash>::rehash(size_t n_slots)
+{
+    std::vector<Slot> old_slots(n_slots);
+    old_slots.swap(m_slots);
+    m_shift = 64;
+    for (size_t n = n_slots; n > 1; n /= 2)
+    {
+        m_shift--;
+    }
+
+    for (Slot& old_slot : old_slots)
+    {
+        if (old_slot.tag != EMPTY)
+        {
+            // The keys are all different, so each goes in the first empty slot from its home slot
+            size_t slot = home_slot(Hash()(old_slot.entry.first));
+            while (m_slots[slot].tag != EMPTY)
+            {
+                slot = (slot + 1) & (n_slots - 1);
+            }
+            m_slots[slot].entry = std::move(old_slot.entry);
+            m_slots[slot].tag = old_slot.tag;
+        }
+    }
+}
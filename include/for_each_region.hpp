@@ -0,0 +1,25 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Calls the function for every region, one on each thread
+ *
+ * The first region is handled by the calling thread, which returns once they all have.
+*/
+template <typename Region, typename Function>
+void for_each_region(std::vector<Region>& regions, Function function)
+{
+    std::vector<std::thread> threads;
+    for (size_t i_region = 1; i_region < regions.size(); i_region++)
+    {
+        threads.emplace_back(function, std::ref(regions[i_region]));
+    }
+    function(regions[0]);
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class LogType;
+
+/**
+ * \brief Writes log messages to stderr from a background thread
+ *
+ * Messages are pushed onto a bounded queue which any thread may push to without taking a lock,
+ * and a sink thread writes them out in batches. A message below the level set is never formatted.
+ * If the queue is full, a message is dropped and counted, unless it is an error, which waits for
+ * space. Messages of a LogType are rate limited, and those which aren't logged are summarised.
+ *
+ * There is one Logger for the program, which is reached with get(). Messages are logged with a
+ * LogMessage.
+*/
+class Logger
+{
+public:
+    enum class Level
+    {
+        DEBUG,
+        INFO,
+        WARNING,
+        ERROR,
+    };
+
+    /**
+     * \brief Returns the Logger of the program, starting its sink thread the first time
+    */
+    static Logger& get();
+
+    /**
+     * \brief Destructor. Writes out every message pushed, and stops the sink thread.
+    */
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    /**
+     * \brief Sets the lowest level of message which is logged. The default is INFO.
+    */
+    void set_level(Level level);
+
+    /**
+     * \returns true if messages of this level are logged
+    */
+    bool is_enabled(Level level) const;
+
+    /**
+     * \brief Sets how many messages of each LogType are logged per second. The default is 10.
+    */
+    void set_rate_limit(size_t n_per_second);
+
+    /**
+     * \returns the number of messages of each LogType logged per second
+    */
+    size_t get_rate_limit() const;
+
+    /**
+     * \brief Sets the stream the messages are written to, after writing out those already pushed
+     *
+     * The stream must outlive the Logger, or be replaced before it is destroyed.
+    */
+    void set_output(std::ostream &output);
+
+    /**
+     * \brief Queues a message to be written by the sink thread
+     *
+     * This doesn't check the level; LogMessage does that before formatting the message.
+    */
+    void push(Level level, std::string &&message);
+
+    /**
+     * \brief Waits until every message pushed so far, and the summaries of the LogTypes, have been written
+    */
+    void flush();
+
+    /**
+     * \brief Parses the name of a level, eg. "warning"
+     *
+     * \returns false if the name isn't a level
+    */
+    static bool parse_level(const std::string &name, Level &level);
+
+private:
+    friend class LogType;
+
+    /**
+     * \brief Constructor
+     *
+     * \param capacity: Number of messages the queue holds, rounded up to a power of two
+    */
+    Logger(size_t capacity);
+
+    /**
+     * \brief Slot in the queue
+     *
+     * A slot is free for the push of number n when its sequence is n, and holds the message of
+     * that push once its sequence is n + 1. After it is popped, its sequence is n + capacity.
+    */
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        Level level;
+        std::string message;
+    };
+
+    /**
+     * \brief Pushes a message onto the queue without waiting
+     *
+     * \returns false if the queue is full
+    */
+    bool try_push(Level level, std::string &message);
+
+    /**
+     * \brief Pops the oldest message from the queue. Only the sink thread pops.
+     *
+     * \returns false if the queue is empty, or its oldest slot is still being filled
+    */
+    bool try_pop(Level &level, std::string &message);
+
+    /**
+     * \returns true if the oldest slot of the queue holds a message
+    */
+    bool has_message() const;
+
+    /**
+     * \brief Body of the sink thread
+    */
+    void run();
+
+    /**
+     * \brief Appends a message to the text which the sink thread is about to write
+    */
+    static void format(Level level, const std::string &message, std::string &text);
+
+    /**
+     * \brief Appends the number of messages suppressed for each LogType, and dropped, since the last summary
+    */
+    void summarise(std::string &text);
+
+    /**
+     * \brief Writes text to the output
+    */
+    void write(const std::string &text);
+
+    void add_type(LogType *type);
+    void remove_type(LogType *type);
+
+    std::unique_ptr<Slot[]> m_slots;            /// Ring of slots holding the queued messages
+    const size_t m_mask;                        /// Number of slots less one, which is a power of two less one
+    std::atomic<size_t> m_head;                 /// Number of the next push
+    size_t m_tail;                              /// Number of the next pop, which only the sink thread uses
+    std::atomic<size_t> m_n_dropped;            /// Number of messages dropped since the last summary
+    std::atomic<Level> m_level;                 /// Lowest level logged
+    std::atomic<size_t> m_rate_limit;           /// Messages of each LogType logged per second
+    std::atomic<std::ostream*> m_output;        /// Stream the messages are written to
+
+    std::vector<LogType*> m_types;              /// Rate limited types of message, whose suppressed messages are summarised
+    std::mutex m_types_mutex;                   /// Protects m_types
+
+    std::atomic<bool> m_sink_waiting;           /// Set while the sink thread waits, so that a push wakes it
+    size_t m_flush_target;                      /// Number of pushes to be written before the requested flushes are done
+    size_t m_n_flushes_requested;               /// Number of calls to flush() so far
+    size_t m_n_flushes_done;                    /// Number of calls to flush() whose messages have all been written
+    bool m_stop;                                /// Set when the sink thread should write out the queue and stop
+    std::mutex m_mutex;                         /// Protects the flush counts and m_stop
+    std::condition_variable m_wake;             /// Wakes the sink thread
+    std::condition_variable m_flushed;          /// Signalled when a flush is done
+    std::thread m_sink;                         /// Thread which writes the messages
+};
+
+/**
+ * \brief A type of message which is rate limited, such as a record missing a given field
+ *
+ * At most Logger::get_rate_limit() messages of a type are logged each second. The rest are only
+ * counted, and a summary such as "1532 more records missing field AGE were not logged" is
+ * written once a second, on Logger::flush(), and when the LogType is destroyed.
+ * A LogType is usually a static object at the place the message is logged.
+*/
+class LogType
+{
+public:
+    /**
+     * \brief Constructor
+     *
+     * \param level: Level of the messages of this type
+     * \param summary: Description of the messages for the summary, eg. "records missing field AGE"
+    */
+    LogType(Logger::Level level, const std::string &summary);
+
+    /**
+     * \brief Destructor. Logs the summary of any messages suppressed since the last one.
+    */
+    ~LogType();
+
+    LogType(const LogType&) = delete;
+    LogType& operator=(const LogType&) = delete;
+
+    Logger::Level get_level() const;
+    const std::string& get_summary() const;
+
+    /**
+     * \brief Counts a message of this type
+     *
+     * \returns true if the message is to be logged, or false if the rate limit has been reached
+    */
+    bool admit();
+
+    /**
+     * \brief Returns the number of messages suppressed since it was last taken, and resets it
+    */
+    size_t take_suppressed();
+
+private:
+    const Logger::Level m_level;                /// Level of the messages
+    const std::string m_summary;                /// Description of the messages
+    std::atomic<long long> m_second;            /// Second of the steady clock in which m_n_in_second are counted
+    std::atomic<size_t> m_n_in_second;          /// Messages of this type in that second
+    std::atomic<size_t> m_n_suppressed;         /// Messages not logged since the last summary
+};
+
+/**
+ * \brief Formats a log message with operator<<, and pushes it to the Logger when destroyed
+ *
+ * Usually a temporary, eg. LogMessage(Logger::Level::WARNING) << "retrying in " << ms << " ms";
+ * Nothing is formatted if the message won't be logged.
+*/
+class LogMessage
+{
+public:
+    /**
+     * \brief Constructor for a message which is logged if its level is enabled
+    */
+    explicit LogMessage(Logger::Level level);
+
+    /**
+     * \brief Constructor for a message which is also subject to the rate limit of its type
+    */
+    explicit LogMessage(LogType &type);
+
+    /**
+     * \brief Destructor. Pushes the message to the Logger.
+    */
+    ~LogMessage();
+
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    template <typename T>
+    LogMessage& operator<<(const T &value)
+    {
+        if (m_stream)
+        {
+            *m_stream << value;
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Appends part of a buffer, eg. a block of the response which failed to parse
+     *
+     * Only its first EXCERPT_SIZE bytes are appended, unless debug messages are logged, so that an
+     * error near the start of a large response doesn't write out the rest of it.
+    */
+    LogMessage& excerpt(const char *data, size_t size);
+
+    static const size_t EXCERPT_SIZE = 256;
+
+    /**
+     * \returns true if the message will be logged, so anything costly to add to it is worth adding
+    */
+    bool is_logged() const;
+
+private:
+    const Logger::Level m_level;                /// Level of the message
+    std::unique_ptr<std::ostringstream> m_stream;/// Message being formatted, if it will be logged
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Read-only memory mapping of a whole file, eg. a captured response of the endpoint
+ * 
+ * The file's pages are mapped straight into memory, so the data can be handed to DataObjects
+ * without being read into a buffer first. The mapping lasts as long as this object.
+*/
+class MappedFile
+{
+public:
+    /**
+     * \brief Constructor. Maps the file.
+     * 
+     * This will set the error, which should be checked using get_error().
+     * 
+     * \param path: File to map
+    */
+    MappedFile(const char* path);
+
+    /**
+     * \brief Destructor. Unmaps the file.
+    */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * \brief Returns the start of the file's contents. This is not null terminated.
+    */
+    const char* get_data() const;
+
+    /**
+     * \brief Returns the number of bytes in the file
+    */
+    size_t get_size() const;
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,       /// No error
+        OPEN,       /// The file could not be opened
+        MAP,        /// The file could not be mapped
+    };
+
+    /**
+     * \brief Returns the error encountered while mapping the file
+    */
+    ErrorType get_error() const;
+
+    /**
+     * \brief Lists the captured responses to replay
+     * 
+     * The files of a directory are listed in name order. Empty files in a directory are left out, with
+     * a warning, since they hold no records; a single file is always listed.
+     * 
+     * \param path: A single capture, or a directory of captures
+    */
+    static std::vector<std::string> list_captures(const std::string& path);
+protected:
+
+private:
+    const char* m_data;     /// Start of the mapping, or nullptr if nothing is mapped
+    size_t m_size;          /// Number of bytes mapped
+    ErrorType m_error;      /// Error encountered while mapping the file
+};
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef void CURL;  /// Forward delcaration
+typedef void CURLM; /// Forward delcaration
+
+/**
+ * \brief Implementation to connect to several endpoints at the same time and stream their text data.
+ * 
+ * All of the transfers are driven from the thread that calls query_endpoints(), so the handlers
+ * are never called concurrently and need no synchronisation. The total time is bounded by the
+ * slowest endpoint rather than the sum of all of them.
+*/
+class MultiClient
+{
+public:
+    static constexpr long DEFAULT_MAX_CONNECTIONS = 8; /// Default limit on the number of open connections
+
+    /**
+     * \brief Called with each chunk of a response as it arrives
+     * 
+     * \param endpoint_index: Index of the endpoint in the list passed to the constructor
+     * \param data: Start of the chunk
+     * \param size: Number of bytes in the chunk
+     * 
+     * \returns false to abort the transfer from this endpoint
+    */
+    typedef std::function<bool(size_t endpoint_index, const char* data, size_t size)> ChunkHandler;
+
+    /**
+     * \brief Called once the transfer from an endpoint has ended, successfully or not
+     * 
+     * \param endpoint_index: Index of the endpoint in the list passed to the constructor
+    */
+    typedef std::function<void(size_t endpoint_index)> DoneHandler;
+
+    /**
+     * \brief Constructor
+     * 
+     * \param endpoints: Connect to these endpoints
+     * \param max_connections: Maximum number of connections open at the same time. Transfers
+     * beyond this wait for a connection to become free.
+     * \param compressed: Offer every content encoding curl supports (eg. gzip), which curl decodes
+     * as the response arrives, so the handlers always receive the plain text
+    */
+    MultiClient(const std::vector<std::string>& endpoints, long max_connections = DEFAULT_MAX_CONNECTIONS, bool compressed = true);
+
+    /**
+     * \brief Destructor
+    */
+    ~MultiClient();
+
+    /**
+     * \brief Connects to all of the endpoints and streams their text data to the handlers.
+     * 
+     * Returns once every transfer has ended. The status and the first bytes of each response are
+     * checked before any of it is passed to on_chunk; an error status or a body which isn't json
+     * aborts that transfer straight away. This will set the error, which should be checked
+     * using get_error().
+     * 
+     * \param on_chunk: Called with each chunk of each response
+     * \param on_done: Called when each transfer ends
+    */
+    void query_endpoints(const ChunkHandler& on_chunk, const DoneHandler& on_done);
+
+    /**
+     * \brief Returns the number of endpoints
+    */
+    size_t get_num_endpoints() const;
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,           /// No error
+        INIT,           /// Initialising connection failed
+        QUERY,          /// Failed to query the endpoint
+        HTTP_STATUS,    /// The endpoint responded with a status other than 2xx
+        NON_JSON_BODY,  /// The response doesn't start with a json object or array, eg. an HTML error page
+    };
+
+    /**
+     * \brief Returns the error encountered during the last operation on any endpoint
+    */
+    ErrorType get_error() const;
+
+    /**
+     * \brief Returns the error encountered during the last operation on one endpoint
+    */
+    ErrorType get_error(size_t endpoint_index) const;
+protected:
+
+private:
+    CURLM* m_multi;                         /// CURL multi object driving the transfers
+    std::vector<CURL*> m_curl;              /// CURL object for each endpoint
+    const std::vector<std::string> m_endpoints; /// Endpoints to query
+    std::vector<ErrorType> m_errors;        /// Last error encountered for each endpoint
+    ErrorType m_error;                      /// Last error encountered
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "query_tables.hpp"
+#include "tables_interface.hpp"
+
+/**
+ * \brief Parses a whole response on several threads, and adds its records to the tables
+ *
+ * The response is split evenly into one region per thread, and each region is moved forward to
+ * the start of its first record. A record is either a block at the top level, or an element of an
+ * array at the top level, so the split needs to know which characters are inside strings and how
+ * deeply each brace is nested. A thread can't tell this from the middle of the response, so it's
+ * worked out in two passes over the regions in parallel, with a StructuralIndex:
+ *
+ *  1. Each region counts its unescaped quotes, and the change in depth of the braces outside
+ *     strings, both for starting outside a string and inside one. Adding these up region by
+ *     region gives whether each region starts inside a string, and at what depth.
+ *  2. Each region then finds its first brace opening a block at the top level, and its first
+ *     brace opening a value inside the top level block that is already open.
+ *
+ * The records of each region are then parsed and validated with a RecordHandler on its own
+ * thread, and collected rather than added. Finally, the records are added to the tables region by
+ * region, in the order they appear in the response, so the generated ids and the results are the
+ * same as if the response was parsed by a single DataObjects. A parse error stops the records
+ * after it from being added, as it would for a single DataObjects.
+ *
+ * Responses too small to split, and those whose braces don't balance, are parsed on the calling
+ * thread by a DataObjects.
+*/
+class ParallelParser
+{
+public:
+    static constexpr size_t DEFAULT_MIN_REGION_SIZE = 1024 * 1024; /// Default number of bytes below which a region isn't worth a thread
+
+    /**
+     * \brief Constructor
+     *
+     * \param tables: Tables to populate with the records in the response
+     * \param n_threads: Largest number of threads to parse the response with, including the calling thread
+     * \param min_region_size: Smallest number of bytes parsed by each thread
+    */
+    ParallelParser(TablesInterface& tables, unsigned int n_threads, size_t min_region_size = DEFAULT_MIN_REGION_SIZE);
+
+    /**
+     * \brief Skips ill formatted json rather than stopping at it, as for DataObjects::set_recovery()
+     *
+     * If a region fails to parse, the whole response is parsed again by a DataObjects in recovery
+     * mode, so the records added are still the same as on a single thread.
+     *
+     * \param max_skipped_fraction: Largest fraction of the response which may be skipped
+    */
+    void set_recovery(double max_skipped_fraction);
+
+    /**
+     * \brief Parses the whole response, and adds the valid records to the tables
+     *
+     * This will set the error, which should be checked using get_error().
+     *
+     * \param data: Start of the response, which is read but not modified
+     * \param size: Number of bytes in the response
+    */
+    void parse(const char* data, size_t size);
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,       /// No error
+        FORMAT,     /// The response contains ill formatted json
+    };
+
+    /**
+     * \brief Returns the error encountered during the last parse
+    */
+    ErrorType get_error() const;
+
+    /**
+     * \brief Returns the number of records which failed validation during the last parse
+    */
+    int get_bad_records() const;
+protected:
+
+private:
+    static constexpr size_t NONE = static_cast<size_t>(-1); /// Offset of a brace which wasn't found
+
+    /**
+     * \brief Type of a block at the top level of the response
+    */
+    enum class Top {
+        NONE,       /// No block has been opened yet
+        OBJECT,     /// A single record
+        ARRAY,      /// An array of records
+    };
+
+    /**
+     * \brief Part of the response parsed by one thread
+    */
+    struct Region
+    {
+        size_t begin = 0;               /// Offset of the first byte of the region, before it's moved to a record
+        size_t end = 0;                 /// Offset following the last byte of the region
+
+        // Found by the first pass
+        bool odd_quotes = false;        /// The region has an odd number of unescaped quotes
+        int depth_change_outside = 0;   /// Change in depth across the region, if it starts outside a string
+        int depth_change_inside = 0;    /// Change in depth across the region, if it starts inside a string
+
+        // Found from the first pass of the previous regions
+        bool in_string = false;         /// The region starts inside a string
+        int depth = 0;                  /// Depth of the braces enclosing the start of the region
+
+        // Found by the second pass
+        size_t first_top = NONE;        /// Offset of the first brace opening a block at the top level
+        size_t first_element = NONE;    /// Offset of the first brace opening a value inside the top level block open at the start
+        Top last_top = Top::NONE;       /// Type of the last block opened at the top level
+        bool unbalanced = false;        /// A closing brace has no opening brace
+
+        // Records to parse
+        size_t records_begin = 0;       /// Offset of the first record of the region
+        size_t records_end = 0;         /// Offset of the first record of the next region
+        bool in_array = false;          /// The first record is an element of an array at the top level
+        bool last = false;              /// The records run to the end of the response
+
+        // Found by parsing
+        std::vector<Record> records;    /// Valid records, in the order they appear
+        int n_bad_records = 0;          /// Number of records which failed validation
+        bool failed = false;            /// Parsing stopped at ill formatted json
+        size_t error_begin = 0;         /// Offset of the start of the ill formatted json
+        size_t error_end = 0;           /// Offset following the point at which parsing failed
+    };
+
+    /**
+     * \brief Splits the response into regions starting at records
+     *
+     * \returns false if the response should be parsed by a single DataObjects instead
+    */
+    bool split(const char* data, size_t size);
+
+    /**
+     * \brief First pass over a region, counting its quotes and braces
+    */
+    static void count_braces(const char* data, Region& region);
+
+    /**
+     * \brief Second pass over a region, finding the braces at which a record may start
+    */
+    static void find_record_starts(const char* data, Region& region);
+
+    /**
+     * \brief Parses and validates the records of a region, collecting the valid ones
+    */
+    static void parse_region(const char* data, Region& region);
+
+    /**
+     * \brief Adds the records of every region to the tables in order, up to any parse error
+    */
+    void merge(const char* data);
+
+    /**
+     * \brief Parses the response on the calling thread with a single DataObjects
+    */
+    void parse_serial(const char* data, size_t size);
+
+    TablesInterface& m_tables;          /// Tables populated with the records
+    const unsigned int m_n_threads;     /// Largest number of threads to parse with
+    const size_t m_min_region_size;     /// Smallest number of bytes parsed by each thread
+    std::vector<Region> m_regions;      /// Regions of the response being parsed
+    ErrorType m_error;                  /// Last error encountered
+    int m_n_bad_records;                /// Number of records which failed validation
+    bool m_recover;                     /// Skip ill formatted json rather than stopping at it
+    double m_max_skipped_fraction;      /// Largest fraction of the response which may be skipped
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "query_tables.hpp"
+
+/**
+ * \brief Totals of some of the citizens, eg. those of one shard of ShardedTables, which can be merged
+ *
+ * The totals are held by string rather than by symbol, since each set of tables interns its strings
+ * in its own order. Merging is associative and commutative, so the totals of any number of parts can
+ * be merged in any order, and the results of the merged totals are the results of all the citizens.
+ *
+ * Of the citizens with most friends in a city, the user with most friends is the one with the lowest
+ * city order, so the city orders of the parts must be comparable, eg. positions in the same response.
+*/
+struct PartialResults
+{
+    /**
+     * \brief Totals of the citizens of a city
+    */
+    struct City
+    {
+        size_t n_citizens = 0;
+        size_t age = 0;                 /// Sum of the ages of the citizens
+        int n_friends = 0;              /// Sum of the numbers of friends of the citizens
+        unsigned int max_friends = 0;   /// Number of friends of the user with most friends, or 0 if there isn't one
+        std::string max_name;           /// Name of the user with most friends
+        size_t max_order = 0;           /// City order of the user with most friends
+    };
+
+    std::map<std::string, City> cities;             /// Cities with citizens, by name
+    std::map<std::string, unsigned int> names;      /// Number of citizens in a city with each name
+    std::map<std::string, unsigned int> hobbies;    /// Number of friends with each hobby
+
+    /**
+     * \brief Adds the totals of other citizens to these
+    */
+    void merge(const PartialResults &other);
+
+    /**
+     * \brief Computes the results of the citizens, as Tables::query_results() does
+    */
+    Results get_results() const;
+};
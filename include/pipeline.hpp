@@ -0,0 +1,80 @@
+#pragma once
+
+#include "client.hpp"
+#include "tables_interface.hpp"
+
+class ChunkQueue;
+
+/**
+ * \brief Overlaps acquiring the response with parsing it and populating the tables
+ * 
+ * The Client streams the response into a bounded queue on the calling thread, while a second
+ * thread takes chunks off the queue, splits them into records using DataObjects and adds the
+ * records to the Tables. The total time is then close to the time of the slowest stage, rather
+ * than the sum of all of them.
+*/
+class Pipeline
+{
+public:
+    static constexpr size_t DEFAULT_QUEUE_CAPACITY = 64; /// Default number of chunks buffered between the stages
+
+    /**
+     * \brief Constructor
+     * 
+     * \param client: Client connected to the endpoint
+     * \param tables: Tables to populate with the records in the response
+     * \param queue_capacity: Number of chunks that may be buffered between downloading and parsing
+    */
+    Pipeline(Client& client, TablesInterface& tables, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+
+    /**
+     * \brief Skips ill formatted json rather than stopping at it, as for DataObjects::set_recovery()
+     * 
+     * \param max_skipped_fraction: Largest fraction of the response which may be skipped
+    */
+    void set_recovery(double max_skipped_fraction);
+
+    /**
+     * \brief Queries the endpoint and populates the tables, returning once both are complete
+     * 
+     * This will set the error, which should be checked using get_error().
+    */
+    void run();
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,       /// No error
+        QUERY,      /// The client failed to acquire the response
+        FORMAT,     /// The response contains ill formatted json
+    };
+
+    /**
+     * \brief Returns the error encountered during the last run
+    */
+    ErrorType get_error() const;
+
+    /**
+     * \brief Returns the number of records rejected by the tables during the last run
+    */
+    int get_bad_records() const;
+protected:
+
+private:
+    /**
+     * \brief Consumes the queue, parsing the chunks and populating the tables
+     * 
+     * This runs on the second thread.
+    */
+    void ingest(ChunkQueue& queue);
+
+    Client& m_client;               /// Client used to acquire the response
+    TablesInterface& m_tables;      /// Tables populated with the records
+    const size_t m_queue_capacity;  /// Number of chunks buffered between the stages
+    ErrorType m_error;              /// Last error encountered
+    int m_n_bad_records;            /// Number of records rejected by the tables
+    bool m_closed_queue;            /// Set if ingest() closed the queue itself, rather than the client at the end of the transfer
+    bool m_recover;                 /// Skip ill formatted json rather than stopping at it
+    double m_max_skipped_fraction;  /// Largest fraction of the response which may be skipped
+};
@@ -8,20 +8,83 @@
 #include <vector>
 
 /**
- * \brief Table representing citizens
+ * \brief Number of an interned string, such as a name, city or hobby. See SymbolTable.
 */
-struct Citizen
+using Symbol = unsigned int;
+
+/**
+ * \brief Table representing friends of citizens
+*/
+struct CitizenFriend
 {
-    std::string name;
-    int age;
+    Symbol name;
+    std::vector<Symbol> hobbies;
 };
 
 /**
- * \brief Table representing friends of citizens
+ * \brief Table representing citizens, with a column for each field
+ * 
+ * A citizen is a row, at the same index of every column. The rows are in no particular order.
+*/
+struct CitizenTable
+{
+    std::vector<unsigned int> id;
+    std::vector<Symbol> name;
+    std::vector<int> age;
+    std::vector<Symbol> city;
+    std::vector<size_t> city_order;                 /// Position of the record putting the citizen in their city in this response; the first comes first
+    std::vector<unsigned int> n_friends;            /// Number of friends, so they needn't be looked at to count them
+    std::vector<std::vector<CitizenFriend>> friends;
+    std::vector<unsigned int> update;               /// Update of the tables in which the citizen was last seen
+};
+
+/**
+ * \brief Running totals of the citizens of a city
+ * 
+ * Of the citizens with the most friends, the user with most friends is the first in the current response,
+ * ie. whose record putting them in the city comes first.
+ * A citizen without friends is never the user with most friends.
+*/
+struct CityTotals
+{
+    size_t n_citizens = 0;
+    size_t age = 0;                         /// Sum of the ages of the citizens
+    int n_friends = 0;                      /// Sum of the numbers of friends of the citizens
+    unsigned int max_friends = 0;           /// Number of friends of the user with most friends, or 0 if there isn't one
+    Symbol max_name = 0;                    /// Name of the user with most friends
+    size_t max_order = 0;                   /// City order of the user with most friends
+    bool stale = false;                     /// Set when the user with most friends has left or changed, until they are found again
+    bool listed = false;                    /// Set once the city is in the list of cities
+};
+
+/**
+ * \brief Friend of a citizen, as it appears in a record
 */
 struct Friend
 {
     std::string name;
+    std::vector<std::string> hobbies;
+};
+
+constexpr const char* CITY_FIELD = "city";              /// Field name of the city as it appears in the endpoint response
+constexpr const char* CITIZEN_ID_FIELD = "id";          /// Field name of the citizen id as it appears in the endpoint response
+constexpr const char* CITIZEN_NAME_FIELD = "name";      /// Field name of the citizen name as it appears in the endpoint response
+constexpr const char* CITIZEN_AGE_FIELD = "age";        /// Field name of the citizen's age as it appears in the endpoint response
+constexpr const char* FRIEND_FIELD = "friends";         /// Field name of the citizen's friends array as it appears in the endpoint response
+constexpr const char* FRIEND_NAME_FIELD = "name";       /// Field name of the friend name as it appears in the endpoint response
+constexpr const char* FRIEND_HOBBIES_FIELD = "hobbies"; /// Field name of the friend's hobbies array as it appears in the endpoint response
+
+/**
+ * \brief Fields of a record from the endpoint, once they have been validated
+*/
+struct Record
+{
+    bool has_id;                    /// False if the record had no id, in which case one is generated
+    int id;
+    std::string name;
+    int age;
+    std::string city;
+    std::vector<Friend> friends;    /// Friends with a name, and their hobbies which are strings
 };
 
 /**
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <rapidjson/rapidjson.h>
+
+#include "query_tables.hpp"
+#include "tables.hpp"
+
+/**
+ * \brief SAX handler which picks the records out of rapidjson's parse events and adds them to the tables
+ *
+ * Passed to DataObjects::parse_next_block(), this means no rapidjson document is built. Each field
+ * is copied into a Record as rapidjson reads it, and the record is validated and added to the
+ * tables (or collected) once its object closes. A block may be a single record, or an array of them.
+ *
+ * The validation is the same as Tables::add_record() for a rapidjson::Value. The city, name, age
+ * and friends must be present and of the right type, and the id is optional. As with HasMember(),
+ * only the first of repeated keys counts. Friends without a name are skipped, and so are hobbies
+ * which aren't strings.
+*/
+class RecordHandler
+{
+public:
+    /**
+     * \brief Constructor
+     *
+     * \param tables: Tables to which the valid records are added
+    */
+    RecordHandler(Tables &tables);
+
+    /**
+     * \brief Constructor for a handler which collects the valid records rather than adding them
+     *
+     * This lets records be parsed and validated away from the tables, eg. on several threads,
+     * and then added with Tables::add_record() in a chosen order.
+     *
+     * \param records: Vector to which the valid records are appended, in the order they close
+    */
+    explicit RecordHandler(std::vector<Record> &records);
+
+    // rapidjson's SAX handler interface
+
+    bool Null();
+    bool Bool(bool b);
+    bool Int(int i);
+    bool Uint(unsigned int u);
+    bool Int64(int64_t i);
+    bool Uint64(uint64_t u);
+    bool Double(double d);
+    bool RawNumber(const char* str, rapidjson::SizeType length, bool copy);
+    bool String(const char* str, rapidjson::SizeType length, bool copy);
+    bool StartObject();
+    bool Key(const char* str, rapidjson::SizeType length, bool copy);
+    bool EndObject(rapidjson::SizeType member_count);
+    bool StartArray();
+    bool EndArray(rapidjson::SizeType element_count);
+
+    /**
+     * \brief Forgets the block being parsed, after it failed to parse part way through
+     *
+     * The record it was in is dropped without being counted, and the next event starts a new block.
+    */
+    void reset();
+
+    /**
+     * \brief Returns the number of records which failed validation
+    */
+    int get_bad_records() const;
+protected:
+
+private:
+    /**
+     * \brief What the value being parsed belongs to
+    */
+    enum class Context {
+        RECORDS,    /// Array of records
+        RECORD,     /// Record object
+        FRIENDS,    /// Friends array of a record
+        FRIEND,     /// Friend object
+        HOBBIES,    /// Hobbies array of a friend
+        SKIP,       /// Anything else, which is ignored
+    };
+
+    /**
+     * \brief Fields of a record, in the order they are validated
+    */
+    enum Field {
+        CITY,
+        CITIZEN_ID,
+        CITIZEN_NAME,
+        CITIZEN_AGE,
+        FRIENDS,
+        N_FIELDS,   /// Number of fields; also used for keys which aren't a field
+    };
+
+    /**
+     * \brief Fields of a friend
+    */
+    enum class FriendField {
+        NAME,
+        HOBBIES,
+        NONE,       /// Any other key
+    };
+
+    /**
+     * \brief State of a field of the current record
+    */
+    enum class FieldState {
+        MISSING,    /// Key not found yet
+        VALID,      /// First value of the key had the expected type
+        INVALID,    /// First value of the key had another type
+    };
+
+    /**
+     * \brief Handles a value other than an object or array
+     *
+     * \param is_string: The value is a string, in which case it's given by str and length
+     * \param is_int: The value is a number which fits in an int, in which case it's given by i
+    */
+    void on_value(bool is_string, const char* str, rapidjson::SizeType length, bool is_int, int i);
+
+    /**
+     * \brief Handles the start of an object or array, pushing its context
+    */
+    void on_start(bool is_array);
+
+    /**
+     * \brief Handles the end of an object or array, popping its context
+    */
+    void on_end();
+
+    /**
+     * \brief Validates the current record, and adds it to the tables if valid
+    */
+    void end_record();
+
+    Tables* m_tables;                           /// Tables to which the valid records are added, or nullptr
+    std::vector<Record>* m_records;             /// Records collected instead, if m_tables is nullptr
+    std::vector<Context> m_contexts;            /// Context of each object and array enclosing the current value
+    Record m_record;                            /// Fields of the current record
+    FieldState m_fields[N_FIELDS];              /// State of each field of the current record
+    Field m_field;                              /// Field whose value comes next, or N_FIELDS for any other key
+    Friend m_friend;                            /// Current friend of the current record
+    FieldState m_friend_name;                   /// State of the current friend's name
+    bool m_friend_hobbies;                      /// The current friend's hobbies key has been seen
+    FriendField m_friend_field;                 /// Field of the current friend whose value comes next
+    int m_n_bad_records;                        /// Number of records which failed validation
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+
+#include "query_tables.hpp"
+
+/**
+ * \brief On-disk cache of the last response of each endpoint, with the results computed from it
+ *
+ * The body is kept with the validators the server sent with it (ETag and Last-Modified), so the
+ * next query can be made conditional. If the server then responds 304 Not Modified, the body is
+ * taken from here, or better, the results cached with it are used and the body isn't parsed at all.
+ *
+ * Each endpoint has three files in the cache directory, named from a hash of the endpoint: the
+ * validators (.meta), the body (.body) and the results (.results). Files are replaced by renaming
+ * a complete temporary file over them, so a reader never sees a partly written file.
+*/
+class ResponseCache
+{
+public:
+    /**
+     * \brief Constructor. Creates the directory if it doesn't exist.
+     *
+     * This will set the error, which should be checked using get_error().
+     *
+     * \param directory: Directory holding the cached responses
+    */
+    ResponseCache(const char* directory);
+
+    /**
+     * \brief Validators of a response, sent back to the server to ask whether it has changed
+    */
+    struct Validators
+    {
+        std::string etag;           /// Value of the ETag header, sent as If-None-Match
+        std::string last_modified;  /// Value of the Last-Modified header, sent as If-Modified-Since
+    };
+
+    /**
+     * \brief Gets the validators of the cached response of the endpoint
+     *
+     * \returns false if nothing is cached for the endpoint
+    */
+    bool load_validators(const std::string &endpoint, Validators &validators) const;
+
+    /**
+     * \brief Gets the cached body of the endpoint
+     *
+     * \returns false if nothing is cached for the endpoint
+    */
+    bool load_body(const std::string &endpoint, std::string &body) const;
+
+    /**
+     * \brief Caches a response of the endpoint, replacing any cached before
+     *
+     * The results cached with the previous response are removed, since they no longer apply.
+     *
+     * \returns false if the response could not be written
+    */
+    bool store_response(const std::string &endpoint, const Validators &validators, const std::string &body);
+
+    /**
+     * \brief Gets the results computed from the cached response of the endpoint
+     *
+     * \returns false if no results are cached for the endpoint
+    */
+    bool load_results(const std::string &endpoint, Results &results) const;
+
+    /**
+     * \brief Caches the results computed from the cached response of the endpoint
+     *
+     * \returns false if the results could not be written
+    */
+    bool store_results(const std::string &endpoint, const Results &results);
+
+    /**
+     * \brief Error codes associated with this class
+    */
+    enum class ErrorType {
+        NONE,       /// No error
+        DIRECTORY,  /// The cache directory could not be created
+    };
+
+    /**
+     * \brief Returns the error encountered while opening the cache
+    */
+    ErrorType get_error() const;
+protected:
+
+private:
+    /**
+     * \brief Returns the path of one of the endpoint's files
+     *
+     * \param extension: Which of the files, eg. ".body"
+    */
+    std::string get_path(const std::string &endpoint, const char* extension) const;
+
+    /**
+     * \brief Returns true if the cached validators are those of this endpoint, rather than of
+     * another endpoint with the same hash
+    */
+    bool is_cached(const std::string &endpoint) const;
+
+    const std::string m_directory;  /// Directory holding the cached responses
+    ErrorType m_error;              /// Error encountered while opening the cache
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "partial_results.hpp"
+#include "tables.hpp"
+#include "tables_interface.hpp"
+
+/**
+ * \brief Tables split into shards by citizen id, each of which is populated on a thread of its own
+ *
+ * add_records() numbers the records, splits them among the shards by id, and queues each part to
+ * be added on the thread of its shard, so the caller can go on to parse the next batch while the
+ * shards add this one. Every record of a citizen goes to the same shard, in order, so each shard
+ * holds its citizens exactly as a single Tables would hold them. The results are found by merging
+ * the PartialResults of the shards.
+ *
+ * The results are the same as those of a single Tables given the same records. Records without an
+ * id are numbered before they are split, as Tables would number them, and the citizens of a city are
+ * ordered by the position of their record among all of the records, so the same user with most
+ * friends is found whichever shards the citizens are in.
+ *
+ * Like Tables, the methods are to be called from a single thread.
+*/
+class ShardedTables : public TablesInterface
+{
+public:
+    /**
+     * \brief Constructor. Starts a thread for each shard.
+     *
+     * \param n_shards: Number of shards, at least 1
+    */
+    ShardedTables(unsigned int n_shards);
+
+    /**
+     * \brief Destructor. Waits for the shards to add any records queued, and stops their threads.
+    */
+    ~ShardedTables();
+
+    /**
+     * \brief Queues a batch of records to be added to the shards, as Tables::add_records() would add them
+     *
+     * This only waits if a shard already has MAX_PENDING_TASKS queued, so a slow shard holds up the caller
+     * rather than the batches building up.
+     *
+     * \param records: Records to add, in the order they appear in the response. Their fields are moved from.
+     * \param n_records: Number of records
+    */
+    void add_records(Record *records, size_t n_records) override;
+
+    /**
+     * \brief Starts updating the tables from a fresh response of the endpoint, as Tables::begin_update()
+    */
+    void begin_update() override;
+
+    /**
+     * \brief Ends the update, as Tables::end_update(). Waits for every shard to remove its citizens.
+    */
+    void end_update() override;
+
+    /**
+     * \brief Waits for the records queued to be added, and computes the results of all of the shards
+    */
+    Results query_results() const override;
+
+    /**
+     * \brief Waits for the records queued to be added, and merges the totals of all of the shards
+    */
+    PartialResults partial_results() const;
+
+    static constexpr size_t MAX_PENDING_TASKS = 4;  /// Most tasks queued for a shard before add_records() waits
+
+private:
+    /**
+     * \brief Tables with the thread which populates them, and the tasks queued for it
+    */
+    struct Shard
+    {
+        Tables tables;
+        std::deque<std::function<void(Tables&)>> tasks; /// Tasks queued for the thread, oldest first
+        bool busy = false;                              /// Set while the thread runs a task
+        bool stop = false;                              /// Set once the thread is to stop when it has run every task
+        std::mutex mutex;                               /// Protects the above, apart from the tables
+        std::condition_variable changed;                /// Signalled whenever any of the above changes
+        std::thread thread;
+    };
+
+    /**
+     * \brief Queues a task for the thread of a shard, waiting if it already has MAX_PENDING_TASKS
+    */
+    static void push(Shard &shard, std::function<void(Tables&)> &&task);
+
+    /**
+     * \brief Runs the tasks of a shard as they are queued, until it is stopped
+    */
+    static void run(Shard &shard);
+
+    /**
+     * \brief Waits for every shard to finish all of its tasks
+    */
+    void wait() const;
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    int m_generated_id;     /// Next id of a record without one, as for Tables
+    size_t m_position;      /// Position of the next record among all those added, across updates
+};
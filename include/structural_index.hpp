@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * \brief Finds the characters which delimit json blocks, 64 bytes at a time
+ *
+ * Rather than branching on each character, a block of the response is compared against each
+ * character of interest at once, giving a bitmask per character in which bit i is set if byte i
+ * of the block matches. Escapes and strings are then resolved with arithmetic on the masks, so
+ * only the braces outside strings are left to look at one by one.
+ *
+ * On x86, the masks are computed with AVX2 or SSE2, whichever is the fastest this machine has,
+ * chosen once when the program starts. Every variant is built whatever the compiler targets, so
+ * they can also be checked against each other. Elsewhere, the bytes are classified one at a time.
+*/
+class StructuralIndex
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64; /// Number of bytes classified at a time; one bit of a mask each
+
+    /**
+     * \brief Bitmasks of the characters of interest in a block
+    */
+    struct Masks
+    {
+        uint64_t quote;         /// '"'
+        uint64_t backslash;     /// '\\'
+        uint64_t open_brace;    /// '{'
+        uint64_t close_brace;   /// '}'
+        uint64_t open_square;   /// '['
+        uint64_t close_square;  /// ']'
+        uint64_t whitespace;    /// Characters for which std::isspace() is true
+    };
+
+    /**
+     * \brief Classifies a block of the response
+     *
+     * \param data: Start of the block
+     * \param size: Number of bytes in the block, up to BLOCK_SIZE. No bits are set past the end.
+    */
+    static Masks classify(const char* data, size_t size);
+
+    /**
+     * \brief Ways of classifying a block
+    */
+    enum class Variant {
+        SCALAR,     /// One byte at a time
+        SSE2,       /// 16 bytes at a time, on x86
+        AVX2,       /// 32 bytes at a time, on x86
+    };
+
+    /**
+     * \brief Classifies a block of the response with the variant given, as classify() does with the fastest this
+     * machine supports. This is for checking the variants against each other.
+     *
+     * \param variant: Variant to classify with, which must be supported
+    */
+    static Masks classify(const char* data, size_t size, Variant variant);
+
+    /**
+     * \brief Returns true if the variant is built in, and this machine can run it
+    */
+    static bool is_supported(Variant variant);
+
+    /**
+     * \brief Finds the characters escaped by a backslash, ie. those following an odd length run of backslashes
+     *
+     * \param backslash: Mask of the backslashes in the block
+     * \param size: Number of bytes in the block
+     * \param carry: 1 if the first character of the block is escaped by the previous block. Set to
+     * 1 if the character following the block is escaped, otherwise 0.
+    */
+    static uint64_t find_escaped(uint64_t backslash, size_t size, uint64_t &carry);
+
+    /**
+     * \brief Finds the characters inside strings, including the opening quotes but not the closing quotes
+     *
+     * \param quote: Mask of the unescaped quotes in the block
+     * \param carry: All ones if the block starts inside a string, otherwise 0. Set in the same
+     * way for the character following the block.
+    */
+    static uint64_t find_in_string(uint64_t quote, uint64_t &carry);
+
+    /**
+     * \brief Returns the first character which isn't whitespace, or end if there is none
+    */
+    static const char* skip_whitespace(const char* begin, const char* end);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+#include "flat_hash_map.hpp"
+#include "query_tables.hpp"
+
+/**
+ * \brief Interns strings, numbering each distinct string with a Symbol
+ *
+ * The responses hold the same few hundred names, cities and hobbies millions of times, so the
+ * tables hold a Symbol for each rather than a copy of the string. The symbols are numbered from 0
+ * in the order the strings are first seen, and strings are never removed.
+*/
+class SymbolTable
+{
+public:
+    /**
+     * \brief Constructor. The empty string is interned as EMPTY.
+    */
+    SymbolTable();
+
+    /**
+     * \brief Returns the symbol of a string, interning it if it hasn't been seen before
+    */
+    Symbol intern(std::string_view str);
+
+    /**
+     * \brief Returns the string of a symbol returned by intern()
+    */
+    const std::string& get_string(Symbol symbol) const;
+
+    /**
+     * \brief Returns the number of strings interned, which is one more than the last symbol
+    */
+    size_t size() const;
+
+    static constexpr Symbol EMPTY = 0;  /// Symbol of the empty string
+
+private:
+    std::deque<std::string> m_strings;                      /// Strings by symbol. A deque doesn't move them as it grows, so the views in m_symbols stay valid
+    FlatHashMap<std::string_view, Symbol> m_symbols;        /// Symbols by string
+};
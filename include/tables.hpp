@@ -1,18 +1,32 @@
 #pragma once
 
-#include <map>
 #include <rapidjson/document.h>
+#include <string_view>
 #include <vector>
 
+#include "flat_hash_map.hpp"
+#include "partial_results.hpp"
 #include "query_tables.hpp"
+#include "symbol_table.hpp"
+#include "tables_interface.hpp"
 
 /**
  * \brief Class to accept records in rapidjson objects and populate normalised tables
  * 
  * Converting the data format into normalised tables helps to optimise the querying.
  * This should make any query possible, not just the ones required for the task.
+ * 
+ * The names, cities and hobbies are interned as they are added, and the tables hold their
+ * symbols. They are only turned back into strings for the results.
+ * 
+ * The citizens are held in columns, with a row per citizen. The totals the query needs, for each
+ * city and of each name and hobby, are kept up to date as citizens are added, replaced and
+ * removed, so the query only reads the totals rather than the citizens.
+ * 
+ * A query finds the user with most friends of any city where that user left in the totals themselves,
+ * so, although the queries are const, the methods are to be called from a single thread.
 */
-class Tables
+class Tables : public TablesInterface
 {
 public:
     /**
@@ -27,22 +41,166 @@ public:
      * The add_record() function will then perform some validation and add the record to
      * the tables.
      * 
+     * If a citizen with the same id is already in the tables, the record replaces it. A record
+     * identical to the one already held is only marked as seen, and given the position of the record
+     * if it is the citizen's first in the current update.
+     * 
      * \return true if record could be added successfully
     */
     bool add_record(const rapidjson::Value *record);
 
+    /**
+     * \brief Add a record whose fields have already been validated, eg. by a RecordHandler
+     * 
+     * If the record has no id, the next generated id is used, as for a rapidjson::Value. A record
+     * with a negative id is ignored.
+    */
+    void add_record(Record &&record);
+
+    /**
+     * \brief Add a batch of records whose fields have already been validated, eg. by DataObjects::next_batch()
+     * 
+     * The tables end up the same as if each record was passed to add_record() in turn, but the
+     * records new to the tables are added together, with the columns and the index of ids grown once
+     * for all of them. Records replacing a citizen are added one at a time.
+     * 
+     * \param records: Records to add, in the order they appear in the response. Their fields are moved from.
+     * \param n_records: Number of records
+    */
+    void add_records(Record *records, size_t n_records) override;
+
+    /**
+     * \brief Add a batch of records, as add_records(), where the tables only see some of the records of the response
+     * 
+     * \param positions: Position of each record in the whole response, eg. for a shard of ShardedTables. Of the citizens
+     *                   with most friends in a city, the one whose record came first is taken, so this must be given
+     *                   for every record or none.
+    */
+    void add_records(Record *records, size_t n_records, const size_t *positions);
+
+    /**
+     * \brief Starts updating the tables from a fresh response of the endpoint
+     * 
+     * Records without an id are numbered from 1 again, so they replace the records in the same
+     * position of the previous response. Call end_update() once every record has been added,
+     * and before query_results().
+    */
+    void begin_update() override;
+
+    /**
+     * \brief Ends the update, removing every citizen which was not in the latest response
+    */
+    void end_update() override;
+
     /**
      * \brief Performs query on the records, and computes the values required by the task.
      * 
      * \returns Structure containing the computed results of the task.
     */
-    Results query_results() const;
+    Results query_results() const override;
+
+    /**
+     * \brief Returns the totals the results are computed from, to be merged with those of other tables
+     * 
+     * The results of these totals on their own are the same as query_results().
+    */
+    PartialResults partial_results() const;
+
+    /**
+     * \brief Sets the number of threads to search the citizens with, when a city's user with most friends has to be found again
+     * 
+     * Each thread searches its own range of rows for the users with most friends, and the users found by each are then
+     * compared, so the results are the same as on a single thread. The search runs at the end of an update, or in the next
+     * query if that comes first, only if a user with most friends has left their city or lost friends.
+     * 
+     * \param n_threads: Largest number of threads to search with, including the calling thread. 1, the default, searches
+     *                   on the calling thread.
+     * \param min_rows: Smallest number of rows searched by each thread
+    */
+    void set_search_threads(unsigned int n_threads, size_t min_rows = DEFAULT_MIN_SEARCH_ROWS);
+
+    static constexpr size_t DEFAULT_MIN_SEARCH_ROWS = 256 * 1024;  /// Default number of rows below which a range isn't worth a thread
 protected:
-    std::map<std::string, std::vector<unsigned int>> m_city_citizen;    /// One to many Table associating cities with citizen IDs
-    std::map<unsigned int, Citizen> m_citizen;                          /// One to one Table associating citizens with their IDs
-    std::map<unsigned int, std::vector<Friend>> m_citizen_friends;      /// One to many Table associating citizens with their friends
-    std::map<std::string, std::vector<std::string>> m_hobby_friends;    /// One to many Table associating hobbies with friends
+    SymbolTable m_symbols;                                      /// Strings of the symbols held in the tables
+    CitizenTable m_citizens;                                    /// Citizens and their friends, a row each
+    FlatHashMap<unsigned int, unsigned int> m_citizen_rows;     /// One to one Table associating citizen IDs with their rows
+    mutable std::vector<CityTotals> m_city_totals;              /// Totals of the citizens of each city, by symbol. Stale cities are found again by queries.
+    std::vector<Symbol> m_cities;                               /// Cities which have had citizens, in order of name
+    std::vector<unsigned int> m_name_counts;                    /// Number of citizens in a city with each name, by symbol
+    std::vector<unsigned int> m_hobby_counts;                   /// Number of friends with each hobby, by symbol
 
 private:
-    int m_generated_id; /// Not all records contain a citizen id. If abscent, this is used instead
+    /**
+     * \brief Adds citizens to the tables which aren't in them already, as add_record() would in turn
+     * 
+     * \param records: Records of the batch, with their ids already set
+     * \param new_records: Indices of the records to add, in order. Each has a different id.
+    */
+    void add_new_records(Record *records, const std::vector<size_t> &new_records, const size_t *positions);
+
+    /**
+     * \brief Adds a record, as add_record(), where the citizen takes the city order given if it is their first record
+     * in the update, or they join a city
+    */
+    void add_record(Record &&record, size_t city_order);
+
+    /**
+     * \brief Interns a string, making room for its symbol in the totals and counts
+    */
+    Symbol intern(std::string_view str);
+
+    /**
+     * \brief Interns the names and hobbies of the friends of a record
+    */
+    std::vector<CitizenFriend> intern_friends(const std::vector<Friend> &friends);
+
+    /**
+     * \brief Appends a row for a citizen without friends to m_citizens
+     * 
+     * \return The row of the citizen
+    */
+    unsigned int add_citizen(unsigned int citizen_id, Symbol name, int age, Symbol city, size_t city_order);
+
+    /**
+     * \brief Adds the friends of the citizen in a row, and their hobbies, to the tables
+    */
+    void add_friends(unsigned int row, std::vector<CitizenFriend> &&friends);
+
+    /**
+     * \brief Removes the friends of the citizen in a row, and their hobbies, from the tables
+    */
+    void remove_friends(unsigned int row);
+
+    /**
+     * \brief Adds the citizen in a row, with their friends, to the totals of their city and the name counts
+    */
+    void join_city(unsigned int row);
+
+    /**
+     * \brief Takes the citizen in a row, with their friends, out of the totals of their city and the name counts
+     * 
+     * If they were the user with most friends, the city is marked stale.
+    */
+    void leave_city(unsigned int row);
+
+    /**
+     * \brief Finds the user with most friends of each stale city again, from the rows of the citizens
+     * 
+     * \param cities: Totals of the cities by symbol, eg. m_city_totals
+    */
+    void find_most_friends(std::vector<CityTotals> &cities) const;
+
+    /**
+     * \brief Returns the totals of the cities, once the user with most friends of any stale city has been found again
+     * 
+     * The users are found in m_city_totals itself, so a city is only searched for once each time it goes stale.
+    */
+    const std::vector<CityTotals>& get_city_totals() const;
+
+    int m_generated_id;             /// Not all records contain a citizen id. If abscent, this is used instead
+    size_t m_city_order;            /// Next value of CitizenTable::city_order, unless the positions of the records are given
+    unsigned int m_update;          /// Number of the current update; 0 until begin_update() is first called
+    mutable bool m_stale_cities;    /// Set once a city has been marked stale, until find_most_friends() is run on m_city_totals
+    unsigned int m_search_threads;  /// Largest number of threads find_most_friends() searches with
+    size_t m_min_search_rows;       /// Smallest number of rows find_most_friends() searches on each thread
 };
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include "query_tables.hpp"
+
+/**
+ * \brief Tables the ingest paths populate, whether a single Tables or a ShardedTables
+ *
+ * The Pipeline, FanOut and ParallelParser only add batches of records, and the program only
+ * updates and queries the tables, so these are all that is needed to swap one for the other.
+*/
+class TablesInterface
+{
+public:
+    virtual ~TablesInterface() = default;
+
+    /**
+     * \brief Add a batch of records whose fields have already been validated, eg. by DataObjects::next_batch()
+     *
+     * \param records: Records to add, in the order they appear in the response. Their fields are moved from.
+     * \param n_records: Number of records
+    */
+    virtual void add_records(Record *records, size_t n_records) = 0;
+
+    /**
+     * \brief Starts updating the tables from a fresh response of the endpoint
+    */
+    virtual void begin_update() = 0;
+
+    /**
+     * \brief Ends the update, removing every citizen which was not in the latest response
+    */
+    virtual void end_update() = 0;
+
+    /**
+     * \brief Computes the results of the task from the tables
+    */
+    virtual Results query_results() const = 0;
+};
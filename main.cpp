@@ -7,68 +7,486 @@
  *     the most common hobby of all friends of users in all cities
 */
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "client.hpp"
 #include "data_objects.hpp"
+#include "fan_out.hpp"
+#include "logger.hpp"
+#include "mapped_file.hpp"
+#include "multi_client.hpp"
+#include "parallel_parser.hpp"
+#include "pipeline.hpp"
 #include "query_to_json.hpp"
+#include "response_cache.hpp"
+#include "sharded_tables.hpp"
 #include "tables.hpp"
 
-int main(int argc, const char* argv[])
+namespace
+{
+/**
+ * \brief Outcome of querying the endpoint(s) and populating the tables
+*/
+enum class Outcome {
+    OK,             /// Tables were populated
+    QUERY_ERROR,    /// Failed to query an endpoint
+    FORMAT_ERROR,   /// Some of the response could not be parsed
+    NOT_MODIFIED,   /// The response hasn't changed, and the results cached with it were loaded instead
+};
+
+/**
+ * \brief Adds every record from the parsed response to the tables
+*/
+Outcome add_records(DataObjects& json_objects, TablesInterface& tables)
 {
-    enum {ENDPOINT_ARG=1, NUM_ARGS};
+    // Populate tables with the records a batch at a time as they are parsed
+    std::vector<Record> batch;
+    while (json_objects.next_batch(batch))
+    {
+        tables.add_records(batch.data(), batch.size());
+        batch.clear();
+    }
 
-    if (argc != NUM_ARGS)
+    if (json_objects.get_error() != DataObjects::ErrorType::NONE)
     {
-        std::cerr << "Wrong number of arguments. Expecting endpoint as the argument" << std::endl;
-        std::cerr << std::endl;
-        exit(1);
+        return Outcome::FORMAT_ERROR;
+    }
+    return Outcome::OK;
+}
+
+/**
+ * \brief Adds every record from a whole response to the tables, parsing it on several threads
+ *
+ * \param max_skipped: Largest fraction of the response which may be skipped over ill formatted
+ * json, or negative to stop at the first
+*/
+Outcome add_records(const char* data, size_t size, long n_threads, double max_skipped, TablesInterface& tables)
+{
+    ParallelParser parser(tables, static_cast<unsigned int>(n_threads));
+    if (max_skipped >= 0)
+    {
+        parser.set_recovery(max_skipped);
+    }
+    parser.parse(data, size);
+
+    if (parser.get_error() != ParallelParser::ErrorType::NONE)
+    {
+        return Outcome::FORMAT_ERROR;
+    }
+    return Outcome::OK;
+}
+
+/**
+ * \brief Replays captured responses, populating the tables
+ * 
+ * Each capture is mapped into memory and parsed in place, without being read into a buffer.
+ *
+ * \param n_threads: Number of threads to parse each capture with
+ * \param max_skipped: Largest fraction of each capture which may be skipped over ill formatted
+ * json, or negative to stop at the first
+*/
+Outcome populate_tables(const std::vector<std::string>& captures, long n_threads, double max_skipped, TablesInterface& tables)
+{
+    for (const auto& capture : captures)
+    {
+        MappedFile mapping(capture.c_str());
+        if (mapping.get_error() != MappedFile::ErrorType::NONE)
+        {
+            return Outcome::QUERY_ERROR;
+        }
+        if (mapping.get_size() == 0)
+        {
+            // An empty capture holds no records, rather than being ill formatted
+            LogMessage(Logger::Level::WARNING) << "The capture " << capture << " is empty";
+            continue;
+        }
+
+        Outcome outcome;
+        if (n_threads > 1)
+        {
+            outcome = add_records(mapping.get_data(), mapping.get_size(), n_threads, max_skipped, tables);
+        }
+        else
+        {
+            DataObjects json_objects(mapping.get_data(), mapping.get_size());
+            if (max_skipped >= 0)
+            {
+                json_objects.set_recovery(max_skipped);
+            }
+            outcome = add_records(json_objects, tables);
+        }
+        if (outcome != Outcome::OK)
+        {
+            return outcome;
+        }
+    }
+    return Outcome::OK;
+}
+
+/**
+ * \brief Queries all of the endpoints at the same time, populating the same tables
+ *
+ * \param max_skipped: Largest fraction of each response which may be skipped over ill formatted
+ * json, or negative to stop at the first
+*/
+Outcome populate_tables(MultiClient& client, double max_skipped, TablesInterface& tables)
+{
+    FanOut fan_out(client, tables);
+    if (max_skipped >= 0)
+    {
+        fan_out.set_recovery(max_skipped);
+    }
+    fan_out.run();
+
+    if (fan_out.get_error() == FanOut::ErrorType::QUERY)
+    {
+        return Outcome::QUERY_ERROR;
+    }
+    if (fan_out.get_error() == FanOut::ErrorType::FORMAT)
+    {
+        return Outcome::FORMAT_ERROR;
+    }
+    return Outcome::OK;
+}
+
+/**
+ * \brief Queries a single endpoint, populating the tables
+ *
+ * \param pipelined: Download, parse and populate the tables concurrently
+ * \param n_ranges: Number of ranges of the response to download in parallel
+ * \param n_threads: Number of threads to parse the response with, once it has been downloaded
+ * \param max_skipped: Largest fraction of the response which may be skipped over ill formatted
+ * json, or negative to stop at the first
+ * \param cache: Cache of the client's responses, or nullptr. If the response hasn't changed since
+ * it was cached with its results, these are loaded into cached_results and the tables are left alone.
+*/
+Outcome populate_tables(Client& client, bool pipelined, long n_ranges, long n_threads, double max_skipped,
+                        const ResponseCache* cache, const std::string& endpoint, Results& cached_results, TablesInterface& tables)
+{
+    if (pipelined)
+    {
+        Pipeline pipeline(client, tables);
+        if (max_skipped >= 0)
+        {
+            pipeline.set_recovery(max_skipped);
+        }
+        pipeline.run();
+
+        if (pipeline.get_error() == Pipeline::ErrorType::QUERY)
+        {
+            return Outcome::QUERY_ERROR;
+        }
+        if (pipeline.get_error() == Pipeline::ErrorType::FORMAT)
+        {
+            return Outcome::FORMAT_ERROR;
+        }
+        return Outcome::OK;
+    }
+
+    if (n_ranges > 1)
+    {
+        client.query_endpoint_ranged(n_ranges);
+    }
+    else
+    {
+        client.query_endpoint();
     }
 
-    Client client(argv[ENDPOINT_ARG]);
-    client.query_endpoint();
-    
     if (client.get_error() != Client::ErrorType::NONE)
     {
-        std::cerr << "Error occured" << std::endl;
-        std::cerr << std::endl;
-        exit(1);
+        return Outcome::QUERY_ERROR;
+    }
+
+    // Nothing to parse if the results of this response are cached
+    if (client.is_not_modified() && cache && cache->load_results(endpoint, cached_results))
+    {
+        return Outcome::NOT_MODIFIED;
     }
 
     // Get the response in full
     auto& response = client.get_response();
+    if (n_threads > 1)
+    {
+        return add_records(response.data(), response.size(), n_threads, max_skipped, tables);
+    }
 
     // Parse the response into rapidjson objects
     DataObjects json_objects(std::move(response));
-    Tables tables;
-    int n_bad_records = 0;
-    
-    // For every object, populate tables with the data
-    auto json_doc = json_objects.get_next_object();
-    while(json_doc != nullptr)
+    if (max_skipped >= 0)
     {
-        if(!tables.add_record(json_doc))
+        json_objects.set_recovery(max_skipped);
+    }
+    return add_records(json_objects, tables);
+}
+
+/**
+ * \brief Logs an error outcome
+*/
+void report(Outcome outcome)
+{
+    if (outcome == Outcome::QUERY_ERROR)
+    {
+        LogMessage(Logger::Level::ERROR) << "Error occured";
+    }
+    if (outcome == Outcome::FORMAT_ERROR)
+    {
+        LogMessage(Logger::Level::ERROR) << "Some parsing error has occurred";
+    }
+}
+
+/**
+ * \brief Outputs the results as JSON
+*/
+void output_results(const Results& results)
+{
+    // Format the data and output
+    QueryToJson query_json(results);
+
+    std::cout << query_json.get_json();
+
+    std::cout << std::endl;
+}
+
+/**
+ * \brief Queries the tables, and outputs the results
+ *
+ * \param cache: If set, the results are cached with the endpoint's response
+*/
+void output_results(const TablesInterface& tables, ResponseCache* cache, const std::string& endpoint)
+{
+    // Query the tables
+    auto query = tables.query_results();
+
+    output_results(query);
+    if (cache)
+    {
+        cache->store_results(endpoint, query);
+    }
+}
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+    std::vector<std::string> endpoints;
+    std::string capture_path;   // Replay captured responses from this file or directory instead of querying
+    std::string cache_path;     // Cache responses, and their results, in this directory
+    bool pipelined = false;     // Parse the response while it is still downloading
+    long max_connections = MultiClient::DEFAULT_MAX_CONNECTIONS;
+    long n_ranges = 1;          // Number of ranges of a single response to download in parallel
+    long n_threads = 1;         // Number of threads to parse a whole response with, and to search the citizens with
+    long n_shards = 1;          // If more than 1, add the records to this many shards of the tables, each on a thread of its own
+    long poll_seconds = 0;      // If set, query the endpoint(s) again at this interval, forever
+    bool compressed = true;     // Accept compressed responses
+    double max_skipped = -1;    // If not negative, skip ill formatted json, up to this fraction of each response
+    Client::RetryPolicy retry_policy;
+    bool bad_arguments = false;
+
+    for (int i_arg = 1; i_arg < argc; i_arg++)
+    {
+        const std::string arg = argv[i_arg];
+        if (arg == "--pipelined")
+        {
+            pipelined = true;
+        }
+        else if ((arg == "--connections") && (i_arg + 1 < argc))
+        {
+            max_connections = std::atol(argv[++i_arg]);
+            bad_arguments |= (max_connections <= 0);
+        }
+        else if ((arg == "--ranges") && (i_arg + 1 < argc))
+        {
+            n_ranges = std::atol(argv[++i_arg]);
+            bad_arguments |= (n_ranges <= 0);
+        }
+        else if ((arg == "--threads") && (i_arg + 1 < argc))
+        {
+            n_threads = std::atol(argv[++i_arg]);
+            bad_arguments |= (n_threads <= 0);
+        }
+        else if ((arg == "--shards") && (i_arg + 1 < argc))
+        {
+            n_shards = std::atol(argv[++i_arg]);
+            bad_arguments |= (n_shards <= 0);
+        }
+        else if ((arg == "--poll") && (i_arg + 1 < argc))
+        {
+            poll_seconds = std::atol(argv[++i_arg]);
+            bad_arguments |= (poll_seconds <= 0);
+        }
+        else if ((arg == "--retries") && (i_arg + 1 < argc))
+        {
+            const long n_retries = std::atol(argv[++i_arg]);
+            bad_arguments |= (n_retries < 0);
+            retry_policy.max_attempts = static_cast<int>(n_retries) + 1;
+        }
+        else if ((arg == "--hedge-after") && (i_arg + 1 < argc))
+        {
+            retry_policy.hedge_after = std::chrono::milliseconds(std::atol(argv[++i_arg]));
+            bad_arguments |= (retry_policy.hedge_after.count() <= 0);
+        }
+        else if ((arg == "--file") && (i_arg + 1 < argc))
+        {
+            capture_path = argv[++i_arg];
+        }
+        else if ((arg == "--cache") && (i_arg + 1 < argc))
+        {
+            cache_path = argv[++i_arg];
+        }
+        else if (arg == "--no-compression")
+        {
+            compressed = false;
+        }
+        else if ((arg == "--recover") && (i_arg + 1 < argc))
+        {
+            max_skipped = std::atof(argv[++i_arg]) / 100;
+            bad_arguments |= (max_skipped < 0) || (max_skipped > 1);
+        }
+        else if ((arg == "--log-level") && (i_arg + 1 < argc))
         {
-            n_bad_records++;
+            Logger::Level log_level = Logger::Level::INFO;
+            if (Logger::parse_level(argv[++i_arg], log_level))
+            {
+                Logger::get().set_level(log_level);
+            }
+            else
+            {
+                bad_arguments = true;
+            }
+        }
+        else if (arg.rfind("--", 0) != 0)
+        {
+            endpoints.push_back(arg);
+        }
+        else
+        {
+            bad_arguments = true;
         }
-        json_doc = json_objects.get_next_object();
     }
 
-    if (json_objects.get_error() != DataObjects::ErrorType::NONE)
+    // Several endpoints are always parsed as their responses arrive, so --pipelined would be ignored
+    if (pipelined && (endpoints.size() > 1))
+    {
+        std::cerr << "--pipelined applies to a single endpoint; the responses of several endpoints are always parsed as they arrive" << std::endl;
+        bad_arguments = true;
+    }
+
+    // The cache applies to a single endpoint queried in the default mode
+    bad_arguments |= !cache_path.empty() && ((endpoints.size() != 1) || pipelined || (n_ranges > 1));
+
+    if ((endpoints.empty() == capture_path.empty()) || bad_arguments)
     {
-        std::cerr << "Some parsing error has occurred" << std::endl;
+        std::cerr << "Wrong arguments. Expecting one or more endpoints, or --file, as the arguments" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " [--pipelined] [--ranges N] [--threads N] [--shards N] [--recover PERCENT] [--connections N] [--poll SECONDS] [--retries N] [--hedge-after MS] [--no-compression] [--log-level LEVEL] endpoint [endpoint...]" << std::endl;
+        std::cerr << "       " << argv[0] << " [--threads N] [--shards N] [--recover PERCENT] [--poll SECONDS] [--retries N] [--hedge-after MS] [--no-compression] [--log-level LEVEL] --cache directory endpoint" << std::endl;
+        std::cerr << "       " << argv[0] << " [--threads N] [--shards N] [--recover PERCENT] [--poll SECONDS] [--log-level LEVEL] --file capture_file_or_directory" << std::endl;
         std::cerr << std::endl;
         exit(1);
     }
 
-    // Query the tables
-    auto query = tables.query_results();
+    // The clients, and so their connections, are kept for every poll
+    std::unique_ptr<MultiClient> multi_client;
+    std::unique_ptr<Client> client;
+    std::unique_ptr<ResponseCache> cache;
+    const std::vector<std::string> captures = capture_path.empty() ? std::vector<std::string>() : MappedFile::list_captures(capture_path);
+    if (!capture_path.empty())
+    {
+        // Replaying captures, so there is nothing to connect to
+        if (captures.empty())
+        {
+            LogMessage(Logger::Level::ERROR) << "No captures found in " << capture_path;
+            exit(1);
+        }
+    }
+    else if (endpoints.size() > 1)
+    {
+        multi_client.reset(new MultiClient(endpoints, max_connections, compressed));
+    }
+    else
+    {
+        client.reset(new Client(endpoints[0].c_str(), compressed));
+        client->set_retry_policy(retry_policy);
+        if (!cache_path.empty())
+        {
+            cache.reset(new ResponseCache(cache_path.c_str()));
+            if (cache->get_error() != ResponseCache::ErrorType::NONE)
+            {
+                exit(1);
+            }
+            client->set_cache(cache.get());
+        }
+    }
 
-    // Format the data and output
-    QueryToJson query_json(query);
+    // A single Tables searches its citizens with the parsing threads, while each shard has a thread of its own
+    std::unique_ptr<TablesInterface> tables_storage;
+    if (n_shards > 1)
+    {
+        tables_storage.reset(new ShardedTables(static_cast<unsigned int>(n_shards)));
+    }
+    else
+    {
+        Tables* single_tables = new Tables;
+        single_tables->set_search_threads(static_cast<unsigned int>(n_threads));
+        tables_storage.reset(single_tables);
+    }
+    TablesInterface& tables = *tables_storage;
+    Results cached_results;     // Results cached with a response which hasn't changed
+    const std::string endpoint = endpoints.empty() ? std::string() : endpoints[0];
+    auto populate = [&]()
+    {
+        return !captures.empty() ? populate_tables(captures, n_threads, max_skipped, tables) :
+               multi_client ? populate_tables(*multi_client, max_skipped, tables) :
+                              populate_tables(*client, pipelined, n_ranges, n_threads, max_skipped, cache.get(), endpoint,
+                                              cached_results, tables);
+    };
 
-    std::cout << query_json.get_json();
+    if (poll_seconds == 0)
+    {
+        Outcome outcome = populate();
+        if (outcome == Outcome::NOT_MODIFIED)
+        {
+            output_results(cached_results);
+            exit(0);
+        }
+        if (outcome != Outcome::OK)
+        {
+            report(outcome);
+            exit(1);
+        }
 
-    std::cout << std::endl;
-    exit(0);
+        output_results(tables, cache.get(), endpoint);
+        exit(0);
+    }
+
+    // Poll forever, updating the same tables in place
+    auto next_poll = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        tables.begin_update();
+        Outcome outcome = populate();
+        if (outcome == Outcome::OK)
+        {
+            tables.end_update();
+            output_results(tables, cache.get(), endpoint);
+        }
+        else if (outcome == Outcome::NOT_MODIFIED)
+        {
+            // Nothing was added to the tables, so none of the citizens are removed
+            output_results(cached_results);
+        }
+        else
+        {
+            // Citizens missing from a failed response may still exist, so none are removed
+            report(outcome);
+        }
+
+        next_poll += std::chrono::seconds(poll_seconds);
+        std::this_thread::sleep_until(next_poll);
+    }
 }
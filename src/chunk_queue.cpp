@@ -0,0 +1,48 @@
+#include "chunk_queue.hpp"
+
+ChunkQueue::ChunkQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1), m_closed(false)
+{
+
+}
+
+bool ChunkQueue::push(std::string &&chunk)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_full.wait(lock, [this]{ return m_closed || (m_chunks.size() < m_capacity); });
+    if (m_closed)
+    {
+        return false;
+    }
+
+    m_chunks.emplace_back(std::move(chunk));
+    lock.unlock();
+    m_not_empty.notify_one();
+    return true;
+}
+
+bool ChunkQueue::pop(std::string &chunk)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_not_empty.wait(lock, [this]{ return m_closed || !m_chunks.empty(); });
+    if (m_chunks.empty())
+    {
+        // Closed, and nothing left to consume
+        return false;
+    }
+
+    chunk = std::move(m_chunks.front());
+    m_chunks.pop_front();
+    lock.unlock();
+    m_not_full.notify_one();
+    return true;
+}
+
+void ChunkQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_not_full.notify_all();
+    m_not_empty.notify_all();
+}
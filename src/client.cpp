@@ -1,70 +1,723 @@
-#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
 #include <string>
+#include <thread>
+#include <vector>
 #include <curl/curl.h>
 
 #include "client.hpp"
+#include "body_check.hpp"
+#include "chunk_queue.hpp"
+#include "data_objects.hpp"
+#include "logger.hpp"
 
 namespace
 {
 
+/**
+ * \brief Reports why a response was rejected
+ */
+void report_rejected(Client::ErrorType error, CURL* curl)
+{
+    if (error == Client::ErrorType::HTTP_STATUS)
+    {
+        long response_code = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+        LogMessage(Logger::Level::ERROR) << "endpoint responded with HTTP status " << response_code;
+    }
+    else
+    {
+        LogMessage(Logger::Level::ERROR) << "endpoint response is not json";
+    }
+}
+
+/**
+ * \brief Works out, and reports, the error of a finished transfer
+ * 
+ * \param rejected: Set by the write callback if it aborted the transfer
+ * \param conditional: The request was conditional, so a 304 Not Modified is not an error
+ * \param response_code: Receives the HTTP status of the response
+ */
+Client::ErrorType transfer_error(CURL* curl, CURLcode result, Client::ErrorType rejected, bool conditional, long* response_code)
+{
+    *response_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, response_code);
+    if (rejected != Client::ErrorType::NONE)
+    {
+        // Aborted by the write callback
+        report_rejected(rejected, curl);
+        return rejected;
+    }
+    if (result != CURLE_OK)
+    {
+        LogMessage(Logger::Level::ERROR) << "Query failed: " << curl_easy_strerror(result);
+        return Client::ErrorType::QUERY;
+    }
+    if (conditional && (*response_code == 304))
+    {
+        // The cached response is still current
+        return Client::ErrorType::NONE;
+    }
+    if ((*response_code < 200) || (*response_code >= 300))
+    {
+        // An error response without a body never reaches the write callback
+        report_rejected(Client::ErrorType::HTTP_STATUS, curl);
+        return Client::ErrorType::HTTP_STATUS;
+    }
+    return Client::ErrorType::NONE;
+}
+
+/**
+ * \brief String receiving the response
+*/
+struct BufferTarget
+{
+    std::string* output;
+    BodyCheck<Client::ErrorType> check;
+};
+
 /**
  * \brief Callback function to write the response data to a string
  */ 
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output)
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, BufferTarget* target)
+{
+    size_t totalSize = size * nmemb;
+    if (!target->check.check_chunk(static_cast<const char*>(contents), totalSize))
+    {
+        return 0;
+    }
+    target->output->append((char*)contents, totalSize);
+    return totalSize;
+}
+
+/**
+ * \brief Queue receiving the response, and the number of bytes passed to it
+*/
+struct QueueTarget
+{
+    ChunkQueue* queue;
+    size_t n_bytes;
+    BodyCheck<Client::ErrorType> check;
+};
+
+/**
+ * \brief Callback function to pass the response data to a queue as it arrives
+ */ 
+size_t QueueCallback(void* contents, size_t size, size_t nmemb, QueueTarget* target)
+{
+    size_t totalSize = size * nmemb;
+    if (!target->check.check_chunk(static_cast<const char*>(contents), totalSize))
+    {
+        return 0;
+    }
+    if (!target->queue->push(std::string(static_cast<const char*>(contents), totalSize)))
+    {
+        // The consumer has closed the queue. Returning a short count aborts the transfer.
+        return 0;
+    }
+    target->n_bytes += totalSize;
+    return totalSize;
+}
+
+/**
+ * \brief Callback function to note whether the server accepts byte ranges
+ */ 
+size_t AcceptRangesCallback(char* buffer, size_t size, size_t nitems, bool* accept_ranges)
+{
+    size_t totalSize = size * nitems;
+    std::string header(buffer, totalSize);
+    std::transform(header.begin(), header.end(), header.begin(), [](unsigned char c){ return std::tolower(c); });
+    if ((header.rfind("accept-ranges:", 0) == 0) && (header.find("bytes") != std::string::npos))
+    {
+        *accept_ranges = true;
+    }
+    return totalSize;
+}
+
+/**
+ * \brief Callback function to note the validators of the response, so it can be cached with them
+ */ 
+size_t ValidatorsCallback(char* buffer, size_t size, size_t nitems, ResponseCache::Validators* validators)
+{
+    size_t totalSize = size * nitems;
+    std::string header(buffer, totalSize);
+    if (header.rfind("HTTP/", 0) == 0)
+    {
+        // The status line of a new response, eg. after a redirect
+        *validators = ResponseCache::Validators();
+        return totalSize;
+    }
+
+    const size_t colon = header.find(':');
+    if (colon == std::string::npos)
+    {
+        return totalSize;
+    }
+    std::string name = header.substr(0, colon);
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c){ return std::tolower(c); });
+    const size_t value_start = header.find_first_not_of(" \t", colon + 1);
+    const size_t value_end = header.find_last_not_of(" \t\r\n");
+    const std::string value = ((value_start == std::string::npos) || (value_end < value_start)) ?
+                              "" : header.substr(value_start, value_end - value_start + 1);
+    if (name == "etag")
+    {
+        validators->etag = value;
+    }
+    else if (name == "last-modified")
+    {
+        validators->last_modified = value;
+    }
+    return totalSize;
+}
+
+/**
+ * \brief A contiguous part of the response, requested on its own connection
+*/
+struct RangeSegment
+{
+    char* destination;                  /// Where the next byte of this segment is written
+    size_t remaining;                   /// Number of bytes of this segment still expected
+    BodyCheck<Client::ErrorType> check; /// Only the first segment starts where the json starts; the others are passed
+};
+
+/**
+ * \brief Callback function to write a segment of the response into its place in the buffer
+ */ 
+size_t RangeCallback(void* contents, size_t size, size_t nmemb, RangeSegment* segment)
 {
     size_t totalSize = size * nmemb;
-    output->append((char*)contents, totalSize);
+    if (!segment->check.check_chunk(static_cast<const char*>(contents), totalSize))
+    {
+        return 0;
+    }
+    if (totalSize > segment->remaining)
+    {
+        // The server sent more than the range. It may have ignored the Range header.
+        return 0;
+    }
+    std::memcpy(segment->destination, contents, totalSize);
+    segment->destination += totalSize;
+    segment->remaining -= totalSize;
     return totalSize;
 }
 } // namespace
 
-Client::Client(const char* endpoint) : m_enpoint(endpoint), m_error(ErrorType::NONE)
+Client::Client(const char* endpoint, bool compressed) :
+    m_multi(nullptr),
+    m_enpoint(endpoint),
+    m_compressed(compressed),
+    m_random(std::random_device()()),
+    m_cache(nullptr),
+    m_conditional(false),
+    m_not_modified(false),
+    m_response_code(0),
+    m_error(ErrorType::NONE)
 {
     // Initialize curl
     m_curl = curl_easy_init();
     if (!m_curl)
     {
-        std::cerr << "ERROR: could not intialise curl" << std::endl;
-        std::cerr << std::endl;
+        LogMessage(Logger::Level::ERROR) << "could not intialise curl";
         m_error = ErrorType::INIT;
+        return;
     }
 
+    // Keep the connection alive between queries, eg. when polling the endpoint
+    curl_easy_setopt(m_curl, CURLOPT_TCP_KEEPALIVE, 1L);
+
+    // An empty string offers every encoding curl was built with. The response is decoded in
+    // the write path, chunk by chunk, so nothing downstream sees the compressed data.
+    curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, m_compressed ? "" : nullptr);
 }
 
 Client::~Client()
 {
     // Clean up
     curl_easy_cleanup(m_curl);
+    curl_multi_cleanup(m_multi);
+}
 
+void Client::set_retry_policy(const RetryPolicy &policy)
+{
+    m_policy = policy;
+}
+
+void Client::set_cache(ResponseCache* cache)
+{
+    m_cache = cache;
 }
 
 void Client::query_endpoint()
 {
     if (!m_curl)
     {
-        std::cerr << "ERROR: curl was not intialised" << std::endl;
-        std::cerr << std::endl;
+        LogMessage(Logger::Level::ERROR) << "curl was not intialised";
         m_error = ErrorType::INIT;
         return;
     }
 
-    // Set the URL for the GET request
-    curl_easy_setopt(m_curl, CURLOPT_URL, m_enpoint.c_str());
+    const auto start = std::chrono::steady_clock::now();
+    m_stats = TransferStats();
+    m_not_modified = false;
+    if (m_cache)
+    {
+        query_conditional();
+    }
+    else
+    {
+        query_with_retries();
+    }
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Client::query_conditional()
+{
+    // Only ask for the response if it has changed since it was cached
+    ResponseCache::Validators cached;
+    struct curl_slist* conditions = nullptr;
+    if (m_cache->load_validators(m_enpoint, cached))
+    {
+        if (!cached.etag.empty())
+        {
+            conditions = curl_slist_append(conditions, ("If-None-Match: " + cached.etag).c_str());
+        }
+        if (!cached.last_modified.empty())
+        {
+            conditions = curl_slist_append(conditions, ("If-Modified-Since: " + cached.last_modified).c_str());
+        }
+    }
+
+    m_validators = ResponseCache::Validators();
+    m_conditional = (conditions != nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, conditions);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, ValidatorsCallback);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, &m_validators);
+
+    query_with_retries();
+
+    // Restore the handle to unconditional requests
+    curl_easy_setopt(m_curl, CURLOPT_HTTPHEADER, nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, nullptr);
+    curl_slist_free_all(conditions);
+    const bool conditional = m_conditional;
+    m_conditional = false;
 
-    // Set the callback function to handle the response
+    if (m_error != ErrorType::NONE)
+    {
+        return;
+    }
+    if (conditional && (m_response_code == 304))
+    {
+        if (m_cache->load_body(m_enpoint, m_response))
+        {
+            m_not_modified = true;
+            return;
+        }
+
+        // The cache has been removed since the validators were read
+        LogMessage(Logger::Level::WARNING) << "cached response is missing; querying again";
+        query_with_retries();
+        return;
+    }
+    if (!m_validators.etag.empty() || !m_validators.last_modified.empty())
+    {
+        m_cache->store_response(m_enpoint, m_validators, m_response);
+    }
+}
+
+void Client::query_with_retries()
+{
+    for (int attempt = 1; ; attempt++)
+    {
+        if (m_policy.hedge_after.count() > 0)
+        {
+            query_hedged();
+        }
+        else
+        {
+            // Set the callback function to handle the response
+            m_response.clear();
+            BufferTarget target {&m_response, {m_curl, false, ErrorType::NONE}};
+            curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+            curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &target);
+
+            perform_query(target.check.error);
+        }
+        m_stats.bytes_decoded = m_response.size();
+
+        if ((attempt >= m_policy.max_attempts) || !is_retryable())
+        {
+            return;
+        }
+        wait_before_retry(attempt);
+    }
+}
+
+void Client::query_hedged()
+{
+    if (!m_multi)
+    {
+        // Kept for the life of the Client, as it holds the connections for both requests
+        m_multi = curl_multi_init();
+        if (!m_multi)
+        {
+            LogMessage(Logger::Level::ERROR) << "could not intialise curl multi";
+            m_error = ErrorType::INIT;
+            return;
+        }
+    }
+
+    // The first request writes straight into the response, the hedged one into its own buffer
+    m_response.clear();
+    std::string hedge_response;
+    BufferTarget targets[2] = {{&m_response, {m_curl, false, ErrorType::NONE}},
+                               {&hedge_response, {nullptr, false, ErrorType::NONE}}};
+    curl_easy_setopt(m_curl, CURLOPT_URL, m_enpoint.c_str());
     curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &m_response);
+    curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &targets[0]);
+    curl_multi_add_handle(m_multi, m_curl);
+    m_stats.n_requests++;
 
-    // Perform the request
+    const auto hedge_time = std::chrono::steady_clock::now() + m_policy.hedge_after;
+    CURL* hedge = nullptr;
+    CURL* winner = nullptr;
+    int n_active = 1;
+    m_error = ErrorType::NONE;
+
+    while ((winner == nullptr) && (n_active > 0))
+    {
+        int n_running = 0;
+        CURLMcode mres = curl_multi_perform(m_multi, &n_running);
+
+        // Send the second request if the first is taking too long
+        const auto now = std::chrono::steady_clock::now();
+        if ((mres == CURLM_OK) && (hedge == nullptr) && (now >= hedge_time))
+        {
+            hedge = curl_easy_duphandle(m_curl);
+            if (hedge)
+            {
+                // The hedged request isn't conditional, and its response isn't cached
+                curl_easy_setopt(hedge, CURLOPT_HTTPHEADER, nullptr);
+                curl_easy_setopt(hedge, CURLOPT_HEADERFUNCTION, nullptr);
+                curl_easy_setopt(hedge, CURLOPT_HEADERDATA, nullptr);
+                targets[1].check.curl = hedge;
+                curl_easy_setopt(hedge, CURLOPT_WRITEDATA, &targets[1]);
+                curl_multi_add_handle(m_multi, hedge);
+                m_stats.n_requests++;
+                n_active++;
+                continue;
+            }
+        }
+
+        if ((mres == CURLM_OK) && (n_running > 0))
+        {
+            const auto wait = (hedge == nullptr) ?
+                std::chrono::duration_cast<std::chrono::milliseconds>(hedge_time - now).count() + 1 : 1000;
+            mres = curl_multi_poll(m_multi, nullptr, 0, static_cast<int>(std::min<long long>(wait, 1000)), nullptr);
+        }
+        if (mres != CURLM_OK)
+        {
+            LogMessage(Logger::Level::ERROR) << "curl_multi_perform() failed: " << curl_multi_strerror(mres);
+            m_error = ErrorType::QUERY;
+            break;
+        }
+
+        // Keep whichever request succeeds first. A failed request leaves the other to finish.
+        int n_messages = 0;
+        CURLMsg* message = curl_multi_info_read(m_multi, &n_messages);
+        while ((message != nullptr) && (winner == nullptr))
+        {
+            if (message->msg == CURLMSG_DONE)
+            {
+                BufferTarget& target = (message->easy_handle == m_curl) ? targets[0] : targets[1];
+                const bool conditional = m_conditional && (message->easy_handle == m_curl);
+                m_error = transfer_error(message->easy_handle, message->data.result, target.check.error, conditional, &m_response_code);
+                if (m_error == ErrorType::NONE)
+                {
+                    winner = message->easy_handle;
+                }
+                curl_multi_remove_handle(m_multi, message->easy_handle);
+                n_active--;
+            }
+            message = curl_multi_info_read(m_multi, &n_messages);
+        }
+    }
+
+    // Abandon the request which didn't finish first
+    curl_off_t n_received = 0;
+    curl_multi_remove_handle(m_multi, m_curl);
+    curl_easy_getinfo(m_curl, CURLINFO_SIZE_DOWNLOAD_T, &n_received);
+    m_stats.bytes_on_wire += static_cast<size_t>(n_received);
+    if (hedge)
+    {
+        curl_multi_remove_handle(m_multi, hedge);
+        curl_easy_getinfo(hedge, CURLINFO_SIZE_DOWNLOAD_T, &n_received);
+        m_stats.bytes_on_wire += static_cast<size_t>(n_received);
+        curl_easy_cleanup(hedge);
+    }
+
+    if ((winner != nullptr) && (winner == hedge))
+    {
+        m_response.swap(hedge_response);
+        m_validators = ResponseCache::Validators();
+    }
+    if (m_error != ErrorType::NONE)
+    {
+        m_response.clear();
+    }
+}
+
+bool Client::is_retryable() const
+{
+    switch (m_error)
+    {
+    case ErrorType::QUERY:
+    case ErrorType::NON_JSON_BODY:
+        // The endpoint fails intermittently, sometimes with an error page but a 200 status
+        return true;
+    case ErrorType::HTTP_STATUS:
+        // Only server errors and throttling are worth retrying; other client errors will recur
+        return (m_response_code >= 500) || (m_response_code == 429) || (m_response_code == 408);
+    default:
+        return false;
+    }
+}
+
+void Client::wait_before_retry(int attempt)
+{
+    // Full jitter: wait for a random time up to an exponentially growing bound, so that
+    // clients which failed together don't all retry together
+    const auto bound = std::min<std::chrono::milliseconds>(m_policy.max_backoff, m_policy.initial_backoff * (1LL << std::min(attempt - 1, 30)));
+    std::uniform_int_distribution<long long> distribution(0, bound.count());
+    const std::chrono::milliseconds wait(distribution(m_random));
+
+    LogMessage(Logger::Level::WARNING) << "retrying query in " << wait.count() << " ms (attempt " << attempt + 1
+                                       << " of " << m_policy.max_attempts << ")";
+    std::this_thread::sleep_for(wait);
+}
+
+void Client::query_endpoint_ranged(size_t n_segments)
+{
+    if (!m_curl)
+    {
+        LogMessage(Logger::Level::ERROR) << "curl was not intialised";
+        m_error = ErrorType::INIT;
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    m_stats = TransferStats();
+    m_not_modified = false;
+
+    // Ask for the size of the uncompressed response, and whether it can be requested in parts
+    bool accept_ranges = false;
+    curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_URL, m_enpoint.c_str());
+    curl_easy_setopt(m_curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, AcceptRangesCallback);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, &accept_ranges);
     CURLcode res = curl_easy_perform(m_curl);
+    m_stats.n_requests++;
 
-    // Check for errors
-    if (res != CURLE_OK)
+    curl_off_t content_length = -1;
+    long response_code = 0;
+    if (res == CURLE_OK)
     {
-        std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-        std::cerr << std::endl;
-        m_error = ErrorType::QUERY;
+        curl_easy_getinfo(m_curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length);
+        curl_easy_getinfo(m_curl, CURLINFO_RESPONSE_CODE, &response_code);
     }
+
+    // Restore the handle to plain GET requests
+    curl_easy_setopt(m_curl, CURLOPT_HEADERFUNCTION, nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_HEADERDATA, nullptr);
+    curl_easy_setopt(m_curl, CURLOPT_HTTPGET, 1L);
+
+    n_segments = std::min(n_segments, static_cast<size_t>(std::max<curl_off_t>(content_length, 0)) / MIN_RANGE_SEGMENT_SIZE);
+    if ((response_code == 200) && accept_ranges && (n_segments > 1))
+    {
+        const ErrorType range_error = query_ranges(static_cast<size_t>(content_length), n_segments);
+        curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, m_compressed ? "" : nullptr);
+        if ((range_error == ErrorType::NONE) || (range_error == ErrorType::NON_JSON_BODY))
+        {
+            // Querying again would only fetch the same body
+            m_error = range_error;
+            m_stats.bytes_decoded = m_response.size();
+            m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return;
+        }
+        LogMessage(Logger::Level::WARNING) << "ranged query failed; querying again as a single stream";
+    }
+    curl_easy_setopt(m_curl, CURLOPT_ACCEPT_ENCODING, m_compressed ? "" : nullptr);
+
+    query_with_retries();
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+Client::ErrorType Client::query_ranges(size_t content_length, size_t n_segments)
+{
+    CURLM* multi = curl_multi_init();
+    if (!multi)
+    {
+        return ErrorType::QUERY;
+    }
+
+    // The response is written straight into place, so the buffer is sized up front
+    m_response.clear();
+    m_response.resize(content_length);
+
+    const size_t segment_size = (content_length + n_segments - 1) / n_segments;
+    std::vector<RangeSegment> segments(n_segments);
+    std::vector<CURL*> handles(n_segments, nullptr);
+    bool ok = true;
+
+    for (size_t i_segment = 0; (i_segment < n_segments) && ok; i_segment++)
+    {
+        const size_t first = i_segment * segment_size;
+        const size_t last = std::min(first + segment_size, content_length) - 1;
+
+        handles[i_segment] = curl_easy_duphandle(m_curl);
+        if (!handles[i_segment])
+        {
+            ok = false;
+            break;
+        }
+        segments[i_segment] = {&m_response[first], last - first + 1, {handles[i_segment], i_segment > 0, ErrorType::NONE}};
+        const std::string range = std::to_string(first) + "-" + std::to_string(last);
+        curl_easy_setopt(handles[i_segment], CURLOPT_RANGE, range.c_str());
+        curl_easy_setopt(handles[i_segment], CURLOPT_WRITEFUNCTION, RangeCallback);
+        curl_easy_setopt(handles[i_segment], CURLOPT_WRITEDATA, &segments[i_segment]);
+        curl_multi_add_handle(multi, handles[i_segment]);
+    }
+
+    // Drive all of the segments until they have all ended
+    int n_running = 0;
+    while (ok)
+    {
+        CURLMcode mres = curl_multi_perform(multi, &n_running);
+        if ((mres == CURLM_OK) && (n_running > 0))
+        {
+            mres = curl_multi_poll(multi, nullptr, 0, 1000, nullptr);
+        }
+        if (mres != CURLM_OK)
+        {
+            LogMessage(Logger::Level::ERROR) << "curl_multi_perform() failed: " << curl_multi_strerror(mres);
+            ok = false;
+        }
+
+        int n_messages = 0;
+        CURLMsg* message = curl_multi_info_read(multi, &n_messages);
+        while (message != nullptr)
+        {
+            if ((message->msg == CURLMSG_DONE) && (message->data.result != CURLE_OK))
+            {
+                LogMessage(Logger::Level::ERROR) << "Ranged query failed: " << curl_easy_strerror(message->data.result);
+                ok = false;
+            }
+            message = curl_multi_info_read(multi, &n_messages);
+        }
+
+        if (n_running == 0)
+        {
+            break;
+        }
+    }
+
+    // Every segment must be a partial response, complete to the last byte
+    const ErrorType rejected = segments[0].check.error;
+    if ((rejected != ErrorType::NONE) && handles[0])
+    {
+        report_rejected(rejected, handles[0]);
+    }
+    for (size_t i_segment = 0; i_segment < n_segments; i_segment++)
+    {
+        if (handles[i_segment])
+        {
+            long response_code = 0;
+            curl_off_t n_received = 0;
+            curl_easy_getinfo(handles[i_segment], CURLINFO_RESPONSE_CODE, &response_code);
+            curl_easy_getinfo(handles[i_segment], CURLINFO_SIZE_DOWNLOAD_T, &n_received);
+            ok = ok && (response_code == 206) && (segments[i_segment].remaining == 0);
+            m_stats.bytes_on_wire += static_cast<size_t>(n_received);
+            m_stats.n_requests++;
+
+            curl_multi_remove_handle(multi, handles[i_segment]);
+            curl_easy_cleanup(handles[i_segment]);
+        }
+    }
+    curl_multi_cleanup(multi);
+
+    if (rejected != ErrorType::NONE)
+    {
+        m_response.clear();
+        return rejected;
+    }
+    if (!ok)
+    {
+        m_response.clear();
+        return ErrorType::QUERY;
+    }
+    return ErrorType::NONE;
+}
+
+void Client::query_endpoint(ChunkQueue &queue)
+{
+    if (!m_curl)
+    {
+        LogMessage(Logger::Level::ERROR) << "curl was not intialised";
+        m_error = ErrorType::INIT;
+        queue.close();
+        return;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    m_stats = TransferStats();
+    m_not_modified = false;
+    for (int attempt = 1; ; attempt++)
+    {
+        // Set the callback function to stream the response into the queue
+        QueueTarget target {&queue, 0, {m_curl, false, ErrorType::NONE}};
+        curl_easy_setopt(m_curl, CURLOPT_WRITEFUNCTION, QueueCallback);
+        curl_easy_setopt(m_curl, CURLOPT_WRITEDATA, &target);
+
+        perform_query(target.check.error);
+        m_stats.bytes_decoded = target.n_bytes;
+
+        // Once the consumer has some of the response, a retry would give it a second copy
+        if ((target.n_bytes > 0) || (attempt >= m_policy.max_attempts) || !is_retryable())
+        {
+            break;
+        }
+        wait_before_retry(attempt);
+    }
+    m_stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Signal the end of the stream to the consumer
+    queue.close();
+}
+
+void Client::perform_query(const ErrorType &rejected)
+{
+    // Set the URL for the GET request
+    curl_easy_setopt(m_curl, CURLOPT_URL, m_enpoint.c_str());
+
+    // Perform the request
+    CURLcode res = curl_easy_perform(m_curl);
+    m_stats.n_requests++;
+
+    curl_off_t n_received = 0;
+    curl_easy_getinfo(m_curl, CURLINFO_SIZE_DOWNLOAD_T, &n_received);
+    m_stats.bytes_on_wire += static_cast<size_t>(n_received);
+
+    // Check for errors
+    m_error = transfer_error(m_curl, res, rejected, m_conditional, &m_response_code);
+}
+
+const Client::TransferStats &Client::get_transfer_stats() const
+{
+    return m_stats;
 }
 
 Client::ErrorType Client::get_error() const
@@ -75,4 +728,9 @@ Client::ErrorType Client::get_error() const
 const std::string &Client::get_response() const
 {
     return m_response;
+}
+
+bool Client::is_not_modified() const
+{
+    return m_not_modified;
 }
\ No newline at end of file
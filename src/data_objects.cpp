@@ -1,201 +1,601 @@
-#include <iostream>
+#include <algorithm>
 
 #include "data_objects.hpp"
+#include "logger.hpp"
+#include "record_handler.hpp"
+#include "structural_index.hpp"
 
-namespace
+DataObjects::DataObjects(const std::string &&json, size_t arena_size) :
+    m_error(ErrorType::NONE),
+    m_buffer(json),
+    m_view(nullptr),
+    m_view_size(0),
+    m_last_block_end(0),
+    m_finished(true),
+    m_discarded(0),
+    m_value_memory(arena_size),
+    m_stack_memory(PARSE_STACK_SIZE),
+    m_value_arena(new Arena(m_value_memory.data(), m_value_memory.size(), arena_size)),
+    m_stack_arena(new Arena(m_stack_memory.data(), m_stack_memory.size(), PARSE_STACK_SIZE)),
+    m_json_doc(m_value_arena.get(), ArenaDocument::kDefaultStackCapacity, m_stack_arena.get()),
+    m_array(ArrayState::NONE),
+    m_recover(false),
+    m_max_skipped_fraction(0),
+    m_n_skipped_bytes(0),
+    m_n_bad_records(0)
 {
-/**
- * \brief Parse a buffer to acquire json objects
- * 
- * The response does not always contain commas between objects. Sometimes the
- * objects are arrays and sometimes not. This function's responsibility is to
- * identify the start of a valid object and the end of that object, which will
- * successfully be parsed by the rapidjson document. So this might return a
- * single object if the buffer is not organised as an array. If it is organised
- * as an array, the whole array will be returned.
- * 
- * \returns Pair where first is the start of a valid block and second is the end.get_json_block
- * If the block is not valid, this will be indicated by a return value of 0,0.
-*/
-std::pair<size_t, size_t> get_json_block(const char* begin)
+
+}
+
+DataObjects::DataObjects(const char* data, size_t size, size_t arena_size) :
+    m_error(ErrorType::NONE),
+    m_view(data),
+    m_view_size(size),
+    m_last_block_end(0),
+    m_finished(true),
+    m_discarded(0),
+    m_value_memory(arena_size),
+    m_stack_memory(PARSE_STACK_SIZE),
+    m_value_arena(new Arena(m_value_memory.data(), m_value_memory.size(), arena_size)),
+    m_stack_arena(new Arena(m_stack_memory.data(), m_stack_memory.size(), PARSE_STACK_SIZE)),
+    m_json_doc(m_value_arena.get(), ArenaDocument::kDefaultStackCapacity, m_stack_arena.get()),
+    m_array(ArrayState::NONE),
+    m_recover(false),
+    m_max_skipped_fraction(0),
+    m_n_skipped_bytes(0),
+    m_n_bad_records(0)
 {
-    if ((begin == nullptr) || (*begin == '\0'))
+
+}
+
+DataObjects::DataObjects(size_t arena_size) :
+    m_error(ErrorType::NONE),
+    m_view(nullptr),
+    m_view_size(0),
+    m_last_block_end(0),
+    m_finished(false),
+    m_discarded(0),
+    m_value_memory(arena_size),
+    m_stack_memory(PARSE_STACK_SIZE),
+    m_value_arena(new Arena(m_value_memory.data(), m_value_memory.size(), arena_size)),
+    m_stack_arena(new Arena(m_stack_memory.data(), m_stack_memory.size(), PARSE_STACK_SIZE)),
+    m_json_doc(m_value_arena.get(), ArenaDocument::kDefaultStackCapacity, m_stack_arena.get()),
+    m_array(ArrayState::NONE),
+    m_recover(false),
+    m_max_skipped_fraction(0),
+    m_n_skipped_bytes(0),
+    m_n_bad_records(0)
+{
+
+}
+
+void DataObjects::feed(const char* data, size_t size)
+{
+    // Drop the blocks that have already been parsed. This is only done once they take up at least
+    // half the buffer, so that the unfinished tail is moved a linear number of times in total.
+    if ((m_last_block_end > 0) && (m_last_block_end >= m_buffer.size() - m_last_block_end))
     {
-        return std::pair<size_t, size_t>(0, 0);
+        m_buffer.erase(0, m_last_block_end);
+        m_discarded += m_last_block_end;
+        m_last_block_end = 0;
     }
 
-    enum brace_type {BRACE, SQUARE, NONE};
-    brace_type type = NONE;
-    const char open_brace[] = { '{', '[' };
-    const char close_brace[] = { '}', ']' };
-    const char* current = begin;
-    const char* json_start = nullptr;
-    int n_brace = 0;
-    bool in_quotes = false;
-    bool escaped = false;
+    m_buffer.append(data, size);
+}
+
+void DataObjects::finish()
+{
+    m_finished = true;
+}
+
+void DataObjects::set_recovery(double max_skipped_fraction)
+{
+    m_recover = true;
+    m_max_skipped_fraction = max_skipped_fraction;
+}
+
+const rapidjson::Value* DataObjects::get_next_object()
+{
+    const char* data = get_data();
 
-    do
+    // The elements of an array at the top level are returned one at a time
+    size_t block_offset;
+    size_t block_length;
+    while (find_next_block(block_offset, block_length) != Found::NOTHING)
     {
-        if (in_quotes)
+        // The previous block's values are no longer referred to, so its memory is reused for this one
+        m_json_doc.SetNull();
+        m_value_arena->Clear();
+        m_stack_arena->Clear();
+
+        if (!m_view && m_finished && !m_recover)
+        {
+            // The buffer is ours and won't grow any more, so the block is parsed in place. Strings are
+            // unescaped where they are, and the values point into the buffer rather than copies of it.
+            // Parsing stops at the end of the value, which the scan has already found. In recovery
+            // mode, the buffer is left as it is, for the search for the next record after an error.
+            m_json_doc.ParseInsitu<rapidjson::kParseStopWhenDoneFlag>(&m_buffer[block_offset]);
+        }
+        else
         {
-            // This is a valid string:
-            //    "\"\\"
-            // which evaluates to "\ in raw form.
-            // The first \" is escaped, but the second \" isn't.
-            if ((*current == '"') && (!escaped))
+            // A buffer held elsewhere is read only, and one still being fed may be moved by feed()
+            // while the value is in use, so the strings are copied into the document.
+            m_json_doc.Parse(data + block_offset, block_length);
+        }
+        if (!m_json_doc.HasParseError())
+        {
+            return &m_json_doc;
+        }
+
+        // A block parsed in place may have had some of its strings unescaped before the error
+        if (!handle_parse_error(block_offset, block_length))
+        {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool DataObjects::next_batch(std::vector<Record> &batch, size_t n)
+{
+    // A block after a parse error would be reported as a fresh start, so don't go on
+    if (m_error != ErrorType::NONE)
+    {
+        return false;
+    }
+
+    const size_t batch_size = batch.size();
+    RecordHandler records(batch);
+    bool parsed = false;
+    while ((batch.size() < n) && parse_next_block(records))
+    {
+        parsed = true;
+    }
+    m_n_bad_records += records.get_bad_records();
+    return parsed || (batch.size() > batch_size);
+}
+
+int DataObjects::get_bad_records() const
+{
+    return m_n_bad_records;
+}
+
+DataObjects::Found DataObjects::find_next_block(size_t &block_offset, size_t &block_length)
+{
+    while (true)
+    {
+        if (m_array != ArrayState::NONE)
+        {
+            if (find_next_element(block_offset, block_length))
             {
-                in_quotes = false;
+                return Found::ELEMENT;
             }
-            if ((*current == '\\') && (!escaped))
+            if ((m_array != ArrayState::NONE) || (m_error != ErrorType::NONE))
             {
-                escaped = true;
+                // The next element isn't complete, or the array is ill formatted
+                return Found::NOTHING;
+            }
+            // Otherwise the array has been closed or abandoned, and the next block may follow it
+        }
+
+        const char* data = get_data();
+        const size_t size = get_size();
+
+        if ((m_last_block_end == size) || (data[m_last_block_end] == '\0'))
+        {
+            // Reached end of string
+            if (m_finished && (m_discarded + m_last_block_end == 0))
+            {
+                LogMessage(Logger::Level::WARNING) << "This is an empty string: \"" << std::string(data, size) << "\"";
+                m_error = DataObjects::ErrorType::FORMAT;
             }
-            else
+            else if (m_finished)
             {
-                escaped = false;
+                check_skipped();
             }
+            return Found::NOTHING;
+        }
+
+        if (!scan_json_block())
+        {
+            if (!m_finished)
+            {
+                // The block may yet be completed by feed(). The scan will resume where it stopped.
+                return Found::NOTHING;
+            }
+
+            // block is not valid. Check whether this is due to end of buffer, or else bad formatting.
+            const char* end = data + size;
+            const char* white_space_check = StructuralIndex::skip_whitespace(data + m_last_block_end, end);
+
+            if((white_space_check == end) || (*white_space_check == '\0'))
+            {
+                // Got to the end of the buffer.
+                if (m_discarded + m_last_block_end == 0)
+                {
+                    LogMessage(Logger::Level::WARNING) << "This whole buffer was just white space: \"" << std::string(data, size)
+                                                       << "\"";
+                    m_error = DataObjects::ErrorType::FORMAT;
+                }
+                else
+                {
+                    check_skipped();
+                }
+                return Found::NOTHING;
+            }
+
+            // This is not the end of the buffer, therefore there's another issue. Either a block
+            // was never closed, or there is something other than json after the last block.
+            const size_t skip_from = white_space_check - data;
+            const size_t search_from = (m_scan.type == ScanState::NONE) ? skip_from : m_last_block_end + m_scan.json_start + 1;
+            if (handle_ill_formatted(skip_from, search_from))
+            {
+                continue;
+            }
+            return Found::NOTHING;
+        }
+
+        if (m_scan.type == ScanState::SQUARE)
+        {
+            // An array at the top level. Its elements follow the opening bracket.
+            m_last_block_end += m_scan.position;
+            m_scan = ScanState();
+            m_array = ArrayState::FIRST;
+            continue;
+        }
+
+        // JSON object has been successfully detected, and the next block follows it
+        block_offset = m_last_block_end + m_scan.json_start;
+        block_length = m_scan.position - m_scan.json_start;
+        m_last_block_end += m_scan.position;
+        m_scan = ScanState();
+        return Found::BLOCK;
+    }
+}
+
+bool DataObjects::find_next_element(size_t &block_offset, size_t &block_length)
+{
+    const char* data = get_data();
+    const char* end = data + get_size();
+
+    while (m_array != ArrayState::NONE)
+    {
+        const char* next = StructuralIndex::skip_whitespace(data + m_last_block_end, end);
+        if ((next == end) || (*next == '\0'))
+        {
+            if (m_finished && m_recover)
+            {
+                // Nothing is lost, since every element has been found
+                LogMessage(Logger::Level::WARNING) << "The array was not closed by the end of the response";
+                m_last_block_end = next - data;
+                m_array = ArrayState::NONE;
+            }
+            else if (m_finished)
+            {
+                LogMessage(Logger::Level::ERROR) << "The array was not closed by the end of the response";
+                m_error = ErrorType::FORMAT;
+            }
+            return false;
+        }
+        m_last_block_end = next - data;
+
+        if ((*next == ']') && (m_array != ArrayState::VALUE))
+        {
+            m_last_block_end++;
+            m_array = ArrayState::NONE;
+            return false;
+        }
+        if (m_array == ArrayState::COMMA)
+        {
+            if (*next == ',')
+            {
+                m_last_block_end++;
+                m_array = ArrayState::VALUE;
+                continue;
+            }
+
+            // This may be the start of the next record, so the search starts here
+            if (!handle_ill_formatted(m_last_block_end, m_last_block_end))
+            {
+                return false;
+            }
+            continue;
+        }
+
+        // The next element starts at m_last_block_end. Objects and arrays are found by their braces.
+        size_t length = 0;
+        if ((*next == '{') || (*next == '['))
+        {
+            if (!scan_json_block())
+            {
+                if (m_finished && handle_ill_formatted(m_last_block_end, m_last_block_end + 1))
+                {
+                    continue;
+                }
+                return false;
+            }
+            length = m_scan.position;
+            m_scan = ScanState();
         }
         else
         {
-            switch (*current)
+            // Any other value ends at its closing quote if it's a string, or else at the next delimiter.
+            // Elements like this are rare, so they are found a byte at a time. A value which isn't
+            // valid json is left for rapidjson to report.
+            const bool is_string = (*next == '"');
+            const char* current = next + (is_string ? 1 : 0);
+            bool complete = false;
+            for (; current < end; current++)
             {
-                case '"':
-                    in_quotes = true;
-                    break;
-                case '{':
-                    if (type == NONE)
-                    {
-                        type = BRACE;
-                        json_start = current;
-                    }
-                    break;
-                case '[':
-                    if (type == NONE)
+                if (is_string && (*current == '\\'))
+                {
+                    // The escaped character may be in the next chunk, in which case the value is scanned again then
+                    if (current + 1 == end)
                     {
-                        type = SQUARE;
-                        json_start = current;
+                        break;
                     }
+                    current++;
+                }
+                else if (is_string ? (*current == '"') : ((*current == ',') || (*current == ']') || (*current == ' ') ||
+                                                          (*current == '\n') || (*current == '\r') || (*current == '\t')))
+                {
+                    complete = true;
                     break;
-                default:
-                    break;
+                }
             }
-            if ((type != NONE) && (!in_quotes))
+            current = std::min(current + (is_string && complete ? 1 : 0), end);
+            if (!complete && !m_finished)
             {
-                if (*current == open_brace[type])
-                {
-                    n_brace++;
-                }
-                if(*current == close_brace[type])
+                // The value may continue in the next chunk
+                return false;
+            }
+            length = current - next;
+            if (length == 0)
+            {
+                // A comma or closing bracket where a value should be
+                if (handle_ill_formatted(m_last_block_end, m_last_block_end))
                 {
-                    n_brace--;
+                    continue;
                 }
+                return false;
             }
         }
-        current++;
-    }while((type == NONE || n_brace != 0) && (*current != '\0'));
 
-    return ((type != NONE) && (n_brace == 0)) ?
-        std::pair<size_t, size_t>((json_start - begin), (current - begin)) :
-        std::pair<size_t, size_t>(0, 0);
+        block_offset = m_last_block_end;
+        block_length = length;
+        m_last_block_end += length;
+        m_array = ArrayState::COMMA;
+        return true;
+    }
+    return false;
 }
-} // namespace
 
-DataObjects::DataObjects(const std::string &&json) :
-    m_error(ErrorType::NONE),
-    m_buffer(json),
-    m_last_block_end(0),
-    m_next_array_index(0)
+void DataObjects::report_ill_formatted()
 {
+    const char* data = get_data();
+    const size_t size = get_size();
+    LogMessage error_message(Logger::Level::ERROR);
+    error_message << "Ill formatted json block\n";
+    error_message << "    buffer length = " << m_discarded + size << "; last block end = " << m_discarded + m_last_block_end << ";\n\n";
+    error_message.excerpt(data + m_last_block_end, size - m_last_block_end);
+    m_error = ErrorType::FORMAT;
+}
 
+bool DataObjects::handle_ill_formatted(size_t skip_from, size_t search_from)
+{
+    if (!m_recover)
+    {
+        report_ill_formatted();
+        return false;
+    }
+    return skip_to_next_record(skip_from, search_from);
 }
 
-const rapidjson::Value* DataObjects::get_next_object()
+bool DataObjects::handle_parse_error(size_t block_offset, size_t block_length)
+{
+    if (!m_recover)
+    {
+        report_parse_error(block_offset, block_length);
+        return false;
+    }
+
+    // The block's braces balance, so it is skipped as a whole, and a record nested in it isn't
+    // mistaken for the next one. The scan has already moved past it.
+    add_skipped(block_offset, block_offset + block_length);
+    return !m_finished || check_skipped();
+}
+
+bool DataObjects::skip_to_next_record(size_t skip_from, size_t search_from)
 {
-    // If this has already been parsed and it's an array, then return the next item in the array
-    if (m_json_doc.IsArray())
+    const char* data = get_data();
+    const char* end = data + get_size();
+
+    // A record is an object with at least one key, or none. Anything more would be a guess at which
+    // keys come first. A brace whose next character hasn't arrived yet is where the scan resumes.
+    const char* next = data + search_from;
+    for (; next < end; next++)
     {
-        if (m_next_array_index < m_json_doc.Size())
+        next = std::find(next, end, '{');
+        if (next == end)
         {
-            return &m_json_doc[m_next_array_index++];
+            break;
         }
-        else
+        const char* key = StructuralIndex::skip_whitespace(next + 1, end);
+        if ((key == end) ? !m_finished : ((*key == '"') || (*key == '}')))
         {
-            // No more items in the array, but there might be another array in the buffer.
-            m_next_array_index = 0;
+            break;
         }
     }
-    if (m_buffer[m_last_block_end] == '\0')
+
+    // If there's no record in the rest of the buffer, it is all skipped, and the search carries on
+    // in the next chunk to arrive
+    const size_t resume = next - data;
+    if (resume > skip_from)
     {
-        // Reached end of string
-        if (m_last_block_end == 0)
-        {
-            std::cerr << "WARNING: This is an empty string: \"" << m_buffer << "\"" << std::endl;
-            std::cerr << std::endl;
-            m_error = DataObjects::ErrorType::FORMAT;
-        }
-        return nullptr;
+        add_skipped(skip_from, resume);
+    }
+    else
+    {
+        static LogType recovered(Logger::Level::WARNING, "recoveries from ill formatted json");
+        LogMessage(recovered) << "Recovered from ill formatted json at byte " << m_discarded + skip_from << " of the response";
+    }
+
+    // Within an array at the top level, the record is taken to be its next element
+    m_last_block_end = resume;
+    m_scan = ScanState();
+    m_array = ((m_array != ArrayState::NONE) && ((next != end) || !m_finished)) ? ArrayState::VALUE : ArrayState::NONE;
+    return !m_finished || check_skipped();
+}
+
+void DataObjects::add_skipped(size_t begin, size_t end)
+{
+    const SkippedRange skipped = {m_discarded + begin, m_discarded + end};
+    static LogType skipped_range(Logger::Level::WARNING, "ranges of ill formatted json skipped");
+    LogMessage(skipped_range) << "Skipped bytes " << skipped.begin << " to " << skipped.end << " of the response, which are ill formatted";
+
+    // A range skipped over several chunks, or in several steps, is kept as one
+    if (!m_skipped.empty() && (m_skipped.back().end == skipped.begin))
+    {
+        m_skipped.back().end = skipped.end;
     }
+    else
+    {
+        m_skipped.push_back(skipped);
+    }
+    m_n_skipped_bytes += skipped.end - skipped.begin;
+}
 
-    auto [current_block_start, current_block_end] = get_json_block(m_buffer.c_str() + m_last_block_end);
+bool DataObjects::check_skipped()
+{
+    const size_t n_bytes = m_discarded + get_size();
+    if ((m_error == ErrorType::NONE) && (m_n_skipped_bytes > m_max_skipped_fraction * n_bytes))
+    {
+        LogMessage(Logger::Level::ERROR) << "Skipped " << m_n_skipped_bytes << " of the " << n_bytes << " bytes of the response, "
+                                         << "more than the " << m_max_skipped_fraction * 100 << "% allowed";
+        m_error = ErrorType::FORMAT;
+    }
+    return (m_error == ErrorType::NONE);
+}
+
+void DataObjects::report_parse_error(size_t block_offset, size_t block_length)
+{
+    LogMessage error_message(Logger::Level::ERROR);
+    error_message << "Error parsing JSON!\n";
+    error_message.excerpt(get_data() + block_offset, block_length);
+    m_error = ErrorType::FORMAT;
+}
+
+bool DataObjects::scan_json_block()
+{
+    const char* data = get_data();
+    const char* begin = data + m_last_block_end;
+    const char* end = data + get_size();
+    const char* current = begin + m_scan.position;
 
-    if (current_block_start == current_block_end)
+    // Copy the state into locals for the loop, and save it back when the scan stops. The quote
+    // carry is all ones inside a string, as StructuralIndex::find_in_string() expects.
+    ScanState::BraceType type = m_scan.type;
+    int n_brace = m_scan.n_brace;
+    uint64_t quote_carry = m_scan.in_quotes ? ~0ULL : 0;
+    uint64_t escape_carry = m_scan.escaped ? 1 : 0;
+
+    while (current != end)
     {
-        // block is not valid. Check whether this is due to end of buffer, or else bad formatting.
-        auto white_space_check = m_buffer.cbegin() + m_last_block_end;
-        while(std::isspace(*white_space_check))
+        const size_t size = std::min(static_cast<size_t>(end - current), StructuralIndex::BLOCK_SIZE);
+        const StructuralIndex::Masks masks = StructuralIndex::classify(current, size);
+
+        // This is a valid string:
+        //    "\"\\"
+        // which evaluates to "\ in raw form.
+        // The first \" is escaped, but the second \" isn't.
+        const uint64_t escaped = StructuralIndex::find_escaped(masks.backslash, size, escape_carry);
+        const uint64_t in_string = StructuralIndex::find_in_string(masks.quote & ~escaped, quote_carry);
+        const uint64_t outside = ~in_string;
+
+        // Braces before the start of the block are ignored
+        uint64_t from_start = ~0ULL;
+        if (type == ScanState::NONE)
         {
-            white_space_check++;
+            const uint64_t starts = (masks.open_brace | masks.open_square) & outside;
+            if (starts == 0)
+            {
+                current += size;
+                continue;
+            }
+            const int i_start = __builtin_ctzll(starts);
+            type = ((masks.open_brace >> i_start) & 1) ? ScanState::BRACE : ScanState::SQUARE;
+            m_scan.json_start = (current - begin) + i_start;
+            if ((type == ScanState::SQUARE) && (m_array == ArrayState::NONE))
+            {
+                // The elements of an array at the top level are found one at a time
+                m_scan.position = m_scan.json_start + 1;
+                m_scan.type = type;
+                return true;
+            }
+            from_start = ~0ULL << i_start;
+        }
+
+        const uint64_t opens = ((type == ScanState::BRACE) ? masks.open_brace : masks.open_square) & outside & from_start;
+        const uint64_t closes = ((type == ScanState::BRACE) ? masks.close_brace : masks.close_square) & outside & from_start;
+
+        // The block can only end here if there are enough closing braces to get back to the start
+        if (__builtin_popcountll(closes) < n_brace)
+        {
+            n_brace += __builtin_popcountll(opens) - __builtin_popcountll(closes);
+            current += size;
+            continue;
         }
 
-        if(white_space_check == m_buffer.cend())
+        for (uint64_t braces = opens | closes; braces != 0; braces &= braces - 1)
         {
-            // Got to the end of the buffer.
-            if (m_last_block_end == 0)
+            const int i_brace = __builtin_ctzll(braces);
+            n_brace += ((opens >> i_brace) & 1) ? 1 : -1;
+            if (n_brace == 0)
             {
-                std::cerr << "WARNING: This whole buffer was just white space: \"" << m_buffer << "\"" << std::endl;
-                std::cerr << std::endl;
-                m_error = DataObjects::ErrorType::FORMAT;
+                // The closing brace is outside any string, so there is no quote or escape to carry
+                m_scan.position = (current - begin) + i_brace + 1;
+                m_scan.type = type;
+                m_scan.n_brace = 0;
+                m_scan.in_quotes = false;
+                m_scan.escaped = false;
+                return true;
             }
-            return nullptr;
         }
-
-        // This is not the end of the buffer, therefore there's another issue
-        std::cerr << "ERROR: Ill formatted json block" << std::endl;
-        std::cerr << "    buffer length = " << m_buffer.size() << "; last block end = " << m_last_block_end << ";" << std::endl;
-        std::cerr << std::endl;
-        std::cerr << m_buffer.c_str() + m_last_block_end;
-        std::cerr << std::endl;
-        m_error = ErrorType::FORMAT;
-        return nullptr;
+        current += size;
     }
 
-    // JSON object has been successfully detected. rapidjson will now parse it.
-    m_json_doc = rapidjson::Document();
+    m_scan.position = current - begin;
+    m_scan.type = type;
+    m_scan.n_brace = n_brace;
+    m_scan.in_quotes = (quote_carry != 0);
+    m_scan.escaped = (escape_carry != 0);
 
-    if (m_json_doc.Parse(m_buffer.substr(m_last_block_end + current_block_start, current_block_end).c_str()).HasParseError())
-    {
-        std::cerr << "Error parsing JSON!" << std::endl;
-        std::cerr << m_buffer.substr(m_last_block_end + current_block_start, current_block_end) << std::endl;
-        std::cerr << std::endl;
-        m_error = ErrorType::FORMAT;
-        return nullptr;
-    }
+    return false;
+}
 
-    // Keep track of the next block
-    m_last_block_end += current_block_end;
-    
-    // Is this is an array, return the first element and update the next index
-    if(m_json_doc.IsArray())
+DataObjects::BodyStart DataObjects::classify_start(const char* data, size_t size)
+{
+    const char* first = StructuralIndex::skip_whitespace(data, data + size);
+    if (first == data + size)
     {
-        if (m_json_doc.Size() > 0)
-        {
-            m_next_array_index = 1;
-            return &m_json_doc[0];
-        }
+        return BodyStart::UNKNOWN;
     }
+    return ((*first == '{') || (*first == '[')) ? BodyStart::JSON : BodyStart::NOT_JSON;
+}
+
+const char* DataObjects::get_data() const
+{
+    return m_view ? m_view : m_buffer.data();
+}
+
+size_t DataObjects::get_size() const
+{
+    return m_view ? m_view_size : m_buffer.size();
+}
 
-    // If it's not an array, return the whole document, which will be a single object
-    return &m_json_doc;
+const std::vector<DataObjects::SkippedRange>& DataObjects::get_skipped() const
+{
+    return m_skipped;
 }
 
 DataObjects::ErrorType DataObjects::get_error() const
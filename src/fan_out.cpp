@@ -0,0 +1,124 @@
+#include "fan_out.hpp"
+
+#include <iterator>
+
+FanOut::FanOut(MultiClient& client, TablesInterface& tables) :
+    m_client(client),
+    m_tables(tables),
+    m_error(ErrorType::NONE),
+    m_n_bad_records(0),
+    m_next_endpoint(0),
+    m_recover(false),
+    m_max_skipped_fraction(0)
+{
+
+}
+
+void FanOut::set_recovery(double max_skipped_fraction)
+{
+    m_recover = true;
+    m_max_skipped_fraction = max_skipped_fraction;
+}
+
+void FanOut::run()
+{
+    m_error = ErrorType::NONE;
+    m_n_bad_records = 0;
+    m_json_objects.clear();
+    m_json_objects.resize(m_client.get_num_endpoints());
+    m_held.clear();
+    m_held.resize(m_client.get_num_endpoints());
+    m_done.assign(m_client.get_num_endpoints(), false);
+    m_next_endpoint = 0;
+    if (m_recover)
+    {
+        for (auto& json_objects : m_json_objects)
+        {
+            json_objects.set_recovery(m_max_skipped_fraction);
+        }
+    }
+
+    m_client.query_endpoints(
+        [this](size_t endpoint_index, const char* data, size_t size)
+        {
+            if (m_error == ErrorType::FORMAT)
+            {
+                // The result is already invalid, so abort the remaining transfers
+                return false;
+            }
+            m_json_objects[endpoint_index].feed(data, size);
+            return add_records(endpoint_index);
+        },
+        [this](size_t endpoint_index)
+        {
+            // A failed transfer leaves an incomplete response, which is reported as a query error
+            if ((m_error != ErrorType::FORMAT) &&
+                (m_client.get_error(endpoint_index) == MultiClient::ErrorType::NONE))
+            {
+                m_json_objects[endpoint_index].finish();
+                add_records(endpoint_index);
+            }
+            m_done[endpoint_index] = true;
+            add_held_records(false);
+        });
+
+    // Every transfer has ended, but any records still held, eg. of an endpoint never connected to, are added in order
+    add_held_records(true);
+
+    // A format error aborts the transfers, which also fails the query. Report the root cause.
+    if ((m_error == ErrorType::NONE) && (m_client.get_error() != MultiClient::ErrorType::NONE))
+    {
+        m_error = ErrorType::QUERY;
+    }
+}
+
+bool FanOut::add_records(size_t endpoint_index)
+{
+    DataObjects& json_objects = m_json_objects[endpoint_index];
+    const int n_bad_records = json_objects.get_bad_records();
+    while (json_objects.next_batch(m_batch))
+    {
+        if (endpoint_index == m_next_endpoint)
+        {
+            m_tables.add_records(m_batch.data(), m_batch.size());
+        }
+        else
+        {
+            std::move(m_batch.begin(), m_batch.end(), std::back_inserter(m_held[endpoint_index]));
+        }
+        m_batch.clear();
+    }
+    m_n_bad_records += json_objects.get_bad_records() - n_bad_records;
+
+    if (json_objects.get_error() != DataObjects::ErrorType::NONE)
+    {
+        m_error = ErrorType::FORMAT;
+        return false;
+    }
+    return true;
+}
+
+void FanOut::add_held_records(bool all)
+{
+    while ((m_next_endpoint < m_done.size()) && (all || m_done[m_next_endpoint]))
+    {
+        // The next endpoint's records follow those of the one whose transfer has ended
+        m_next_endpoint++;
+        if (m_next_endpoint < m_held.size())
+        {
+            std::vector<Record>& held = m_held[m_next_endpoint];
+            m_tables.add_records(held.data(), held.size());
+            std::vector<Record>().swap(held);
+        }
+    }
+}
+
+FanOut::ErrorType FanOut::get_error() const
+{
+    return m_error;
+}
+
+int FanOut::get_bad_records() const
+{
+    return m_n_bad_records;
+}
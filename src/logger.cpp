@@ -0,0 +1,413 @@
+#include "logger.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    const size_t DEFAULT_CAPACITY = 4096;
+    const size_t DEFAULT_RATE_LIMIT = 10;
+    const std::chrono::seconds SUMMARY_PERIOD(1);
+
+    size_t round_up_to_power_of_two(size_t n)
+    {
+        size_t power = 2;
+        while (power < n)
+        {
+            power *= 2;
+        }
+        return power;
+    }
+
+    const char* level_name(Logger::Level level)
+    {
+        switch (level)
+        {
+        case Logger::Level::DEBUG:
+            return "DEBUG";
+        case Logger::Level::INFO:
+            return "INFO";
+        case Logger::Level::WARNING:
+            return "WARNING";
+        case Logger::Level::ERROR:
+            return "ERROR";
+        }
+        return "";
+    }
+}
+
+Logger& Logger::get()
+{
+    static Logger logger(DEFAULT_CAPACITY);
+    return logger;
+}
+
+Logger::Logger(size_t capacity) :
+    m_slots(new Slot[round_up_to_power_of_two(capacity)]),
+    m_mask(round_up_to_power_of_two(capacity) - 1),
+    m_head(0),
+    m_tail(0),
+    m_n_dropped(0),
+    m_level(Level::INFO),
+    m_rate_limit(DEFAULT_RATE_LIMIT),
+    m_output(&std::cerr),
+    m_sink_waiting(false),
+    m_flush_target(0),
+    m_n_flushes_requested(0),
+    m_n_flushes_done(0),
+    m_stop(false)
+{
+    for (size_t i_slot = 0; i_slot <= m_mask; i_slot++)
+    {
+        m_slots[i_slot].sequence.store(i_slot, std::memory_order_relaxed);
+    }
+    m_sink = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_sink.join();
+}
+
+void Logger::set_level(Level level)
+{
+    m_level.store(level, std::memory_order_relaxed);
+}
+
+bool Logger::is_enabled(Level level) const
+{
+    return level >= m_level.load(std::memory_order_relaxed);
+}
+
+void Logger::set_rate_limit(size_t n_per_second)
+{
+    m_rate_limit.store(n_per_second, std::memory_order_relaxed);
+}
+
+size_t Logger::get_rate_limit() const
+{
+    return m_rate_limit.load(std::memory_order_relaxed);
+}
+
+void Logger::set_output(std::ostream &output)
+{
+    flush();
+    m_output.store(&output);
+}
+
+void Logger::push(Level level, std::string &&message)
+{
+    while (!try_push(level, message))
+    {
+        if (level != Level::ERROR)
+        {
+            // Diagnostics must never hold up the caller, so they are counted and summarised instead
+            m_n_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    // The sink thread is only woken if it is waiting, so a burst of messages costs no system calls.
+    // Either this sees it waiting, or it sees the message before it waits.
+    if (m_sink_waiting.load())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wake.notify_one();
+    }
+}
+
+void Logger::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const size_t request = ++m_n_flushes_requested;
+    m_flush_target = std::max(m_flush_target, m_head.load());
+    m_wake.notify_one();
+    m_flushed.wait(lock, [this, request]{ return m_n_flushes_done >= request; });
+}
+
+bool Logger::parse_level(const std::string &name, Level &level)
+{
+    const Level levels[] = {Level::DEBUG, Level::INFO, Level::WARNING, Level::ERROR};
+    for (const Level candidate : levels)
+    {
+        std::string candidate_name(level_name(candidate));
+        std::transform(candidate_name.begin(), candidate_name.end(), candidate_name.begin(), ::tolower);
+        if (name == candidate_name)
+        {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Logger::try_push(Level level, std::string &message)
+{
+    size_t position = m_head.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true)
+    {
+        slot = &m_slots[position & m_mask];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence == position)
+        {
+            // The slot is free, so claim it
+            if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (sequence < position)
+        {
+            // The slot still holds the message pushed one lap ago, so the queue is full
+            return false;
+        }
+        else
+        {
+            // Another thread has claimed the slot
+            position = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->message = std::move(message);
+    slot->sequence.store(position + 1);
+    return true;
+}
+
+bool Logger::try_pop(Level &level, std::string &message)
+{
+    Slot &slot = m_slots[m_tail & m_mask];
+    if (slot.sequence.load(std::memory_order_acquire) != m_tail + 1)
+    {
+        return false;
+    }
+
+    level = slot.level;
+    message = std::move(slot.message);
+    slot.message.clear();
+    slot.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+    m_tail++;
+    return true;
+}
+
+bool Logger::has_message() const
+{
+    return m_slots[m_tail & m_mask].sequence.load() == m_tail + 1;
+}
+
+void Logger::run()
+{
+    std::string text;
+    Level level;
+    std::string message;
+    std::chrono::steady_clock::time_point last_summary = std::chrono::steady_clock::now();
+    while (true)
+    {
+        // Everything in the queue is written at once, rather than a write (and, for stderr, a flush) per line
+        while (try_pop(level, message))
+        {
+            format(level, message, text);
+        }
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now - last_summary >= SUMMARY_PERIOD)
+        {
+            summarise(text);
+            last_summary = now;
+        }
+        write(text);
+        text.clear();
+
+        // A flush waits for the messages pushed before it, and stopping for all of them. A message
+        // may be counted by m_head while it is still being put in its slot.
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const bool flush_requested = (m_n_flushes_done < m_n_flushes_requested);
+        const size_t target = m_stop ? m_head.load() : m_flush_target;
+        if ((flush_requested || m_stop) && (m_tail >= target))
+        {
+            const size_t n_flushes = m_n_flushes_requested;
+            const bool stop = m_stop;
+            lock.unlock();
+            summarise(text);
+            write(text);
+            text.clear();
+            m_output.load()->flush();
+            last_summary = std::chrono::steady_clock::now();
+            lock.lock();
+            m_n_flushes_done = n_flushes;
+            m_flushed.notify_all();
+            if (stop)
+            {
+                return;
+            }
+            continue;
+        }
+        if (flush_requested || m_stop)
+        {
+            lock.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+
+        m_sink_waiting.store(true);
+        m_wake.wait_for(lock, SUMMARY_PERIOD, [this]{
+            return m_stop || (m_n_flushes_done < m_n_flushes_requested) || has_message();
+        });
+        m_sink_waiting.store(false);
+    }
+}
+
+void Logger::format(Level level, const std::string &message, std::string &text)
+{
+    text += level_name(level);
+    text += ": ";
+    text += message;
+    text += "\n\n";
+}
+
+void Logger::summarise(std::string &text)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_types_mutex);
+        for (LogType* type : m_types)
+        {
+            const size_t n_suppressed = type->take_suppressed();
+            if (n_suppressed > 0)
+            {
+                format(type->get_level(), std::to_string(n_suppressed) + " more " + type->get_summary() + " were not logged", text);
+            }
+        }
+    }
+    const size_t n_dropped = m_n_dropped.exchange(0);
+    if (n_dropped > 0)
+    {
+        format(Level::WARNING, std::to_string(n_dropped) + " log messages were dropped because the log queue was full", text);
+    }
+}
+
+void Logger::write(const std::string &text)
+{
+    if (!text.empty())
+    {
+        m_output.load()->write(text.data(), text.size());
+    }
+}
+
+void Logger::add_type(LogType *type)
+{
+    std::lock_guard<std::mutex> lock(m_types_mutex);
+    m_types.push_back(type);
+}
+
+void Logger::remove_type(LogType *type)
+{
+    std::lock_guard<std::mutex> lock(m_types_mutex);
+    m_types.erase(std::remove(m_types.begin(), m_types.end(), type), m_types.end());
+}
+
+LogType::LogType(Logger::Level level, const std::string &summary) :
+    m_level(level),
+    m_summary(summary),
+    m_second(0),
+    m_n_in_second(0),
+    m_n_suppressed(0)
+{
+    Logger::get().add_type(this);
+}
+
+LogType::~LogType()
+{
+    Logger &logger = Logger::get();
+    logger.remove_type(this);
+    const size_t n_suppressed = take_suppressed();
+    if (n_suppressed > 0)
+    {
+        logger.push(m_level, std::to_string(n_suppressed) + " more " + m_summary + " were not logged");
+    }
+}
+
+Logger::Level LogType::get_level() const
+{
+    return m_level;
+}
+
+const std::string& LogType::get_summary() const
+{
+    return m_summary;
+}
+
+bool LogType::admit()
+{
+    // The count restarts each second. Two threads may both restart it, which only lets through a
+    // few more messages that second.
+    const long long second = std::chrono::duration_cast<std::chrono::seconds>(
+                                 std::chrono::steady_clock::now().time_since_epoch()).count();
+    long long counted_second = m_second.load(std::memory_order_relaxed);
+    if ((counted_second != second) && m_second.compare_exchange_strong(counted_second, second, std::memory_order_relaxed))
+    {
+        m_n_in_second.store(0, std::memory_order_relaxed);
+    }
+    if (m_n_in_second.fetch_add(1, std::memory_order_relaxed) < Logger::get().get_rate_limit())
+    {
+        return true;
+    }
+    m_n_suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+size_t LogType::take_suppressed()
+{
+    return m_n_suppressed.exchange(0, std::memory_order_relaxed);
+}
+
+LogMessage::LogMessage(Logger::Level level) : m_level(level)
+{
+    if (Logger::get().is_enabled(level))
+    {
+        m_stream.reset(new std::ostringstream);
+    }
+}
+
+LogMessage::LogMessage(LogType &type) : m_level(type.get_level())
+{
+    if (Logger::get().is_enabled(m_level) && type.admit())
+    {
+        m_stream.reset(new std::ostringstream);
+    }
+}
+
+LogMessage::~LogMessage()
+{
+    if (m_stream)
+    {
+        Logger::get().push(m_level, m_stream->str());
+    }
+}
+
+LogMessage& LogMessage::excerpt(const char *data, size_t size)
+{
+    if (m_stream)
+    {
+        if ((size <= EXCERPT_SIZE) || Logger::get().is_enabled(Logger::Level::DEBUG))
+        {
+            m_stream->write(data, size);
+        }
+        else
+        {
+            m_stream->write(data, EXCERPT_SIZE);
+            *m_stream << "... (" << size - EXCERPT_SIZE << " more bytes)";
+        }
+    }
+    return *this;
+}
+
+bool LogMessage::is_logged() const
+{
+    return static_cast<bool>(m_stream);
+}
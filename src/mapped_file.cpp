@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.hpp"
+#include "logger.hpp"
+
+MappedFile::MappedFile(const char* path) : m_data(nullptr), m_size(0), m_error(ErrorType::NONE)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat file_stat;
+    if ((fd < 0) || (fstat(fd, &file_stat) != 0))
+    {
+        LogMessage(Logger::Level::ERROR) << "could not open " << path << ": " << std::strerror(errno);
+        m_error = ErrorType::OPEN;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+
+    // An empty file can't be mapped, so nothing is, and there is no data
+    m_size = static_cast<size_t>(file_stat.st_size);
+    if (m_size > 0)
+    {
+        void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            LogMessage(Logger::Level::ERROR) << "could not map " << path << ": " << std::strerror(errno);
+            m_error = ErrorType::MAP;
+            m_size = 0;
+        }
+        else
+        {
+            // The parser reads the file once from start to end
+            madvise(mapping, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(mapping);
+        }
+    }
+
+    // The mapping stays valid once the file is closed
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+const char* MappedFile::get_data() const
+{
+    return m_data;
+}
+
+size_t MappedFile::get_size() const
+{
+    return m_size;
+}
+
+MappedFile::ErrorType MappedFile::get_error() const
+{
+    return m_error;
+}
+
+std::vector<std::string> MappedFile::list_captures(const std::string& path)
+{
+    std::vector<std::string> captures;
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(path, error))
+        {
+            if (!entry.is_regular_file(error))
+            {
+                continue;
+            }
+            if (entry.file_size(error) == 0)
+            {
+                LogMessage(Logger::Level::WARNING) << "Skipping the empty capture " << entry.path().string();
+                continue;
+            }
+            captures.push_back(entry.path().string());
+        }
+        std::sort(captures.begin(), captures.end());
+    }
+    else
+    {
+        captures.push_back(path);
+    }
+    return captures;
+}
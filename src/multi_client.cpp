@@ -0,0 +1,192 @@
+#include <curl/curl.h>
+
+#include "multi_client.hpp"
+#include "body_check.hpp"
+#include "data_objects.hpp"
+#include "logger.hpp"
+
+namespace
+{
+
+/**
+ * \brief Associates a transfer with its endpoint and the handler for its data
+*/
+struct Transfer
+{
+    size_t endpoint_index;
+    const MultiClient::ChunkHandler* on_chunk;
+    BodyCheck<MultiClient::ErrorType> check;    /// Error set if the start of the response was rejected and the transfer aborted
+};
+
+/**
+ * \brief Callback function to pass the response data to the handler as it arrives
+ */ 
+size_t WriteCallback(void* contents, size_t size, size_t nmemb, Transfer* transfer)
+{
+    size_t totalSize = size * nmemb;
+    if (!transfer->check.check_chunk(static_cast<const char*>(contents), totalSize))
+    {
+        return 0;
+    }
+    if (!(*transfer->on_chunk)(transfer->endpoint_index, static_cast<const char*>(contents), totalSize))
+    {
+        // Returning a short count aborts the transfer
+        return 0;
+    }
+    return totalSize;
+}
+} // namespace
+
+MultiClient::MultiClient(const std::vector<std::string>& endpoints, long max_connections, bool compressed) :
+    m_endpoints(endpoints),
+    m_errors(endpoints.size(), ErrorType::NONE),
+    m_error(ErrorType::NONE)
+{
+    // Initialize curl
+    m_multi = curl_multi_init();
+    if (!m_multi)
+    {
+        LogMessage(Logger::Level::ERROR) << "could not intialise curl multi";
+        m_error = ErrorType::INIT;
+        return;
+    }
+    curl_multi_setopt(m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, max_connections);
+
+    for (size_t i_endpoint = 0; i_endpoint < m_endpoints.size(); i_endpoint++)
+    {
+        CURL* curl = curl_easy_init();
+        if (!curl)
+        {
+            LogMessage(Logger::Level::ERROR) << "could not intialise curl for " << m_endpoints[i_endpoint];
+            m_errors[i_endpoint] = ErrorType::INIT;
+            m_error = ErrorType::INIT;
+        }
+        else
+        {
+            curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, compressed ? "" : nullptr);
+        }
+        m_curl.push_back(curl);
+    }
+}
+
+MultiClient::~MultiClient()
+{
+    // Clean up
+    for (auto curl : m_curl)
+    {
+        curl_easy_cleanup(curl);
+    }
+    curl_multi_cleanup(m_multi);
+}
+
+void MultiClient::query_endpoints(const ChunkHandler& on_chunk, const DoneHandler& on_done)
+{
+    if (m_error == ErrorType::INIT)
+    {
+        LogMessage(Logger::Level::ERROR) << "curl was not intialised";
+        return;
+    }
+    m_error = ErrorType::NONE;
+
+    std::vector<Transfer> transfers(m_endpoints.size());
+    for (size_t i_endpoint = 0; i_endpoint < m_endpoints.size(); i_endpoint++)
+    {
+        CURL* curl = m_curl[i_endpoint];
+        transfers[i_endpoint] = {i_endpoint, &on_chunk, {curl, false, ErrorType::NONE}};
+        m_errors[i_endpoint] = ErrorType::NONE;
+
+        curl_easy_setopt(curl, CURLOPT_URL, m_endpoints[i_endpoint].c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfers[i_endpoint]);
+        curl_easy_setopt(curl, CURLOPT_PRIVATE, &transfers[i_endpoint]);
+        curl_multi_add_handle(m_multi, curl);
+    }
+
+    // Drive all of the transfers until they have all ended
+    int n_running = 0;
+    do
+    {
+        CURLMcode mres = curl_multi_perform(m_multi, &n_running);
+        if ((mres == CURLM_OK) && (n_running > 0))
+        {
+            // Wait for activity on any of the connections
+            mres = curl_multi_poll(m_multi, nullptr, 0, 1000, nullptr);
+        }
+
+        if (mres != CURLM_OK)
+        {
+            LogMessage(Logger::Level::ERROR) << "curl_multi_perform() failed: " << curl_multi_strerror(mres);
+            m_error = ErrorType::QUERY;
+            break;
+        }
+
+        // Report the transfers which have ended
+        int n_messages = 0;
+        CURLMsg* message = curl_multi_info_read(m_multi, &n_messages);
+        while (message != nullptr)
+        {
+            if (message->msg == CURLMSG_DONE)
+            {
+                Transfer* transfer = nullptr;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+
+                long response_code = 0;
+                curl_easy_getinfo(message->easy_handle, CURLINFO_RESPONSE_CODE, &response_code);
+                if ((transfer->check.error == ErrorType::NONE) && (message->data.result == CURLE_OK) &&
+                    ((response_code < 200) || (response_code >= 300)))
+                {
+                    // An error response without a body never reaches the write callback
+                    transfer->check.error = ErrorType::HTTP_STATUS;
+                }
+
+                if (transfer->check.error != ErrorType::NONE)
+                {
+                    LogMessage error_message(Logger::Level::ERROR);
+                    error_message << "Query of " << m_endpoints[transfer->endpoint_index] << " failed: ";
+                    if (transfer->check.error == ErrorType::HTTP_STATUS)
+                    {
+                        error_message << "HTTP status " << response_code;
+                    }
+                    else
+                    {
+                        error_message << "response is not json";
+                    }
+                    m_errors[transfer->endpoint_index] = transfer->check.error;
+                    m_error = transfer->check.error;
+                }
+                else if (message->data.result != CURLE_OK)
+                {
+                    LogMessage(Logger::Level::ERROR) << "Query of " << m_endpoints[transfer->endpoint_index] << " failed: "
+                                                     << curl_easy_strerror(message->data.result);
+                    m_errors[transfer->endpoint_index] = ErrorType::QUERY;
+                    m_error = ErrorType::QUERY;
+                }
+                curl_multi_remove_handle(m_multi, message->easy_handle);
+                on_done(transfer->endpoint_index);
+            }
+            message = curl_multi_info_read(m_multi, &n_messages);
+        }
+    } while (n_running > 0);
+
+    // Only left with handles still attached if the multi interface itself failed
+    for (auto curl : m_curl)
+    {
+        curl_multi_remove_handle(m_multi, curl);
+    }
+}
+
+size_t MultiClient::get_num_endpoints() const
+{
+    return m_endpoints.size();
+}
+
+MultiClient::ErrorType MultiClient::get_error() const
+{
+    return m_error;
+}
+
+MultiClient::ErrorType MultiClient::get_error(size_t endpoint_index) const
+{
+    return m_errors[endpoint_index];
+}
@@ -0,0 +1,420 @@
+#include <algorithm>
+#include <rapidjson/memorystream.h>
+#include <rapidjson/reader.h>
+
+#include "parallel_parser.hpp"
+#include "data_objects.hpp"
+#include "for_each_region.hpp"
+#include "logger.hpp"
+#include "record_handler.hpp"
+#include "structural_index.hpp"
+
+namespace
+{
+/**
+ * \brief Returns 1 if the character at offset is escaped, ie. follows an odd length run of backslashes
+*/
+uint64_t escape_carry(const char* data, size_t offset)
+{
+    size_t n_backslash = 0;
+    while ((n_backslash < offset) && (data[offset - n_backslash - 1] == '\\'))
+    {
+        n_backslash++;
+    }
+    return n_backslash & 1;
+}
+
+/**
+ * \brief Returns the first brace outside strings opening a block, or end if there is none
+ *
+ * As when DataObjects scans for a block, anything before the brace is skipped. begin must be
+ * outside a string, and not escaped.
+*/
+const char* find_block(const char* begin, const char* end)
+{
+    uint64_t escape = 0;
+    uint64_t quote = 0;
+    for (const char* current = begin; current < end; current += StructuralIndex::BLOCK_SIZE)
+    {
+        const size_t size = std::min(static_cast<size_t>(end - current), StructuralIndex::BLOCK_SIZE);
+        const StructuralIndex::Masks masks = StructuralIndex::classify(current, size);
+        const uint64_t escaped = StructuralIndex::find_escaped(masks.backslash, size, escape);
+        const uint64_t in_string = StructuralIndex::find_in_string(masks.quote & ~escaped, quote);
+        const uint64_t opens = (masks.open_brace | masks.open_square) & ~in_string;
+        if (opens != 0)
+        {
+            return current + __builtin_ctzll(opens);
+        }
+    }
+    return end;
+}
+
+/**
+ * \brief Returns the first character which isn't whitespace to rapidjson, or end if there is none
+*/
+const char* skip_json_whitespace(const char* begin, const char* end)
+{
+    while ((begin != end) && ((*begin == ' ') || (*begin == '\n') || (*begin == '\r') || (*begin == '\t')))
+    {
+        begin++;
+    }
+    return begin;
+}
+} // namespace
+
+ParallelParser::ParallelParser(TablesInterface& tables, unsigned int n_threads, size_t min_region_size) :
+    m_tables(tables),
+    m_n_threads(std::max(n_threads, 1u)),
+    m_min_region_size(std::max(min_region_size, static_cast<size_t>(1))),
+    m_error(ErrorType::NONE),
+    m_n_bad_records(0),
+    m_recover(false),
+    m_max_skipped_fraction(0)
+{
+
+}
+
+void ParallelParser::set_recovery(double max_skipped_fraction)
+{
+    m_recover = true;
+    m_max_skipped_fraction = max_skipped_fraction;
+}
+
+void ParallelParser::parse(const char* data, size_t size)
+{
+    m_error = ErrorType::NONE;
+    m_n_bad_records = 0;
+
+    if (!split(data, size))
+    {
+        m_regions.clear();
+        parse_serial(data, size);
+        return;
+    }
+
+    for_each_region(m_regions, [data](Region& region) { parse_region(data, region); });
+
+    // Where to carry on after an error depends on what comes before it, so recovery is left to a DataObjects
+    const bool failed = std::any_of(m_regions.begin(), m_regions.end(), [](const Region& region) { return region.failed; });
+    if (m_recover && failed)
+    {
+        m_regions.clear();
+        parse_serial(data, size);
+        return;
+    }
+
+    merge(data);
+    m_regions.clear();
+}
+
+bool ParallelParser::split(const char* data, size_t size)
+{
+    const size_t n_regions = std::min(static_cast<size_t>(m_n_threads), size / m_min_region_size);
+    if (n_regions < 2)
+    {
+        return false;
+    }
+
+    m_regions.assign(n_regions, Region());
+    for (size_t i_region = 0; i_region < n_regions; i_region++)
+    {
+        m_regions[i_region].begin = size * i_region / n_regions;
+        m_regions[i_region].end = size * (i_region + 1) / n_regions;
+    }
+
+    // Whether each region starts inside a string, and at what depth, follows from the regions before it
+    for_each_region(m_regions, [data](Region& region) { count_braces(data, region); });
+    bool in_string = false;
+    int depth = 0;
+    for (auto& region : m_regions)
+    {
+        region.in_string = in_string;
+        region.depth = depth;
+        depth += in_string ? region.depth_change_inside : region.depth_change_outside;
+        in_string ^= region.odd_quotes;
+    }
+    if (depth != 0)
+    {
+        // Left to DataObjects to report
+        return false;
+    }
+
+    for_each_region(m_regions, [data](Region& region) { find_record_starts(data, region); });
+    bool found_top = false;
+    for (const auto& region : m_regions)
+    {
+        if (region.unbalanced)
+        {
+            return false;
+        }
+        found_top |= (region.first_top != NONE);
+    }
+    if (!found_top)
+    {
+        // An empty or whitespace response is reported by DataObjects
+        return false;
+    }
+
+    // Each region starts at the first record after its start, which may be in a later region
+    Top top = Top::NONE;
+    std::vector<Top> top_at_begin(n_regions);
+    for (size_t i_region = 0; i_region < n_regions; i_region++)
+    {
+        top_at_begin[i_region] = top;
+        if (m_regions[i_region].last_top != Top::NONE)
+        {
+            top = m_regions[i_region].last_top;
+        }
+    }
+
+    size_t next_begin = size;
+    bool next_in_array = false;
+    for (size_t i_region = n_regions - 1; i_region > 0; i_region--)
+    {
+        Region& region = m_regions[i_region];
+        region.records_end = next_begin;
+        region.last = (next_begin == size);
+        if ((region.depth > 0) && (top_at_begin[i_region] == Top::ARRAY) && (region.first_element < region.first_top))
+        {
+            region.records_begin = region.first_element;
+            region.in_array = true;
+        }
+        else if (region.first_top != NONE)
+        {
+            region.records_begin = region.first_top;
+            region.in_array = false;
+        }
+        else
+        {
+            region.records_begin = next_begin;
+            region.in_array = next_in_array;
+        }
+        next_begin = region.records_begin;
+        next_in_array = region.in_array;
+    }
+    m_regions[0].records_begin = 0;
+    m_regions[0].records_end = next_begin;
+    m_regions[0].last = (next_begin == size);
+    m_regions[0].in_array = false;
+    return true;
+}
+
+void ParallelParser::count_braces(const char* data, Region& region)
+{
+    uint64_t escape = escape_carry(data, region.begin);
+    uint64_t quote = 0;
+    int depth_change_outside = 0;
+    int depth_change_inside = 0;
+    for (size_t offset = region.begin; offset < region.end; offset += StructuralIndex::BLOCK_SIZE)
+    {
+        const size_t size = std::min(region.end - offset, StructuralIndex::BLOCK_SIZE);
+        const StructuralIndex::Masks masks = StructuralIndex::classify(data + offset, size);
+        const uint64_t escaped = StructuralIndex::find_escaped(masks.backslash, size, escape);
+
+        // Starting inside a string just inverts which characters are inside strings
+        const uint64_t in_string = StructuralIndex::find_in_string(masks.quote & ~escaped, quote);
+        const uint64_t opens = masks.open_brace | masks.open_square;
+        const uint64_t closes = masks.close_brace | masks.close_square;
+        depth_change_outside += __builtin_popcountll(opens & ~in_string) - __builtin_popcountll(closes & ~in_string);
+        depth_change_inside += __builtin_popcountll(opens & in_string) - __builtin_popcountll(closes & in_string);
+    }
+    region.odd_quotes = (quote != 0);
+    region.depth_change_outside = depth_change_outside;
+    region.depth_change_inside = depth_change_inside;
+}
+
+void ParallelParser::find_record_starts(const char* data, Region& region)
+{
+    uint64_t escape = escape_carry(data, region.begin);
+    uint64_t quote = region.in_string ? ~0ULL : 0;
+    int depth = region.depth;
+    for (size_t offset = region.begin; offset < region.end; offset += StructuralIndex::BLOCK_SIZE)
+    {
+        const size_t size = std::min(region.end - offset, StructuralIndex::BLOCK_SIZE);
+        const StructuralIndex::Masks masks = StructuralIndex::classify(data + offset, size);
+        const uint64_t escaped = StructuralIndex::find_escaped(masks.backslash, size, escape);
+        const uint64_t outside = ~StructuralIndex::find_in_string(masks.quote & ~escaped, quote);
+        const uint64_t opens = (masks.open_brace | masks.open_square) & outside;
+        const uint64_t closes = (masks.close_brace | masks.close_square) & outside;
+
+        // Only the braces of the top two levels can start a record
+        if (depth - __builtin_popcountll(closes) >= 2)
+        {
+            depth += __builtin_popcountll(opens) - __builtin_popcountll(closes);
+            continue;
+        }
+
+        for (uint64_t braces = opens | closes; braces != 0; braces &= braces - 1)
+        {
+            const int i_brace = __builtin_ctzll(braces);
+            if (((closes >> i_brace) & 1) != 0)
+            {
+                if (--depth < 0)
+                {
+                    region.unbalanced = true;
+                    return;
+                }
+                continue;
+            }
+
+            if (depth == 0)
+            {
+                if (region.first_top == NONE)
+                {
+                    region.first_top = offset + i_brace;
+                }
+                region.last_top = ((masks.open_brace >> i_brace) & 1) ? Top::OBJECT : Top::ARRAY;
+            }
+            else if ((depth == 1) && (region.first_top == NONE) && (region.first_element == NONE))
+            {
+                region.first_element = offset + i_brace;
+            }
+            depth++;
+        }
+    }
+}
+
+void ParallelParser::parse_region(const char* data, Region& region)
+{
+    // What may follow in an array at the top level
+    enum class Expect {
+        FIRST,      /// A value or the end of the array
+        VALUE,      /// A value
+        SEPARATOR,  /// A comma or the end of the array
+    };
+
+    RecordHandler handler(region.records);
+    rapidjson::GenericReader<rapidjson::UTF8<>, rapidjson::UTF8<>> reader;
+    const char* current = data + region.records_begin;
+    const char* end = data + region.records_end;
+    bool in_array = region.in_array;
+    Expect expect = Expect::VALUE;
+    if (in_array)
+    {
+        // The handler expects the records of an array to be inside one
+        handler.StartArray();
+    }
+
+    auto fail = [&](const char* begin, const char* stop)
+    {
+        region.failed = true;
+        region.error_begin = begin - data;
+        region.error_end = std::min(stop + 1, end) - data;
+    };
+
+    while (!region.failed)
+    {
+        if (!in_array)
+        {
+            const char* block = find_block(current, end);
+            if (block == end)
+            {
+                // The last region must end in whitespace, as for DataObjects
+                const char* rest = StructuralIndex::skip_whitespace(current, end);
+                if (region.last && (rest != end) && (*rest != '\0'))
+                {
+                    fail(rest, end - 1);
+                }
+                break;
+            }
+            current = block;
+            if (*current == '[')
+            {
+                handler.StartArray();
+                in_array = true;
+                expect = Expect::FIRST;
+                current++;
+                continue;
+            }
+        }
+        else
+        {
+            current = skip_json_whitespace(current, end);
+            if (current == end)
+            {
+                // The array goes on into the next region, which starts at a value
+                if (expect == Expect::SEPARATOR)
+                {
+                    fail(current - 1, current - 1);
+                }
+                break;
+            }
+            if ((*current == ']') && (expect != Expect::VALUE))
+            {
+                handler.EndArray(0);
+                in_array = false;
+                current++;
+                continue;
+            }
+            if ((*current == ',') && (expect == Expect::SEPARATOR))
+            {
+                expect = Expect::VALUE;
+                current++;
+                continue;
+            }
+            if ((*current == ']') || (*current == ',') || (expect == Expect::SEPARATOR))
+            {
+                fail(current, current);
+                break;
+            }
+        }
+
+        rapidjson::MemoryStream stream(current, end - current);
+        if (reader.Parse<rapidjson::kParseStopWhenDoneFlag>(stream, handler).IsError())
+        {
+            fail(current, current + reader.GetErrorOffset());
+            break;
+        }
+        current += stream.Tell();
+        expect = Expect::SEPARATOR;
+    }
+    region.n_bad_records = handler.get_bad_records();
+}
+
+void ParallelParser::merge(const char* data)
+{
+    for (auto& region : m_regions)
+    {
+        m_tables.add_records(region.records.data(), region.records.size());
+        m_n_bad_records += region.n_bad_records;
+
+        if (region.failed)
+        {
+            LogMessage error_message(Logger::Level::ERROR);
+            error_message << "Error parsing JSON!\n";
+            error_message.excerpt(data + region.error_begin, region.error_end - region.error_begin);
+            m_error = ErrorType::FORMAT;
+            return;
+        }
+    }
+}
+
+void ParallelParser::parse_serial(const char* data, size_t size)
+{
+    DataObjects json_objects(data, size);
+    if (m_recover)
+    {
+        json_objects.set_recovery(m_max_skipped_fraction);
+    }
+    std::vector<Record> batch;
+    while (json_objects.next_batch(batch))
+    {
+        m_tables.add_records(batch.data(), batch.size());
+        batch.clear();
+    }
+    m_n_bad_records = json_objects.get_bad_records();
+    if (json_objects.get_error() != DataObjects::ErrorType::NONE)
+    {
+        m_error = ErrorType::FORMAT;
+    }
+}
+
+ParallelParser::ErrorType ParallelParser::get_error() const
+{
+    return m_error;
+}
+
+int ParallelParser::get_bad_records() const
+{
+    return m_n_bad_records;
+}
@@ -0,0 +1,74 @@
+#include "partial_results.hpp"
+
+namespace
+{
+/**
+ * \brief Adds each count of other to those of counts
+*/
+void merge_counts(std::map<std::string, unsigned int>& counts, const std::map<std::string, unsigned int>& other)
+{
+    for (const auto& count : other)
+    {
+        counts[count.first] += count.second;
+    }
+}
+
+/**
+ * \brief Returns the string with the highest count. Of strings as common as each other, the first in alphabetical order is taken.
+*/
+std::string most_common(const std::map<std::string, unsigned int>& counts)
+{
+    std::pair<unsigned int, std::string> common {0, ""};
+    for (const auto& count : counts)
+    {
+        if (count.second > common.first)
+        {
+            common = {count.second, count.first};
+        }
+    }
+    return common.second;
+}
+}
+
+void PartialResults::merge(const PartialResults &other)
+{
+    for (const auto& other_city : other.cities)
+    {
+        City& city = cities[other_city.first];
+        city.n_citizens += other_city.second.n_citizens;
+        city.age += other_city.second.age;
+        city.n_friends += other_city.second.n_friends;
+        if ((other_city.second.max_friends > city.max_friends) ||
+            ((other_city.second.max_friends == city.max_friends) && (city.max_friends > 0) &&
+             (other_city.second.max_order < city.max_order)))
+        {
+            city.max_friends = other_city.second.max_friends;
+            city.max_name = other_city.second.max_name;
+            city.max_order = other_city.second.max_order;
+        }
+    }
+    merge_counts(names, other.names);
+    merge_counts(hobbies, other.hobbies);
+}
+
+Results PartialResults::get_results() const
+{
+    Results results;
+    for (const auto& city : cities)
+    {
+        if (city.second.n_citizens == 0)
+        {
+            continue;
+        }
+
+        CityResults city_results;
+        city_results.city_name = city.first;
+        city_results.average_age = city.second.age / city.second.n_citizens;
+        city_results.average_number_of_friends = city.second.n_friends / city.second.n_citizens;
+        city_results.user_with_most_friends = city.second.max_name;
+        results.cities.emplace_back(city_results);
+    }
+    results.most_common_first_name = most_common(names);
+    results.most_common_hobby = most_common(hobbies);
+    return results;
+}
@@ -0,0 +1,103 @@
+#include <thread>
+#include <vector>
+
+#include "pipeline.hpp"
+#include "chunk_queue.hpp"
+#include "data_objects.hpp"
+
+Pipeline::Pipeline(Client& client, TablesInterface& tables, size_t queue_capacity) :
+    m_client(client),
+    m_tables(tables),
+    m_queue_capacity(queue_capacity),
+    m_error(ErrorType::NONE),
+    m_n_bad_records(0),
+    m_closed_queue(false),
+    m_recover(false),
+    m_max_skipped_fraction(0)
+{
+
+}
+
+void Pipeline::set_recovery(double max_skipped_fraction)
+{
+    m_recover = true;
+    m_max_skipped_fraction = max_skipped_fraction;
+}
+
+void Pipeline::run()
+{
+    m_error = ErrorType::NONE;
+    m_n_bad_records = 0;
+    m_closed_queue = false;
+
+    ChunkQueue queue(m_queue_capacity);
+
+    // Parse on a second thread while this thread downloads
+    std::thread ingest_thread(&Pipeline::ingest, this, std::ref(queue));
+    m_client.query_endpoint(queue);
+    ingest_thread.join();
+
+    // A format error closes the queue early, which also fails the query. Report the root cause.
+    if (!m_closed_queue && (m_client.get_error() != Client::ErrorType::NONE))
+    {
+        m_error = ErrorType::QUERY;
+    }
+}
+
+void Pipeline::ingest(ChunkQueue& queue)
+{
+    DataObjects json_objects;
+    if (m_recover)
+    {
+        json_objects.set_recovery(m_max_skipped_fraction);
+    }
+    std::vector<Record> batch;
+    std::string chunk;
+    bool more_data = true;
+
+    while (more_data)
+    {
+        more_data = queue.pop(chunk);
+        if (more_data)
+        {
+            json_objects.feed(chunk.data(), chunk.size());
+        }
+        else if (m_client.get_error() != Client::ErrorType::NONE)
+        {
+            // The client sets its error before closing the queue. A failed transfer leaves the response
+            // incomplete, so it isn't finished, and run() reports the query error.
+            return;
+        }
+        else
+        {
+            json_objects.finish();
+        }
+
+        // Add every record that is complete so far
+        while (json_objects.next_batch(batch))
+        {
+            m_tables.add_records(batch.data(), batch.size());
+            batch.clear();
+        }
+        m_n_bad_records = json_objects.get_bad_records();
+
+        if (json_objects.get_error() != DataObjects::ErrorType::NONE)
+        {
+            // No point downloading the rest. Closing the queue aborts the transfer.
+            m_error = ErrorType::FORMAT;
+            m_closed_queue = true;
+            queue.close();
+            return;
+        }
+    }
+}
+
+Pipeline::ErrorType Pipeline::get_error() const
+{
+    return m_error;
+}
+
+int Pipeline::get_bad_records() const
+{
+    return m_n_bad_records;
+}
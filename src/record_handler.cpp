@@ -0,0 +1,349 @@
+#include <climits>
+#include <cstring>
+
+#include "logger.hpp"
+#include "record_handler.hpp"
+
+namespace
+{
+/**
+ * \brief Returns true if the key is the field name
+*/
+bool is_key(const char* str, rapidjson::SizeType length, const char* field)
+{
+    return (std::strlen(field) == length) && (std::memcmp(str, field, length) == 0);
+}
+
+/**
+ * \brief Logs a record which isn't an object
+*/
+void log_not_object()
+{
+    static LogType not_object(Logger::Level::WARNING, "records which aren't objects");
+    LogMessage(not_object) << "Unexpected record type; Expecting Object";
+}
+} // namespace
+
+RecordHandler::RecordHandler(Tables &tables) :
+    m_tables(&tables),
+    m_records(nullptr),
+    m_record(),
+    m_fields(),
+    m_field(N_FIELDS),
+    m_friend(),
+    m_friend_name(FieldState::MISSING),
+    m_friend_hobbies(false),
+    m_friend_field(FriendField::NONE),
+    m_n_bad_records(0)
+{
+
+}
+
+RecordHandler::RecordHandler(std::vector<Record> &records) :
+    m_tables(nullptr),
+    m_records(&records),
+    m_record(),
+    m_fields(),
+    m_field(N_FIELDS),
+    m_friend(),
+    m_friend_name(FieldState::MISSING),
+    m_friend_hobbies(false),
+    m_friend_field(FriendField::NONE),
+    m_n_bad_records(0)
+{
+
+}
+
+bool RecordHandler::Null()
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::Bool(bool)
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::Int(int i)
+{
+    on_value(false, nullptr, 0, true, i);
+    return true;
+}
+
+bool RecordHandler::Uint(unsigned int u)
+{
+    // rapidjson reports every non-negative integer as unsigned, but IsInt() is true if it fits in an int
+    on_value(false, nullptr, 0, u <= static_cast<unsigned int>(INT_MAX), static_cast<int>(u));
+    return true;
+}
+
+bool RecordHandler::Int64(int64_t)
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::Uint64(uint64_t)
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::Double(double)
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::RawNumber(const char*, rapidjson::SizeType, bool)
+{
+    on_value(false, nullptr, 0, false, 0);
+    return true;
+}
+
+bool RecordHandler::String(const char* str, rapidjson::SizeType length, bool)
+{
+    on_value(true, str, length, false, 0);
+    return true;
+}
+
+bool RecordHandler::StartObject()
+{
+    on_start(false);
+    return true;
+}
+
+bool RecordHandler::Key(const char* str, rapidjson::SizeType length, bool)
+{
+    if (m_contexts.back() == Context::RECORD)
+    {
+        m_field = is_key(str, length, CITY_FIELD) ? CITY :
+                  is_key(str, length, CITIZEN_ID_FIELD) ? CITIZEN_ID :
+                  is_key(str, length, CITIZEN_NAME_FIELD) ? CITIZEN_NAME :
+                  is_key(str, length, CITIZEN_AGE_FIELD) ? CITIZEN_AGE :
+                  is_key(str, length, FRIEND_FIELD) ? FRIENDS : N_FIELDS;
+
+        // Only the first of repeated keys counts
+        if ((m_field != N_FIELDS) && (m_fields[m_field] != FieldState::MISSING))
+        {
+            m_field = N_FIELDS;
+        }
+    }
+    else if (m_contexts.back() == Context::FRIEND)
+    {
+        m_friend_field = is_key(str, length, FRIEND_NAME_FIELD) && (m_friend_name == FieldState::MISSING) ? FriendField::NAME :
+                         is_key(str, length, FRIEND_HOBBIES_FIELD) && !m_friend_hobbies ? FriendField::HOBBIES : FriendField::NONE;
+    }
+    return true;
+}
+
+bool RecordHandler::EndObject(rapidjson::SizeType)
+{
+    on_end();
+    return true;
+}
+
+bool RecordHandler::StartArray()
+{
+    on_start(true);
+    return true;
+}
+
+bool RecordHandler::EndArray(rapidjson::SizeType)
+{
+    on_end();
+    return true;
+}
+
+void RecordHandler::reset()
+{
+    m_contexts.clear();
+}
+
+int RecordHandler::get_bad_records() const
+{
+    return m_n_bad_records;
+}
+
+void RecordHandler::on_value(bool is_string, const char* str, rapidjson::SizeType length, bool is_int, int i)
+{
+    switch (m_contexts.back())
+    {
+    case Context::RECORDS:
+        log_not_object();
+        m_n_bad_records++;
+        break;
+    case Context::RECORD:
+        switch (m_field)
+        {
+        case CITY:
+            m_fields[CITY] = is_string ? FieldState::VALID : FieldState::INVALID;
+            if (is_string)
+            {
+                m_record.city.assign(str, length);
+            }
+            break;
+        case CITIZEN_NAME:
+            m_fields[CITIZEN_NAME] = is_string ? FieldState::VALID : FieldState::INVALID;
+            if (is_string)
+            {
+                m_record.name.assign(str, length);
+            }
+            break;
+        case CITIZEN_ID:
+            m_fields[CITIZEN_ID] = is_int ? FieldState::VALID : FieldState::INVALID;
+            m_record.id = i;
+            break;
+        case CITIZEN_AGE:
+            m_fields[CITIZEN_AGE] = is_int ? FieldState::VALID : FieldState::INVALID;
+            m_record.age = i;
+            break;
+        case FRIENDS:
+            m_fields[FRIENDS] = FieldState::INVALID;
+            break;
+        case N_FIELDS:
+            break;
+        }
+        break;
+    case Context::FRIEND:
+        if (m_friend_field == FriendField::NAME)
+        {
+            m_friend_name = is_string ? FieldState::VALID : FieldState::INVALID;
+            if (is_string)
+            {
+                m_friend.name.assign(str, length);
+            }
+        }
+        else if (m_friend_field == FriendField::HOBBIES)
+        {
+            m_friend_hobbies = true;
+        }
+        break;
+    case Context::HOBBIES:
+        if (is_string)
+        {
+            m_friend.hobbies.emplace_back(str, length);
+        }
+        break;
+    case Context::FRIENDS:
+    case Context::SKIP:
+        break;
+    }
+}
+
+void RecordHandler::on_start(bool is_array)
+{
+    if (m_contexts.empty() || (m_contexts.back() == Context::RECORDS))
+    {
+        if (!is_array)
+        {
+            // A new record
+            m_record = Record();
+            for (auto& field : m_fields)
+            {
+                field = FieldState::MISSING;
+            }
+            m_contexts.push_back(Context::RECORD);
+        }
+        else if (m_contexts.empty())
+        {
+            m_contexts.push_back(Context::RECORDS);
+        }
+        else
+        {
+            log_not_object();
+            m_n_bad_records++;
+            m_contexts.push_back(Context::SKIP);
+        }
+        return;
+    }
+
+    Context context = Context::SKIP;
+    switch (m_contexts.back())
+    {
+    case Context::RECORD:
+        if (m_field != N_FIELDS)
+        {
+            const bool valid = (m_field == FRIENDS) && is_array;
+            m_fields[m_field] = valid ? FieldState::VALID : FieldState::INVALID;
+            context = valid ? Context::FRIENDS : Context::SKIP;
+        }
+        break;
+    case Context::FRIENDS:
+        if (!is_array)
+        {
+            m_friend = Friend();
+            m_friend_name = FieldState::MISSING;
+            m_friend_hobbies = false;
+            context = Context::FRIEND;
+        }
+        break;
+    case Context::FRIEND:
+        if (m_friend_field == FriendField::NAME)
+        {
+            m_friend_name = FieldState::INVALID;
+        }
+        else if (m_friend_field == FriendField::HOBBIES)
+        {
+            m_friend_hobbies = true;
+            context = is_array ? Context::HOBBIES : Context::SKIP;
+        }
+        break;
+    default:
+        break;
+    }
+    m_contexts.push_back(context);
+}
+
+void RecordHandler::on_end()
+{
+    const Context context = m_contexts.back();
+    m_contexts.pop_back();
+
+    if (context == Context::RECORD)
+    {
+        end_record();
+    }
+    else if ((context == Context::FRIEND) && (m_friend_name == FieldState::VALID))
+    {
+        m_record.friends.emplace_back(std::move(m_friend));
+    }
+}
+
+void RecordHandler::end_record()
+{
+    // Validate in the same order as Tables::add_record(), so the same field is reported
+    static const char* const names[N_FIELDS] = { "CITY", "CITIZEN_ID", "CITIZEN_NAME", "CITIZEN_AGE", "FRIEND" };
+    static const char* const types[N_FIELDS] = { "String", "Int", "String", "Int", "Array" };
+    static LogType bad_fields[N_FIELDS] = {
+        {Logger::Level::WARNING, "records with a missing or unexpected field CITY"},
+        {Logger::Level::WARNING, "records with a missing or unexpected field CITIZEN_ID"},
+        {Logger::Level::WARNING, "records with a missing or unexpected field CITIZEN_NAME"},
+        {Logger::Level::WARNING, "records with a missing or unexpected field CITIZEN_AGE"},
+        {Logger::Level::WARNING, "records with a missing or unexpected field FRIEND"},
+    };
+    for (int i_field = 0; i_field < N_FIELDS; i_field++)
+    {
+        // ID isn't always present, so this is optional
+        const bool optional = (i_field == CITIZEN_ID);
+        if ((m_fields[i_field] == FieldState::INVALID) || (!optional && (m_fields[i_field] == FieldState::MISSING)))
+        {
+            LogMessage(bad_fields[i_field]) << ((m_fields[i_field] == FieldState::INVALID) ? "Unexpected " : "Missing ")
+                                            << "field type " << names[i_field] << "; Expecting " << types[i_field];
+            m_n_bad_records++;
+            return;
+        }
+    }
+
+    m_record.has_id = (m_fields[CITIZEN_ID] == FieldState::VALID);
+    if (m_tables)
+    {
+        m_tables->add_record(std::move(m_record));
+    }
+    else
+    {
+        m_records->push_back(std::move(m_record));
+    }
+}
@@ -0,0 +1,189 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <rapidjson/document.h>
+
+#include "response_cache.hpp"
+#include "logger.hpp"
+#include "query_to_json.hpp"
+
+namespace
+{
+/**
+ * \brief Returns the 64 bit FNV-1a hash of the text, which names the files of an endpoint
+ *
+ * Unlike std::hash, this is the same for every build, so a cache outlives the program that wrote it.
+*/
+uint64_t fnv1a(const std::string &text)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * \brief Reads the whole file into the string
+ *
+ * \returns false if the file could not be read
+*/
+bool read_file(const std::string &path, std::string &contents)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return !file.bad();
+}
+
+/**
+ * \brief Replaces the file with the contents, by renaming a complete temporary file over it
+ *
+ * \returns false if the file could not be written
+*/
+bool write_file(const std::string &path, const std::string &contents)
+{
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), contents.size());
+        if (!file.flush())
+        {
+            LogMessage(Logger::Level::WARNING) << "could not write " << temporary_path;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+    if (error)
+    {
+        LogMessage(Logger::Level::WARNING) << "could not replace " << path << ": " << error.message();
+        std::remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
+} // namespace
+
+ResponseCache::ResponseCache(const char* directory) : m_directory(directory), m_error(ErrorType::NONE)
+{
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error || !std::filesystem::is_directory(m_directory, error))
+    {
+        LogMessage(Logger::Level::ERROR) << "could not create cache directory " << m_directory;
+        m_error = ErrorType::DIRECTORY;
+    }
+}
+
+bool ResponseCache::load_validators(const std::string &endpoint, Validators &validators) const
+{
+    // The meta file holds the endpoint, the ETag and Last-Modified, one per line
+    std::ifstream file(get_path(endpoint, ".meta"));
+    std::string cached_endpoint;
+    Validators cached;
+    if (!std::getline(file, cached_endpoint) || (cached_endpoint != endpoint) ||
+        !std::getline(file, cached.etag) || !std::getline(file, cached.last_modified))
+    {
+        return false;
+    }
+    validators = cached;
+    return true;
+}
+
+bool ResponseCache::load_body(const std::string &endpoint, std::string &body) const
+{
+    return is_cached(endpoint) && read_file(get_path(endpoint, ".body"), body);
+}
+
+bool ResponseCache::store_response(const std::string &endpoint, const Validators &validators, const std::string &body)
+{
+    if (m_error != ErrorType::NONE)
+    {
+        return false;
+    }
+
+    // The meta file is written last, so the validators are only found once the body is complete
+    std::remove(get_path(endpoint, ".results").c_str());
+    std::remove(get_path(endpoint, ".meta").c_str());
+    return write_file(get_path(endpoint, ".body"), body) &&
+           write_file(get_path(endpoint, ".meta"), endpoint + "\n" + validators.etag + "\n" + validators.last_modified + "\n");
+}
+
+bool ResponseCache::load_results(const std::string &endpoint, Results &results) const
+{
+    std::string json;
+    if (!is_cached(endpoint) || !read_file(get_path(endpoint, ".results"), json))
+    {
+        return false;
+    }
+
+    // The results are cached in the same format as they are output
+    rapidjson::Document document;
+    if (document.Parse(json.data(), json.size()).HasParseError() || !document.IsObject() ||
+        !document.HasMember("cities") || !document["cities"].IsArray() ||
+        !document.HasMember("most_common_first_name") || !document["most_common_first_name"].IsString() ||
+        !document.HasMember("most_common_hobby") || !document["most_common_hobby"].IsString())
+    {
+        LogMessage(Logger::Level::WARNING) << "ignoring ill formatted cached results of " << endpoint;
+        return false;
+    }
+
+    Results cached;
+    for (const auto& city : document["cities"].GetArray())
+    {
+        if (!city.IsObject() ||
+            !city.HasMember("city_name") || !city["city_name"].IsString() ||
+            !city.HasMember("average_age") || !city["average_age"].IsInt() ||
+            !city.HasMember("average_number_of_friends") || !city["average_number_of_friends"].IsInt() ||
+            !city.HasMember("user_with_most_friends") || !city["user_with_most_friends"].IsString())
+        {
+            LogMessage(Logger::Level::WARNING) << "ignoring ill formatted cached results of " << endpoint;
+            return false;
+        }
+        cached.cities.push_back({city["city_name"].GetString(), city["average_age"].GetInt(),
+                                 city["average_number_of_friends"].GetInt(), city["user_with_most_friends"].GetString()});
+    }
+    cached.most_common_first_name = document["most_common_first_name"].GetString();
+    cached.most_common_hobby = document["most_common_hobby"].GetString();
+
+    results = std::move(cached);
+    return true;
+}
+
+bool ResponseCache::store_results(const std::string &endpoint, const Results &results)
+{
+    if ((m_error != ErrorType::NONE) || !is_cached(endpoint))
+    {
+        return false;
+    }
+    return write_file(get_path(endpoint, ".results"), QueryToJson(results).get_json(false));
+}
+
+ResponseCache::ErrorType ResponseCache::get_error() const
+{
+    return m_error;
+}
+
+std::string ResponseCache::get_path(const std::string &endpoint, const char* extension) const
+{
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(fnv1a(endpoint)));
+    return (std::filesystem::path(m_directory) / (std::string(name) + extension)).string();
+}
+
+bool ResponseCache::is_cached(const std::string &endpoint) const
+{
+    Validators validators;
+    return load_validators(endpoint, validators);
+}
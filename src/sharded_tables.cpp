@@ -0,0 +1,145 @@
+#include "sharded_tables.hpp"
+
+#include <algorithm>
+
+ShardedTables::ShardedTables(unsigned int n_shards) : m_generated_id(1), m_position(0)
+{
+    for (unsigned int i_shard = 0; i_shard < std::max(n_shards, 1u); i_shard++)
+    {
+        m_shards.emplace_back(new Shard);
+        m_shards.back()->thread = std::thread(&ShardedTables::run, std::ref(*m_shards.back()));
+    }
+}
+
+ShardedTables::~ShardedTables()
+{
+    for (auto& shard : m_shards)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shard->mutex);
+            shard->stop = true;
+        }
+        shard->changed.notify_all();
+    }
+    for (auto& shard : m_shards)
+    {
+        shard->thread.join();
+    }
+}
+
+void ShardedTables::add_records(Record *records, size_t n_records)
+{
+    // Number the records without an id in order, as Tables would, then split them by id
+    const size_t n_shards = m_shards.size();
+    std::vector<std::vector<Record>> shard_records(n_shards);
+    std::vector<std::vector<size_t>> shard_positions(n_shards);
+    for (size_t i_record = 0; i_record < n_records; i_record++)
+    {
+        Record& record = records[i_record];
+        if (!record.has_id)
+        {
+            record.id = m_generated_id++;
+            record.has_id = true;
+        }
+        const size_t position = m_position++;
+        if (record.id < 0)
+        {
+            continue;
+        }
+
+        const size_t i_shard = static_cast<unsigned int>(record.id) % n_shards;
+        shard_records[i_shard].push_back(std::move(record));
+        shard_positions[i_shard].push_back(position);
+    }
+
+    for (size_t i_shard = 0; i_shard < n_shards; i_shard++)
+    {
+        if (shard_records[i_shard].empty())
+        {
+            continue;
+        }
+        push(*m_shards[i_shard], [part = std::move(shard_records[i_shard]), positions = std::move(shard_positions[i_shard])]
+                                 (Tables& tables) mutable
+        {
+            tables.add_records(part.data(), part.size(), positions.data());
+        });
+    }
+}
+
+void ShardedTables::begin_update()
+{
+    m_generated_id = 1;
+    for (auto& shard : m_shards)
+    {
+        push(*shard, [](Tables& tables) { tables.begin_update(); });
+    }
+}
+
+void ShardedTables::end_update()
+{
+    for (auto& shard : m_shards)
+    {
+        push(*shard, [](Tables& tables) { tables.end_update(); });
+    }
+    wait();
+}
+
+Results ShardedTables::query_results() const
+{
+    return partial_results().get_results();
+}
+
+PartialResults ShardedTables::partial_results() const
+{
+    wait();
+    PartialResults merged;
+    for (const auto& shard : m_shards)
+    {
+        merged.merge(shard->tables.partial_results());
+    }
+    return merged;
+}
+
+void ShardedTables::push(Shard &shard, std::function<void(Tables&)> &&task)
+{
+    {
+        std::unique_lock<std::mutex> lock(shard.mutex);
+        shard.changed.wait(lock, [&shard] { return shard.tasks.size() < MAX_PENDING_TASKS; });
+        shard.tasks.push_back(std::move(task));
+    }
+    shard.changed.notify_all();
+}
+
+void ShardedTables::run(Shard &shard)
+{
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    while (true)
+    {
+        shard.changed.wait(lock, [&shard] { return shard.stop || !shard.tasks.empty(); });
+        if (shard.tasks.empty())
+        {
+            return;
+        }
+
+        std::function<void(Tables&)> task = std::move(shard.tasks.front());
+        shard.tasks.pop_front();
+        shard.busy = true;
+        lock.unlock();
+        shard.changed.notify_all();
+
+        task(shard.tables);
+
+        lock.lock();
+        shard.busy = false;
+        shard.changed.notify_all();
+    }
+}
+
+void ShardedTables::wait() const
+{
+    for (const auto& shard : m_shards)
+    {
+        std::unique_lock<std::mutex> lock(shard->mutex);
+        shard->changed.wait(lock, [&shard] { return shard->tasks.empty() && !shard->busy; });
+    }
+}
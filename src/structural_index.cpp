@@ -0,0 +1,285 @@
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define STRUCTURAL_INDEX_X86 1
+#include <immintrin.h>
+#else
+#define STRUCTURAL_INDEX_X86 0
+#endif
+
+#include "structural_index.hpp"
+
+namespace
+{
+constexpr uint64_t EVEN_BITS = 0x5555555555555555ULL; /// Bits at even positions of a mask
+
+/**
+ * \brief Returns a mask with the lowest size bits set
+*/
+uint64_t low_bits(size_t size)
+{
+    return (size >= StructuralIndex::BLOCK_SIZE) ? ~0ULL : ((1ULL << size) - 1);
+}
+
+/**
+ * \brief Classifies 64 bytes one at a time
+*/
+StructuralIndex::Masks classify_scalar(const char* block)
+{
+    StructuralIndex::Masks masks = {};
+    for (size_t i_byte = 0; i_byte < StructuralIndex::BLOCK_SIZE; i_byte++)
+    {
+        const uint64_t bit = 1ULL << i_byte;
+        const unsigned char c = static_cast<unsigned char>(block[i_byte]);
+        masks.quote |= (c == '"') ? bit : 0;
+        masks.backslash |= (c == '\\') ? bit : 0;
+        masks.open_brace |= (c == '{') ? bit : 0;
+        masks.close_brace |= (c == '}') ? bit : 0;
+        masks.open_square |= (c == '[') ? bit : 0;
+        masks.close_square |= (c == ']') ? bit : 0;
+        masks.whitespace |= ((c == ' ') || (static_cast<unsigned char>(c - '\t') <= '\r' - '\t')) ? bit : 0;
+    }
+    return masks;
+}
+
+#if STRUCTURAL_INDEX_X86
+// The vector variants are built for their own instruction sets whatever the compiler targets, so that each can be
+// tested on a machine which has it. They are only called by classify_block() if the compiler targets them.
+
+/**
+ * \brief Returns the mask of the 16 bytes equal to c
+*/
+__attribute__((target("sse2"))) uint64_t match(__m128i bytes, char c)
+{
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))));
+}
+
+/**
+ * \brief Returns the mask of the 16 bytes which are whitespace
+*/
+__attribute__((target("sse2"))) uint64_t match_whitespace(__m128i bytes)
+{
+    // '\t', '\n', '\v', '\f' and '\r' are consecutive, so one unsigned comparison finds them all
+    const __m128i control = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+    const __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+    const __m128i is_space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_or_si128(is_control, is_space)));
+}
+
+/**
+ * \brief Classifies 64 bytes as four quarters of 16
+*/
+__attribute__((target("sse2"))) StructuralIndex::Masks classify_sse2(const char* block)
+{
+    StructuralIndex::Masks masks = {};
+    for (int i_quarter = 0; i_quarter < 4; i_quarter++)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i_quarter));
+        const int shift = 16 * i_quarter;
+        masks.quote |= match(bytes, '"') << shift;
+        masks.backslash |= match(bytes, '\\') << shift;
+        masks.open_brace |= match(bytes, '{') << shift;
+        masks.close_brace |= match(bytes, '}') << shift;
+        masks.open_square |= match(bytes, '[') << shift;
+        masks.close_square |= match(bytes, ']') << shift;
+        masks.whitespace |= match_whitespace(bytes) << shift;
+    }
+    return masks;
+}
+
+/**
+ * \brief Returns the mask of the 32 bytes equal to c
+*/
+__attribute__((target("avx2"))) uint64_t match(__m256i bytes, char c)
+{
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c))));
+}
+
+/**
+ * \brief Returns the mask of the 32 bytes which are whitespace
+*/
+__attribute__((target("avx2"))) uint64_t match_whitespace(__m256i bytes)
+{
+    // '\t', '\n', '\v', '\f' and '\r' are consecutive, so one unsigned comparison finds them all
+    const __m256i control = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+    const __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control);
+    const __m256i is_space = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(is_control, is_space)));
+}
+
+/**
+ * \brief Classifies 64 bytes as two halves of 32
+*/
+__attribute__((target("avx2"))) StructuralIndex::Masks classify_avx2(const char* block)
+{
+    const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+    StructuralIndex::Masks masks;
+    masks.quote = match(low, '"') | (match(high, '"') << 32);
+    masks.backslash = match(low, '\\') | (match(high, '\\') << 32);
+    masks.open_brace = match(low, '{') | (match(high, '{') << 32);
+    masks.close_brace = match(low, '}') | (match(high, '}') << 32);
+    masks.open_square = match(low, '[') | (match(high, '[') << 32);
+    masks.close_square = match(low, ']') | (match(high, ']') << 32);
+    masks.whitespace = match_whitespace(low) | (match_whitespace(high) << 32);
+    return masks;
+}
+#endif
+
+/**
+ * \brief Function classifying 64 bytes
+*/
+typedef StructuralIndex::Masks (*ClassifyFunction)(const char* block);
+
+/**
+ * \brief Returns the function of the variant given, which must be supported
+*/
+ClassifyFunction classify_function(StructuralIndex::Variant variant)
+{
+    switch (variant)
+    {
+#if STRUCTURAL_INDEX_X86
+    case StructuralIndex::Variant::SSE2:
+        return classify_sse2;
+    case StructuralIndex::Variant::AVX2:
+        return classify_avx2;
+#endif
+    default:
+        return classify_scalar;
+    }
+}
+
+/**
+ * \brief Returns the function of the fastest variant this machine supports
+*/
+ClassifyFunction fastest_classify_function()
+{
+    if (StructuralIndex::is_supported(StructuralIndex::Variant::AVX2))
+    {
+        return classify_function(StructuralIndex::Variant::AVX2);
+    }
+    if (StructuralIndex::is_supported(StructuralIndex::Variant::SSE2))
+    {
+        return classify_function(StructuralIndex::Variant::SSE2);
+    }
+    return classify_scalar;
+}
+
+const ClassifyFunction classify_fastest = fastest_classify_function(); /// Chosen once, when the program starts
+
+/**
+ * \brief Classifies 64 bytes with the fastest variant this machine supports
+*/
+StructuralIndex::Masks classify_block(const char* block)
+{
+#if STRUCTURAL_INDEX_X86 && defined(__AVX2__)
+    // Built for machines with AVX2, eg. with JSON_REST_CLIENT_NATIVE, so it can be inlined rather than called through a pointer
+    return classify_avx2(block);
+#else
+    return classify_fastest(block);
+#endif
+}
+} // namespace
+
+StructuralIndex::Masks StructuralIndex::classify(const char* data, size_t size)
+{
+    if (size >= BLOCK_SIZE)
+    {
+        return classify_block(data);
+    }
+
+    // Pad a short block with a character of no interest, rather than reading past the end
+    char block[BLOCK_SIZE];
+    std::memset(block, 'x', BLOCK_SIZE);
+    std::memcpy(block, data, size);
+    return classify_block(block);
+}
+
+StructuralIndex::Masks StructuralIndex::classify(const char* data, size_t size, Variant variant)
+{
+    if (size >= BLOCK_SIZE)
+    {
+        return classify_function(variant)(data);
+    }
+
+    char block[BLOCK_SIZE];
+    std::memset(block, 'x', BLOCK_SIZE);
+    std::memcpy(block, data, size);
+    return classify_function(variant)(block);
+}
+
+bool StructuralIndex::is_supported(Variant variant)
+{
+#if STRUCTURAL_INDEX_X86
+    // The features are normally found by a constructor in libgcc, which may not have run yet when choosing the fastest
+    __builtin_cpu_init();
+#endif
+    switch (variant)
+    {
+#if STRUCTURAL_INDEX_X86
+    case Variant::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Variant::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    case Variant::SCALAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+uint64_t StructuralIndex::find_escaped(uint64_t backslash, size_t size, uint64_t &carry)
+{
+    // A run of backslashes escapes the character after it if the run has odd length. Adding the
+    // start of each run to the run carries into the bit following the run, so runs which start on
+    // an even bit and end on an odd one, or the other way round, have odd length. A run continuing
+    // from the previous block starts on an odd bit if the previous block left the carry set.
+    const uint64_t starts = backslash & ~(backslash << 1);
+    const uint64_t even_start_mask = EVEN_BITS ^ carry;
+    const uint64_t even_starts = starts & even_start_mask;
+    const uint64_t odd_starts = starts & ~even_start_mask;
+
+    const uint64_t even_carries = backslash + even_starts;
+    uint64_t odd_carries;
+    const bool overflow = __builtin_add_overflow(backslash, odd_starts, &odd_carries);
+    odd_carries |= carry;
+
+    const uint64_t even_carry_ends = even_carries & ~backslash;
+    const uint64_t odd_carry_ends = odd_carries & ~backslash;
+    const uint64_t escaped = (even_carry_ends & ~EVEN_BITS) | (odd_carry_ends & EVEN_BITS);
+
+    // In a short block, the character following the block is one of the bits of the mask
+    carry = (size >= BLOCK_SIZE) ? (overflow ? 1 : 0) : ((escaped >> size) & 1);
+    return escaped & low_bits(size);
+}
+
+uint64_t StructuralIndex::find_in_string(uint64_t quote, uint64_t &carry)
+{
+    // Each bit becomes the parity of the quotes up to and including it
+    uint64_t in_string = quote;
+    in_string ^= in_string << 1;
+    in_string ^= in_string << 2;
+    in_string ^= in_string << 4;
+    in_string ^= in_string << 8;
+    in_string ^= in_string << 16;
+    in_string ^= in_string << 32;
+    in_string ^= carry;
+
+    carry = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+    return in_string;
+}
+
+const char* StructuralIndex::skip_whitespace(const char* begin, const char* end)
+{
+    for (const char* block = begin; block < end; block += BLOCK_SIZE)
+    {
+        const size_t size = (static_cast<size_t>(end - block) < BLOCK_SIZE) ? static_cast<size_t>(end - block) : BLOCK_SIZE;
+        const uint64_t other = ~classify(block, size).whitespace & low_bits(size);
+        if (other != 0)
+        {
+            return block + __builtin_ctzll(other);
+        }
+    }
+    return end;
+}
@@ -0,0 +1,30 @@
+#include "symbol_table.hpp"
+
+SymbolTable::SymbolTable()
+{
+    intern(std::string_view());
+}
+
+Symbol SymbolTable::intern(std::string_view str)
+{
+    const auto existing = m_symbols.find(str);
+    if (existing != m_symbols.end())
+    {
+        return existing->second;
+    }
+
+    const Symbol symbol = static_cast<Symbol>(m_strings.size());
+    m_strings.emplace_back(str);
+    m_symbols.emplace(m_strings.back(), symbol);
+    return symbol;
+}
+
+const std::string& SymbolTable::get_string(Symbol symbol) const
+{
+    return m_strings[symbol];
+}
+
+size_t SymbolTable::size() const
+{
+    return m_strings.size();
+}
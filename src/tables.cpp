@@ -1,17 +1,62 @@
 #include "tables.hpp"
+#include "for_each_region.hpp"
+#include "logger.hpp"
 
-#include <iostream>
+#include <algorithm>
+#include <numeric>
 #include <string>
 
 namespace
 {
-constexpr const char* CITY_FIELD = "city";              /// Field name of the city as it appears in the endpoint response
-constexpr const char* CITIZEN_ID_FIELD = "id";          /// Field name of the citizen id as it appears in the endpoint response
-constexpr const char* CITIZEN_NAME_FIELD = "name";      /// Field name of the citizen name as it appears in the endpoint response
-constexpr const char* CITIZEN_AGE_FIELD = "age";        /// Field name of the citizen's age as it appears in the endpoint response
-constexpr const char* FRIEND_FIELD = "friends";         /// Field name of the citizen's friends array as it appears in the endpoint response
-constexpr const char* FRIEND_NAME_FIELD = "name";       /// Field name of the friend name as it appears in the endpoint response
-constexpr const char* FRIEND_HOBBIES_FIELD = "hobbies"; /// Field name of the friend's hobbies array as it appears in the endpoint response
+/**
+ * \brief Returns true if both lists hold the same friends, with the same hobbies, in the same order
+*/
+bool same_friends(const std::vector<CitizenFriend>& a, const std::vector<CitizenFriend>& b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const CitizenFriend& x, const CitizenFriend& y)
+    {
+        return (x.name == y.name) && (x.hobbies == y.hobbies);
+    });
+}
+
+/**
+ * \brief Reserves room for n more elements of a vector
+ * 
+ * A vector which grows by a batch at a time still doubles its capacity, rather than growing by
+ * exactly one batch and so being copied for every batch.
+*/
+template <typename T>
+void reserve_more(std::vector<T>& v, size_t n)
+{
+    if (v.size() + n > v.capacity())
+    {
+        v.reserve(std::max(v.size() + n, 2 * v.capacity()));
+    }
+}
+
+/**
+ * \brief Makes a citizen the user with most friends of their city, if they have more friends, or as many and come first
+*/
+void consider_most_friends(CityTotals& totals, unsigned int n_friends, Symbol name, size_t city_order)
+{
+    if ((n_friends > totals.max_friends) ||
+        ((n_friends == totals.max_friends) && (n_friends > 0) && (city_order < totals.max_order)))
+    {
+        totals.max_friends = n_friends;
+        totals.max_name = name;
+        totals.max_order = city_order;
+    }
+}
+
+/**
+ * \brief Range of rows searched on one thread, with the users with most friends found in it
+*/
+struct RowRange
+{
+    size_t begin;
+    size_t end;
+    std::vector<CityTotals> cities;
+};
 }
 
 /*
@@ -41,9 +86,10 @@ Expecting data records in this format:
 }
 */
 
-Tables::Tables() : m_generated_id(1)
+Tables::Tables() : m_generated_id(1), m_city_order(0), m_update(0), m_stale_cities(false),
+                   m_search_threads(1), m_min_search_rows(DEFAULT_MIN_SEARCH_ROWS)
 {
-    
+    intern(std::string_view());
 }
 
 #define CHECK_FIELDS(X, Y, OPTIONAL)                                                             \
@@ -51,29 +97,31 @@ if (!(record->HasMember(X##_FIELD) && (*record)[X##_FIELD].Is##Y()))
 {                                                                                                \
     if(!OPTIONAL || (record->HasMember(X##_FIELD) && !(*record)[X##_FIELD].Is##Y()))             \
     {                                                                                            \
-        std::cerr << (record->HasMember(X##_FIELD) ? "Unexpected " : "Missing ");                \
-        std::cerr << "field type " << #X << "; Expecting " << #Y << std::endl;                   \
-        if(record->HasMember(X##_FIELD))                                                         \
-        {                                                                                        \
-            std::cerr << "    String: " << (*record)[X##_FIELD].IsString() << std::endl;         \
-            std::cerr << "    Int: " << (*record)[X##_FIELD].IsInt() << std::endl;               \
-            std::cerr << "    Int64: " << (*record)[X##_FIELD].IsInt64() << std::endl;           \
-            std::cerr << "    Uint: " << (*record)[X##_FIELD].IsUint() << std::endl;             \
-            std::cerr << "    Uint64: " << (*record)[X##_FIELD].IsUint64() << std::endl;         \
-            std::cerr << "    Double: " << (*record)[X##_FIELD].IsDouble() << std::endl;         \
-            std::cerr << "    Bool: " << (*record)[X##_FIELD].IsBool() << std::endl;             \
-            std::cerr << "    Array: " << (*record)[X##_FIELD].IsArray() << std::endl;           \
-            std::cerr << "    Object: " << (*record)[X##_FIELD].IsObject() << std::endl;         \
-            std::cerr << "    Null: " << (*record)[X##_FIELD].IsNull() << std::endl;             \
-        }                                                                                        \
-        std::cerr << std::endl;                                                                  \
-        if (record->IsObject())                                                                  \
+        static LogType bad_field(Logger::Level::WARNING,                                         \
+                                 "records with a missing or unexpected field " #X);              \
+        LogMessage(bad_field) << (record->HasMember(X##_FIELD) ? "Unexpected " : "Missing ")     \
+                              << "field type " << #X << "; Expecting " << #Y;                    \
+        LogMessage details(Logger::Level::DEBUG);                                                \
+        if (details.is_logged())                                                                 \
         {                                                                                        \
-            for(auto it = record->MemberBegin(); it != record->MemberEnd(); it++)                \
+            if(record->HasMember(X##_FIELD))                                                     \
             {                                                                                    \
-                std::cerr << "\"" << it->name.GetString() << "\", ";                             \
+                const rapidjson::Value& field = (*record)[X##_FIELD];                            \
+                details << "Field " << #X << " is String: " << field.IsString()                  \
+                        << "; Int: " << field.IsInt() << "; Int64: " << field.IsInt64()          \
+                        << "; Uint: " << field.IsUint() << "; Uint64: " << field.IsUint64()      \
+                        << "; Double: " << field.IsDouble() << "; Bool: " << field.IsBool()      \
+                        << "; Array: " << field.IsArray() << "; Object: " << field.IsObject()     \
+                        << "; Null: " << field.IsNull() << "\n";                                 \
+            }                                                                                    \
+            details << "Fields of the record: ";                                                 \
+            if (record->IsObject())                                                              \
+            {                                                                                    \
+                for(auto it = record->MemberBegin(); it != record->MemberEnd(); it++)            \
+                {                                                                                \
+                    details << "\"" << it->name.GetString() << "\", ";                           \
+                }                                                                                \
             }                                                                                    \
-            std::cerr << std::endl;                                                              \
         }                                                                                        \
         return false;                                                                            \
     }                                                                                            \
@@ -88,129 +136,521 @@ bool Tables::add_record(const rapidjson::Value *record)
     CHECK_FIELDS(CITIZEN_AGE, Int, false)
     CHECK_FIELDS(FRIEND, Array, false)
 
-    const std::string city = (*record)[CITY_FIELD].GetString();
-    const int citizen_id = record->HasMember(CITIZEN_ID_FIELD) ?
-                            (*record)[CITIZEN_ID_FIELD].GetInt() :
-                            m_generated_id++;   // If the id field is missing, use m_generate_id instead
-    const std::string citizen_name = (*record)[CITIZEN_NAME_FIELD].GetString();
-    const int citizen_age = (*record)[CITIZEN_AGE_FIELD].GetInt();
-    const auto& friends = (*record)[FRIEND_FIELD].GetArray();
+    Record fields;
+    fields.has_id = record->HasMember(CITIZEN_ID_FIELD);
+    fields.id = fields.has_id ? (*record)[CITIZEN_ID_FIELD].GetInt() : 0;
+    fields.name = (*record)[CITIZEN_NAME_FIELD].GetString();
+    fields.age = (*record)[CITIZEN_AGE_FIELD].GetInt();
+    fields.city = (*record)[CITY_FIELD].GetString();
 
-    // Populate the Tables
-    if (citizen_id >= 0)
+    const auto& friends = (*record)[FRIEND_FIELD].GetArray();
+    for(size_t i_friend = 0; i_friend < friends.Size(); i_friend++)
     {
-        auto& citizen_row = m_citizen[citizen_id];
-        citizen_row.name = citizen_name;
-        citizen_row.age = citizen_age;
-
-        if (!city.empty())
+        const auto& hfriend = friends[i_friend];
+        if (hfriend.IsObject() && hfriend.HasMember(FRIEND_NAME_FIELD) && hfriend[FRIEND_NAME_FIELD].IsString())
         {
-            m_city_citizen[city].push_back(citizen_id);
-        }
+            Friend f;
+            f.name = hfriend[FRIEND_NAME_FIELD].GetString();
 
-        for(size_t i_friend = 0; i_friend < friends.Size(); i_friend++)
-        {
-            const auto& hfriend = friends[i_friend];
-            if (hfriend.HasMember(FRIEND_NAME_FIELD) && hfriend[FRIEND_NAME_FIELD].IsString())
+            if(hfriend.HasMember(FRIEND_HOBBIES_FIELD) && hfriend[FRIEND_HOBBIES_FIELD].IsArray())
             {
-                Friend f;
-                f.name = hfriend[FRIEND_NAME_FIELD].GetString();
-                m_citizen_friends[citizen_id].emplace_back(f);
-
-                if(hfriend.HasMember(FRIEND_HOBBIES_FIELD) && hfriend[FRIEND_HOBBIES_FIELD].IsArray())
+                const auto& hobbies = hfriend[FRIEND_HOBBIES_FIELD];
+                for(size_t i_hobby = 0; i_hobby < hobbies.Size(); i_hobby++)
                 {
-                    const auto& hobbies = hfriend[FRIEND_HOBBIES_FIELD];
-                    for(size_t i_hobby = 0; i_hobby < hobbies.Size(); i_hobby++)
+                    if(hobbies[i_hobby].IsString())
                     {
-                        if(hobbies[i_hobby].IsString())
-                        {
-                            m_hobby_friends[hobbies[i_hobby].GetString()].push_back(f.name);
-                        }
+                        f.hobbies.emplace_back(hobbies[i_hobby].GetString());
                     }
                 }
             }
+            fields.friends.emplace_back(std::move(f));
         }
     }
 
+    add_record(std::move(fields));
     return true;
 }
 #undef CHECK_FIELDS
 
-Results Tables::query_results() const
+void Tables::add_record(Record &&record)
 {
-    Results results;
-    std::map<std::string, int> citizen_names;
+    add_record(std::move(record), m_city_order++);
+}
 
-    // Iterate over cities and determine the per city results
-    for(auto& i_city : m_city_citizen)
+void Tables::add_record(Record &&record, size_t city_order)
+{
+    const int citizen_id = record.has_id ? record.id : m_generated_id++;   // If the id field is missing, use m_generate_id instead
+
+    // Populate the Tables
+    if (citizen_id >= 0)
     {
-        CityResults city_results;
-        city_results.city_name = i_city.first;
-        if(i_city.second.size() > 0)
+        const Symbol city = intern(record.city);
+        const Symbol citizen_name = intern(record.name);
+        const int citizen_age = record.age;
+        std::vector<CitizenFriend> citizen_friends = intern_friends(record.friends);
+
+        auto existing = m_citizen_rows.find(citizen_id);
+        if (existing == m_citizen_rows.end())
         {
-            size_t age = 0;
-            int n_friends = 0;
-            std::pair<size_t, std::string> max_friends {0, ""};
-            for(auto& i_citizen : i_city.second)
+            const unsigned int row = add_citizen(citizen_id, citizen_name, citizen_age, city, city_order);
+            m_citizen_rows[citizen_id] = row;
+            add_friends(row, std::move(citizen_friends));
+            join_city(row);
+            return;
+        }
+
+        // The citizen is already known, eg. from the previous response. They take the position of their first record
+        // in this response, or of the record moving them to another city, just as if the tables had been built afresh
+        // from this response, so which of them comes first doesn't depend on the previous ones.
+        const unsigned int row = existing->second;
+        const bool first_seen = (m_citizens.update[row] != m_update);
+        const size_t order = (first_seen || (m_citizens.city[row] != city)) ? city_order : m_citizens.city_order[row];
+        m_citizens.update[row] = m_update;
+        if (same_friends(m_citizens.friends[row], citizen_friends) && (m_citizens.name[row] == citizen_name) &&
+            (m_citizens.age[row] == citizen_age) && (m_citizens.city[row] == city))
+        {
+            if (m_citizens.city_order[row] != order)
             {
-                const auto& citizen = m_citizen.find(i_citizen);
-                if (citizen != m_citizen.end())
-                {
-                    age += citizen->second.age;
-                    auto c_name = citizen_names.find(citizen->second.name);
-                    if(c_name == citizen_names.end())
-                    {
-                        citizen_names[citizen->second.name] = 1;
-                    }
-                    else
-                    {
-                        c_name->second++;
-                    }
-                }
+                // Leaving marks the city stale if they were the user with most friends, as another may now come first
+                leave_city(row);
+                m_citizens.city_order[row] = order;
+                join_city(row);
+            }
+            return;
+        }
+
+        // Replace the citizen
+        leave_city(row);
+        remove_friends(row);
+        m_citizens.city_order[row] = order;
+        m_citizens.name[row] = citizen_name;
+        m_citizens.age[row] = citizen_age;
+        m_citizens.city[row] = city;
+        add_friends(row, std::move(citizen_friends));
+        join_city(row);
+    }
+}
+
+void Tables::add_records(Record *records, size_t n_records)
+{
+    add_records(records, n_records, nullptr);
+}
+
+void Tables::add_records(Record *records, size_t n_records, const size_t *positions)
+{
+    // Number the records without an id in order, as add_record() would
+    for (size_t i_record = 0; i_record < n_records; i_record++)
+    {
+        if (!records[i_record].has_id)
+        {
+            records[i_record].id = m_generated_id++;
+            records[i_record].has_id = true;
+        }
+    }
+
+    // Group the records by id, to find those new to the tables which appear only once in the batch
+    std::vector<size_t> by_id(n_records);
+    std::iota(by_id.begin(), by_id.end(), 0);
+    std::stable_sort(by_id.begin(), by_id.end(), [records](size_t a, size_t b)
+    {
+        return records[a].id < records[b].id;
+    });
+
+    std::vector<bool> is_new(n_records, false);
+    for (size_t i_sorted = 0; i_sorted < n_records; i_sorted++)
+    {
+        const int citizen_id = records[by_id[i_sorted]].id;
+        const bool repeated = ((i_sorted > 0) && (records[by_id[i_sorted - 1]].id == citizen_id)) ||
+                              ((i_sorted + 1 < n_records) && (records[by_id[i_sorted + 1]].id == citizen_id));
+        if ((citizen_id < 0) || repeated)
+        {
+            continue;
+        }
+        is_new[by_id[i_sorted]] = (m_citizen_rows.find(citizen_id) == m_citizen_rows.end());
+    }
+
+    // Add the runs of new records together, and the others in turn between them
+    std::vector<size_t> new_records;
+    new_records.reserve(n_records);
+    for (size_t i_record = 0; i_record < n_records; i_record++)
+    {
+        if (is_new[i_record])
+        {
+            new_records.push_back(i_record);
+            continue;
+        }
+        add_new_records(records, new_records, positions);
+        new_records.clear();
+        add_record(std::move(records[i_record]), (positions != nullptr) ? positions[i_record] : m_city_order++);
+    }
+    add_new_records(records, new_records, positions);
+}
+
+void Tables::add_new_records(Record *records, const std::vector<size_t> &new_records, const size_t *positions)
+{
+    if (new_records.empty())
+    {
+        return;
+    }
+
+    // The citizens are appended in the order of the records, so they join their cities in that order
+    const size_t first_row = m_citizens.id.size();
+    reserve_more(m_citizens.id, new_records.size());
+    reserve_more(m_citizens.name, new_records.size());
+    reserve_more(m_citizens.age, new_records.size());
+    reserve_more(m_citizens.city, new_records.size());
+    reserve_more(m_citizens.city_order, new_records.size());
+    reserve_more(m_citizens.n_friends, new_records.size());
+    reserve_more(m_citizens.friends, new_records.size());
+    reserve_more(m_citizens.update, new_records.size());
+    for (const size_t i_record : new_records)
+    {
+        const Record& record = records[i_record];
+        const Symbol city = intern(record.city);
+        const Symbol citizen_name = intern(record.name);
+        const size_t city_order = (positions != nullptr) ? positions[i_record] : m_city_order++;
+        const unsigned int row = add_citizen(record.id, citizen_name, record.age, city, city_order);
+        add_friends(row, intern_friends(record.friends));
+        join_city(row);
+    }
+
+    m_citizen_rows.reserve(m_citizens.id.size());
+    for (size_t row = first_row; row < m_citizens.id.size(); row++)
+    {
+        m_citizen_rows.emplace(m_citizens.id[row], static_cast<unsigned int>(row));
+    }
+}
+
+void Tables::begin_update()
+{
+    m_update++;
+    m_generated_id = 1;
+}
+
+void Tables::end_update()
+{
+    // Remove the citizens which were not in this update, moving the rows after each one up to fill the gap
+    const size_t n_rows = m_citizens.id.size();
+    size_t n_kept = 0;
+    for (size_t row = 0; row < n_rows; row++)
+    {
+        if (m_citizens.update[row] != m_update)
+        {
+            leave_city(static_cast<unsigned int>(row));
+            remove_friends(static_cast<unsigned int>(row));
+            m_citizen_rows.erase(m_citizens.id[row]);
+            continue;
+        }
+
+        if (n_kept != row)
+        {
+            m_citizens.id[n_kept] = m_citizens.id[row];
+            m_citizens.name[n_kept] = m_citizens.name[row];
+            m_citizens.age[n_kept] = m_citizens.age[row];
+            m_citizens.city[n_kept] = m_citizens.city[row];
+            m_citizens.city_order[n_kept] = m_citizens.city_order[row];
+            m_citizens.n_friends[n_kept] = m_citizens.n_friends[row];
+            m_citizens.friends[n_kept] = std::move(m_citizens.friends[row]);
+            m_citizens.update[n_kept] = m_citizens.update[row];
+            m_citizen_rows.find(m_citizens.id[n_kept])->second = static_cast<unsigned int>(n_kept);
+        }
+        n_kept++;
+    }
+
+    if (n_kept < n_rows)
+    {
+        m_citizens.id.resize(n_kept);
+        m_citizens.name.resize(n_kept);
+        m_citizens.age.resize(n_kept);
+        m_citizens.city.resize(n_kept);
+        m_citizens.city_order.resize(n_kept);
+        m_citizens.n_friends.resize(n_kept);
+        m_citizens.friends.resize(n_kept);
+        m_citizens.update.resize(n_kept);
+    }
+
+    // The update has already been through every citizen, so find the users with most friends who left now,
+    // rather than in each query
+    if (m_stale_cities)
+    {
+        find_most_friends(m_city_totals);
+        m_stale_cities = false;
+    }
+}
+
+Symbol Tables::intern(std::string_view str)
+{
+    const Symbol symbol = m_symbols.intern(str);
+    if (symbol >= m_city_totals.size())
+    {
+        m_city_totals.resize(symbol + 1);
+        m_name_counts.resize(symbol + 1, 0);
+        m_hobby_counts.resize(symbol + 1, 0);
+    }
+    return symbol;
+}
+
+std::vector<CitizenFriend> Tables::intern_friends(const std::vector<Friend> &friends)
+{
+    std::vector<CitizenFriend> interned(friends.size());
+    for (size_t i_friend = 0; i_friend < friends.size(); i_friend++)
+    {
+        interned[i_friend].name = intern(friends[i_friend].name);
+        interned[i_friend].hobbies.reserve(friends[i_friend].hobbies.size());
+        for (const auto& hobby : friends[i_friend].hobbies)
+        {
+            interned[i_friend].hobbies.push_back(intern(hobby));
+        }
+    }
+    return interned;
+}
+
+unsigned int Tables::add_citizen(unsigned int citizen_id, Symbol name, int age, Symbol city, size_t city_order)
+{
+    const unsigned int row = static_cast<unsigned int>(m_citizens.id.size());
+    m_citizens.id.push_back(citizen_id);
+    m_citizens.name.push_back(name);
+    m_citizens.age.push_back(age);
+    m_citizens.city.push_back(city);
+    m_citizens.city_order.push_back(city_order);
+    m_citizens.n_friends.push_back(0);
+    m_citizens.friends.emplace_back();
+    m_citizens.update.push_back(m_update);
+    return row;
+}
+
+void Tables::add_friends(unsigned int row, std::vector<CitizenFriend> &&friends)
+{
+    for (const auto& f : friends)
+    {
+        for (const Symbol hobby : f.hobbies)
+        {
+            m_hobby_counts[hobby]++;
+        }
+    }
+    m_citizens.n_friends[row] = static_cast<unsigned int>(friends.size());
+    m_citizens.friends[row] = std::move(friends);
+}
+
+void Tables::remove_friends(unsigned int row)
+{
+    for (const auto& f : m_citizens.friends[row])
+    {
+        for (const Symbol hobby : f.hobbies)
+        {
+            m_hobby_counts[hobby]--;
+        }
+    }
+    m_citizens.friends[row].clear();
+    m_citizens.n_friends[row] = 0;
+}
+
+void Tables::join_city(unsigned int row)
+{
+    const Symbol city = m_citizens.city[row];
+    if (city == SymbolTable::EMPTY)
+    {
+        return;
+    }
+
+    CityTotals& totals = m_city_totals[city];
+    if (!totals.listed)
+    {
+        const auto position = std::lower_bound(m_cities.begin(), m_cities.end(), city, [this](Symbol a, Symbol b)
+        {
+            return m_symbols.get_string(a) < m_symbols.get_string(b);
+        });
+        m_cities.insert(position, city);
+        totals.listed = true;
+    }
 
-                const auto& citizens_friends = m_citizen_friends.find(i_citizen);
-                if (citizens_friends != m_citizen_friends.end())
+    totals.n_citizens++;
+    totals.age += m_citizens.age[row];
+    totals.n_friends += m_citizens.n_friends[row];
+    m_name_counts[m_citizens.name[row]]++;
+    if (!totals.stale)
+    {
+        consider_most_friends(totals, m_citizens.n_friends[row], m_citizens.name[row], m_citizens.city_order[row]);
+    }
+}
+
+void Tables::leave_city(unsigned int row)
+{
+    const Symbol city = m_citizens.city[row];
+    if (city == SymbolTable::EMPTY)
+    {
+        return;
+    }
+
+    CityTotals& totals = m_city_totals[city];
+    totals.n_citizens--;
+    totals.age -= m_citizens.age[row];
+    totals.n_friends -= m_citizens.n_friends[row];
+    m_name_counts[m_citizens.name[row]]--;
+    if (totals.n_citizens == 0)
+    {
+        totals.max_friends = 0;
+        totals.max_name = SymbolTable::EMPTY;
+        totals.stale = false;
+    }
+    else if ((totals.max_friends > 0) && (totals.max_order == m_citizens.city_order[row]))
+    {
+        // Whoever is next can only be found from the other citizens of the city
+        totals.stale = true;
+        m_stale_cities = true;
+    }
+}
+
+void Tables::find_most_friends(std::vector<CityTotals> &cities) const
+{
+    for (CityTotals& totals : cities)
+    {
+        if (totals.stale)
+        {
+            totals.max_friends = 0;
+            totals.max_name = SymbolTable::EMPTY;
+        }
+    }
+
+    auto search = [this](size_t begin, size_t end, std::vector<CityTotals>& totals_by_city)
+    {
+        for (size_t row = begin; row < end; row++)
+        {
+            CityTotals& totals = totals_by_city[m_citizens.city[row]];
+            if (totals.stale)
+            {
+                consider_most_friends(totals, m_citizens.n_friends[row], m_citizens.name[row], m_citizens.city_order[row]);
+            }
+        }
+    };
+
+    const size_t n_rows = m_citizens.id.size();
+    const size_t n_ranges = std::min(static_cast<size_t>(m_search_threads), n_rows / m_min_search_rows);
+    if (n_ranges < 2)
+    {
+        search(0, n_rows, cities);
+    }
+    else
+    {
+        // Which citizen is the user with most friends doesn't depend on the order the citizens are considered in,
+        // so the users found in each range can be considered in turn
+        std::vector<RowRange> ranges(n_ranges);
+        for (size_t i_range = 0; i_range < n_ranges; i_range++)
+        {
+            ranges[i_range] = {n_rows * i_range / n_ranges, n_rows * (i_range + 1) / n_ranges, cities};
+        }
+        for_each_region(ranges, [&search](RowRange& range) { search(range.begin, range.end, range.cities); });
+        for (const RowRange& range : ranges)
+        {
+            for (size_t city = 0; city < cities.size(); city++)
+            {
+                const CityTotals& found = range.cities[city];
+                if (found.stale)
                 {
-                    auto current_num = citizens_friends->second.size();
-                    if(current_num > max_friends.first)
-                    {
-                        max_friends = {current_num, citizen->second.name};
-                    }
-                    n_friends += current_num;
+                    consider_most_friends(cities[city], found.max_friends, found.max_name, found.max_order);
                 }
             }
+        }
+    }
 
-            city_results.average_age = age / i_city.second.size();
-            city_results.average_number_of_friends = n_friends / i_city.second.size();
-            city_results.user_with_most_friends = max_friends.second;
+    for (CityTotals& totals : cities)
+    {
+        totals.stale = false;
+    }
+}
+
+const std::vector<CityTotals>& Tables::get_city_totals() const
+{
+    // Cities are stale from a record replacing the user with most friends until the end of the update or the next
+    // query, whichever is first. Without updates, there is no end, so the query has to clear them.
+    if (m_stale_cities)
+    {
+        find_most_friends(m_city_totals);
+        m_stale_cities = false;
+    }
+    return m_city_totals;
+}
 
-            results.cities.emplace_back(city_results);
+Results Tables::query_results() const
+{
+    Results results;
+    const std::vector<CityTotals>& city_totals = get_city_totals();
+
+    for (const Symbol city : m_cities)
+    {
+        const CityTotals& totals = city_totals[city];
+        if (totals.n_citizens == 0)
+        {
+            continue;
         }
+
+        CityResults city_results;
+        city_results.city_name = m_symbols.get_string(city);
+        city_results.average_age = totals.age / totals.n_citizens;
+        city_results.average_number_of_friends = totals.n_friends / totals.n_citizens;
+        city_results.user_with_most_friends = m_symbols.get_string(totals.max_name);
+        results.cities.emplace_back(city_results);
     }
 
-    // Find the most common name
-    std::pair<int, std::string> common_name {0, ""};
-    for (auto& i_name : citizen_names)
+    // Find the most common name. Of names as common as each other, the first in alphabetical order is taken.
+    std::pair<unsigned int, Symbol> common_name {0, SymbolTable::EMPTY};
+    for (Symbol name = 0; name < m_name_counts.size(); name++)
     {
-        if (i_name.second > common_name.first)
+        if ((m_name_counts[name] > common_name.first) ||
+            ((m_name_counts[name] == common_name.first) && (common_name.first > 0) &&
+             (m_symbols.get_string(name) < m_symbols.get_string(common_name.second))))
         {
-            common_name.first = i_name.second;
-            common_name.second = i_name.first;
+            common_name = {m_name_counts[name], name};
         }
     }
-    results.most_common_first_name = common_name.second;
+    results.most_common_first_name = m_symbols.get_string(common_name.second);
 
-    // Find the most common hobby
-    std::pair<size_t, std::string> common_hobby{0, ""};
-    for (auto& i_hobby : m_hobby_friends)
+    // Find the most common hobby, likewise
+    std::pair<unsigned int, Symbol> common_hobby {0, SymbolTable::EMPTY};
+    for (Symbol hobby = 0; hobby < m_hobby_counts.size(); hobby++)
     {
-        if (i_hobby.second.size() > common_hobby.first)
+        if ((m_hobby_counts[hobby] > common_hobby.first) ||
+            ((m_hobby_counts[hobby] == common_hobby.first) && (common_hobby.first > 0) &&
+             (m_symbols.get_string(hobby) < m_symbols.get_string(common_hobby.second))))
         {
-            common_hobby.first = i_hobby.second.size();
-            common_hobby.second = i_hobby.first;
+            common_hobby = {m_hobby_counts[hobby], hobby};
         }
     }
-    results.most_common_hobby = common_hobby.second;
+    results.most_common_hobby = m_symbols.get_string(common_hobby.second);
 
     return results;
-}
\ No newline at end of file
+}
+
+PartialResults Tables::partial_results() const
+{
+    PartialResults partial;
+    const std::vector<CityTotals>& city_totals = get_city_totals();
+    for (const Symbol city : m_cities)
+    {
+        const CityTotals& totals = city_totals[city];
+        if (totals.n_citizens > 0)
+        {
+            partial.cities[m_symbols.get_string(city)] = {totals.n_citizens, totals.age, totals.n_friends, totals.max_friends,
+                                                          m_symbols.get_string(totals.max_name), totals.max_order};
+        }
+    }
+
+    for (Symbol symbol = 0; symbol < m_name_counts.size(); symbol++)
+    {
+        if (m_name_counts[symbol] > 0)
+        {
+            partial.names[m_symbols.get_string(symbol)] = m_name_counts[symbol];
+        }
+        if (m_hobby_counts[symbol] > 0)
+        {
+            partial.hobbies[m_symbols.get_string(symbol)] = m_hobby_counts[symbol];
+        }
+    }
+    return partial;
+}
+
+void Tables::set_search_threads(unsigned int n_threads, size_t min_rows)
+{
+    m_search_threads = std::max(n_threads, 1u);
+    m_min_search_rows = std::max(min_rows, static_cast<size_t>(1));
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "tables.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Tables which expose their contents, so tables built in different ways can be compared
+ * 
+ * The symbols are turned back into strings, since the same string may have a different symbol in
+ * tables built in a different order.
+*/
+class TablesForTest : public Tables
+{
+public:
+    std::map<std::string, std::vector<unsigned int>> get_city_citizen_table() const
+    {
+        // The citizens of each city, in the order they joined it in this response
+        std::vector<size_t> rows(m_citizens.id.size());
+        std::iota(rows.begin(), rows.end(), 0);
+        std::sort(rows.begin(), rows.end(), [this](size_t a, size_t b)
+        {
+            return m_citizens.city_order[a] < m_citizens.city_order[b];
+        });
+
+        std::map<std::string, std::vector<unsigned int>> cities;
+        for (const size_t row : rows)
+        {
+            if (m_citizens.city[row] != SymbolTable::EMPTY)
+            {
+                cities[m_symbols.get_string(m_citizens.city[row])].push_back(m_citizens.id[row]);
+            }
+        }
+        return cities;
+    }
+    std::map<unsigned int, Record> get_citizen_table() const
+    {
+        std::map<unsigned int, Record> citizens;
+        for (size_t row = 0; row < m_citizens.id.size(); row++)
+        {
+            Record& record = citizens[m_citizens.id[row]];
+            record.has_id = true;
+            record.id = m_citizens.id[row];
+            record.name = m_symbols.get_string(m_citizens.name[row]);
+            record.age = m_citizens.age[row];
+            record.city = m_symbols.get_string(m_citizens.city[row]);
+        }
+        return citizens;
+    }
+    std::map<unsigned int, std::vector<Friend>> get_citizen_friends_table() const
+    {
+        std::map<unsigned int, std::vector<Friend>> friends;
+        for (size_t row = 0; row < m_citizens.id.size(); row++)
+        {
+            if (m_citizens.friends[row].empty())
+            {
+                continue;
+            }
+            auto& citizen_friends = friends[m_citizens.id[row]];
+            for (const auto& f : m_citizens.friends[row])
+            {
+                citizen_friends.push_back({m_symbols.get_string(f.name), get_strings(f.hobbies)});
+            }
+        }
+        return friends;
+    }
+    std::map<std::string, unsigned int> get_name_counts() const
+    {
+        return get_counts(m_name_counts);
+    }
+    std::map<std::string, unsigned int> get_hobby_counts() const
+    {
+        return get_counts(m_hobby_counts);
+    }
+    bool has_stale_cities() const
+    {
+        return std::any_of(m_city_totals.begin(), m_city_totals.end(), [](const CityTotals& totals) { return totals.stale; });
+    }
+
+    /**
+     * \brief Computes the results from the citizens themselves rather than the totals
+    */
+    Results results_from_citizens() const
+    {
+        // The rows of each city, in the order the citizens joined it in this response
+        std::map<std::string, std::vector<size_t>> cities;
+        std::map<std::string, unsigned int> names;
+        std::map<std::string, unsigned int> hobbies;
+        for (size_t row = 0; row < m_citizens.id.size(); row++)
+        {
+            for (const auto& f : m_citizens.friends[row])
+            {
+                for (const Symbol hobby : f.hobbies)
+                {
+                    hobbies[m_symbols.get_string(hobby)]++;
+                }
+            }
+            if (m_citizens.city[row] != SymbolTable::EMPTY)
+            {
+                cities[m_symbols.get_string(m_citizens.city[row])].push_back(row);
+                names[m_symbols.get_string(m_citizens.name[row])]++;
+            }
+        }
+
+        Results results;
+        for (auto& city : cities)
+        {
+            std::sort(city.second.begin(), city.second.end(), [this](size_t a, size_t b)
+            {
+                return m_citizens.city_order[a] < m_citizens.city_order[b];
+            });
+            size_t age = 0;
+            int n_friends = 0;
+            std::pair<size_t, std::string> max_friends {0, ""};
+            for (const size_t row : city.second)
+            {
+                age += m_citizens.age[row];
+                n_friends += m_citizens.friends[row].size();
+                if (m_citizens.friends[row].size() > max_friends.first)
+                {
+                    max_friends = {m_citizens.friends[row].size(), m_symbols.get_string(m_citizens.name[row])};
+                }
+            }
+            results.cities.push_back({city.first, static_cast<int>(age / city.second.size()),
+                                      static_cast<int>(n_friends / city.second.size()), max_friends.second});
+        }
+
+        // The maps are in alphabetical order, so the first of the most common is kept
+        std::pair<unsigned int, std::string> common_name {0, ""};
+        for (const auto& name : names)
+        {
+            if (name.second > common_name.first)
+            {
+                common_name = {name.second, name.first};
+            }
+        }
+        results.most_common_first_name = common_name.second;
+        std::pair<unsigned int, std::string> common_hobby {0, ""};
+        for (const auto& hobby : hobbies)
+        {
+            if (hobby.second > common_hobby.first)
+            {
+                common_hobby = {hobby.second, hobby.first};
+            }
+        }
+        results.most_common_hobby = common_hobby.second;
+        return results;
+    }
+
+private:
+    std::vector<std::string> get_strings(const std::vector<Symbol>& symbols) const
+    {
+        std::vector<std::string> strings;
+        for (const Symbol symbol : symbols)
+        {
+            strings.push_back(m_symbols.get_string(symbol));
+        }
+        return strings;
+    }
+    std::map<std::string, unsigned int> get_counts(const std::vector<unsigned int>& counts) const
+    {
+        std::map<std::string, unsigned int> strings;
+        for (Symbol symbol = 0; symbol < counts.size(); symbol++)
+        {
+            if (counts[symbol] > 0)
+            {
+                strings[m_symbols.get_string(symbol)] = counts[symbol];
+            }
+        }
+        return strings;
+    }
+};
+
+/**
+ * \brief Expects the tables to hold the same citizens, friends and counts, with the same ids
+*/
+inline void expect_same_tables(const TablesForTest& tables, const TablesForTest& expected)
+{
+    const auto& expected_citizens = expected.get_citizen_table();
+    const auto& citizens = tables.get_citizen_table();
+    ASSERT_EQ(citizens.size(), expected_citizens.size()) << "The tables hold a different number of citizens";
+    for (const auto& expected_citizen : expected_citizens)
+    {
+        const auto citizen = citizens.find(expected_citizen.first);
+        ASSERT_NE(citizen, citizens.end()) << "Citizen " << expected_citizen.first << " is missing";
+        EXPECT_EQ(citizen->second.name, expected_citizen.second.name) << "Name of citizen " << expected_citizen.first;
+        EXPECT_EQ(citizen->second.age, expected_citizen.second.age) << "Age of citizen " << expected_citizen.first;
+        EXPECT_EQ(citizen->second.city, expected_citizen.second.city) << "City of citizen " << expected_citizen.first;
+    }
+
+    const auto& expected_friends = expected.get_citizen_friends_table();
+    const auto& friends = tables.get_citizen_friends_table();
+    ASSERT_EQ(friends.size(), expected_friends.size()) << "The tables hold friends of a different number of citizens";
+    for (const auto& expected_citizen : expected_friends)
+    {
+        const auto citizen = friends.find(expected_citizen.first);
+        ASSERT_NE(citizen, friends.end()) << "Friends of citizen " << expected_citizen.first << " are missing";
+        ASSERT_EQ(citizen->second.size(), expected_citizen.second.size()) << "Number of friends of citizen " << expected_citizen.first;
+        for (size_t i_friend = 0; i_friend < expected_citizen.second.size(); i_friend++)
+        {
+            EXPECT_EQ(citizen->second[i_friend].name, expected_citizen.second[i_friend].name) << "Friend name";
+            EXPECT_EQ(citizen->second[i_friend].hobbies, expected_citizen.second[i_friend].hobbies) << "Friend hobbies";
+        }
+    }
+
+    EXPECT_EQ(tables.get_city_citizen_table(), expected.get_city_citizen_table()) << "The cities should hold the same citizens";
+    EXPECT_EQ(tables.get_name_counts(), expected.get_name_counts()) << "The names should be counted the same";
+    EXPECT_EQ(tables.get_hobby_counts(), expected.get_hobby_counts()) << "The hobbies should be counted the same";
+}
+
+/**
+ * \brief Checks the results from two sets of tables are identical
+*/
+inline void check_same_results(const Results& actual, const Results& expected)
+{
+    ASSERT_EQ(actual.cities.size(), expected.cities.size()) << "Wrong number of cities were stored";
+    for (size_t i_city = 0; i_city < expected.cities.size(); i_city++)
+    {
+        EXPECT_EQ(actual.cities[i_city].city_name, expected.cities[i_city].city_name);
+        EXPECT_EQ(actual.cities[i_city].average_age, expected.cities[i_city].average_age);
+        EXPECT_EQ(actual.cities[i_city].average_number_of_friends, expected.cities[i_city].average_number_of_friends);
+        EXPECT_EQ(actual.cities[i_city].user_with_most_friends, expected.cities[i_city].user_with_most_friends);
+    }
+    EXPECT_EQ(actual.most_common_first_name, expected.most_common_first_name);
+    EXPECT_EQ(actual.most_common_hobby, expected.most_common_hobby);
+}
+
+/**
+ * \brief Generator of random records of a few citizens in a few cities, so that citizens are often replaced,
+ * move city, repeat an id within a response and drop out of the next one
+*/
+class RecordGenerator
+{
+public:
+    Record generate()
+    {
+        static const char* const names[] = {"Adam", "Barry", "Chloe", "Dora", "Ezra"};
+        static const char* const cities[] = {"", "Austin", "Boston", "Chicago", "Denver"};
+        static const char* const hobbies[] = {"Archery", "Bowling", "Chess", "Darts"};
+
+        Record record;
+        record.has_id = (below(10) != 0);
+        record.id = static_cast<int>(below(60)) - 2;
+        record.name = names[below(5)];
+        record.age = static_cast<int>(below(90));
+        record.city = cities[below(5)];
+        record.friends.resize(below(4));
+        for (auto& f : record.friends)
+        {
+            f.name = names[below(5)];
+            for (size_t i_hobby = below(3); i_hobby > 0; i_hobby--)
+            {
+                f.hobbies.push_back(hobbies[below(4)]);
+            }
+        }
+        return record;
+    }
+
+    std::vector<Record> generate(size_t n_records)
+    {
+        std::vector<Record> records;
+        for (size_t i_record = 0; i_record < n_records; i_record++)
+        {
+            records.push_back(generate());
+        }
+        return records;
+    }
+
+    /**
+     * \brief Returns a pseudo-random number below n
+    */
+    size_t below(size_t n)
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<size_t>(m_state >> 33) % n;
+    }
+
+private:
+    uint64_t m_state = 1;
+};
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief Request received by the TestHttpServer
+ */
+struct TestHttpRequest
+{
+    std::string method;                         /// eg. GET or HEAD
+    std::string path;                           /// Path including any query string
+    std::map<std::string, std::string> headers; /// Header names are lower case
+};
+
+/**
+ * \brief Response to be sent by the TestHttpServer
+ */
+struct TestHttpResponse
+{
+    int status = 200;                           /// HTTP status code
+    std::string body;                           /// Body, which is not sent for HEAD requests
+    std::vector<std::string> headers;           /// Extra headers, eg. "Accept-Ranges: bytes"
+    size_t drop_after = std::string::npos;      /// Bytes of the body sent before the connection is dropped, if fewer than all
+};
+
+/**
+ * \brief Minimal HTTP/1.1 server on the loopback interface, standing in for the endpoint in tests
+ *
+ * Each connection is served on its own thread and kept alive until the client closes it. The
+ * handler is called for every request to produce the response, and may be called concurrently.
+ */
+class TestHttpServer
+{
+public:
+    typedef std::function<TestHttpResponse(const TestHttpRequest&)> Handler;
+
+    /**
+     * \brief Constructor. Starts listening on an ephemeral port.
+     *
+     * \param handler: Produces the response to each request
+     */
+    TestHttpServer(Handler handler) : m_handler(handler), m_n_connections(0), m_n_requests(0)
+    {
+        m_listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        bind(m_listen_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        listen(m_listen_socket, 16);
+
+        socklen_t length = sizeof(address);
+        getsockname(m_listen_socket, reinterpret_cast<sockaddr*>(&address), &length);
+        m_port = ntohs(address.sin_port);
+
+        m_accept_thread = std::thread(&TestHttpServer::accept_connections, this);
+    }
+
+    /**
+     * \brief Destructor. Closes all connections and stops the server.
+     */
+    ~TestHttpServer()
+    {
+        shutdown(m_listen_socket, SHUT_RDWR);
+        close(m_listen_socket);
+        m_accept_thread.join();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto connection : m_connection_sockets)
+        {
+            shutdown(connection, SHUT_RDWR);
+        }
+        for (auto& thread : m_connection_threads)
+        {
+            thread.join();
+        }
+        for (auto connection : m_connection_sockets)
+        {
+            close(connection);
+        }
+    }
+
+    /**
+     * \brief Returns the URL of a path on this server
+     */
+    std::string url(const std::string& path = "/") const
+    {
+        return "http://127.0.0.1:" + std::to_string(m_port) + path;
+    }
+
+    /**
+     * \brief Returns the number of connections accepted so far
+     */
+    int get_num_connections() const { return m_n_connections; }
+
+    /**
+     * \brief Returns the number of requests served so far
+     */
+    int get_num_requests() const { return m_n_requests; }
+
+private:
+    void accept_connections()
+    {
+        for (;;)
+        {
+            int connection = accept(m_listen_socket, nullptr, nullptr);
+            if (connection < 0)
+            {
+                return;
+            }
+            m_n_connections++;
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_connection_sockets.push_back(connection);
+            m_connection_threads.emplace_back(&TestHttpServer::serve_connection, this, connection);
+        }
+    }
+
+    void serve_connection(int connection)
+    {
+        std::string received;
+        char buffer[4096];
+        for (;;)
+        {
+            // Read until the end of the request headers
+            size_t header_end = received.find("\r\n\r\n");
+            while (header_end == std::string::npos)
+            {
+                ssize_t n_read = recv(connection, buffer, sizeof(buffer), 0);
+                if (n_read <= 0)
+                {
+                    return;
+                }
+                received.append(buffer, n_read);
+                header_end = received.find("\r\n\r\n");
+            }
+
+            TestHttpRequest request = parse_request(received.substr(0, header_end));
+            received.erase(0, header_end + 4);
+            m_n_requests++;
+
+            TestHttpResponse response = m_handler(request);
+            std::string message = "HTTP/1.1 " + std::to_string(response.status) + " Status\r\n";
+            message += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+            for (const auto& header : response.headers)
+            {
+                message += header + "\r\n";
+            }
+            message += "\r\n";
+            const bool drop = (request.method != "HEAD") && (response.drop_after < response.body.size());
+            if (request.method != "HEAD")
+            {
+                message.append(response.body, 0, response.drop_after);
+            }
+
+            size_t n_sent = 0;
+            while (n_sent < message.size())
+            {
+                ssize_t n_written = send(connection, message.data() + n_sent, message.size() - n_sent, MSG_NOSIGNAL);
+                if (n_written <= 0)
+                {
+                    return;
+                }
+                n_sent += n_written;
+            }
+            if (drop)
+            {
+                // The client is left waiting for the rest of the body, until it sees the connection close
+                shutdown(connection, SHUT_RDWR);
+                return;
+            }
+        }
+    }
+
+    static TestHttpRequest parse_request(const std::string& text)
+    {
+        TestHttpRequest request;
+        size_t line_end = text.find("\r\n");
+        const std::string request_line = text.substr(0, line_end);
+        const size_t method_end = request_line.find(' ');
+        request.method = request_line.substr(0, method_end);
+        request.path = request_line.substr(method_end + 1, request_line.rfind(' ') - method_end - 1);
+
+        while (line_end != std::string::npos)
+        {
+            const size_t line_start = line_end + 2;
+            line_end = text.find("\r\n", line_start);
+            const std::string line = text.substr(line_start, line_end == std::string::npos ? std::string::npos : line_end - line_start);
+            const size_t colon = line.find(':');
+            if (colon != std::string::npos)
+            {
+                std::string name = line.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c){ return std::tolower(c); });
+                const size_t value_start = line.find_first_not_of(' ', colon + 1);
+                request.headers[name] = (value_start == std::string::npos) ? "" : line.substr(value_start);
+            }
+        }
+        return request;
+    }
+
+    Handler m_handler;                              /// Produces the response to each request
+    int m_listen_socket;                            /// Socket accepting connections
+    int m_port;                                     /// Port the server is listening on
+    std::thread m_accept_thread;                    /// Thread accepting connections
+    std::mutex m_mutex;                             /// Protects the connection lists
+    std::vector<int> m_connection_sockets;          /// Sockets of all connections accepted
+    std::vector<std::thread> m_connection_threads;  /// Threads serving each connection
+    std::atomic<int> m_n_connections;               /// Number of connections accepted
+    std::atomic<int> m_n_requests;                  /// Number of requests served
+};
@@ -0,0 +1,665 @@
+/**
+ * \brief This file contains tests for the Client class.
+ * 
+ * The endpoint is replaced by a minimal HTTP server on the loopback interface, so that the
+ * behaviour of the server can be controlled by each test.
+*/
+
+#include "client.hpp"
+#include "chunk_queue.hpp"
+#include "response_cache.hpp"
+
+#include "http_server.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+/**
+ * \brief Builds a body large enough to be split into several ranges
+*/
+std::string make_body(size_t size)
+{
+    std::string body;
+    body.reserve(size);
+    for (size_t i = 0; body.size() < size; i++)
+    {
+        body += R"({"id":)" + std::to_string(i) + R"(,"name":"Elijah","city":"Palm Springs","age":43,"friends":[]})" + "\n";
+    }
+    body.resize(size);
+    return body;
+}
+
+/**
+ * \brief Serves the body, honouring Range headers if ranges are enabled
+*/
+TestHttpResponse serve_body(const TestHttpRequest& request, const std::string& body, bool ranges, std::atomic<int>& n_range_requests)
+{
+    TestHttpResponse response;
+    response.body = body;
+    if (!ranges)
+    {
+        return response;
+    }
+
+    response.headers.push_back("Accept-Ranges: bytes");
+    auto range = request.headers.find("range");
+    if (range != request.headers.end())
+    {
+        // Expecting "bytes=first-last"
+        const size_t equals = range->second.find('=');
+        const size_t dash = range->second.find('-');
+        const size_t first = std::stoul(range->second.substr(equals + 1, dash - equals - 1));
+        const size_t last = std::stoul(range->second.substr(dash + 1));
+        response.status = 206;
+        response.body = body.substr(first, last - first + 1);
+        response.headers.push_back("Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" + std::to_string(body.size()));
+        n_range_requests++;
+    }
+    return response;
+}
+
+const std::string large_body = make_body(8 * Client::MIN_RANGE_SEGMENT_SIZE + 123);
+
+/**
+ * \brief Body of the gzip_body below, before compression
+*/
+std::string make_plain_body()
+{
+    std::string body;
+    for (int i_record = 0; i_record < 500; i_record++)
+    {
+        body += R"({"id":1,"name":"Elijah","city":"Palm Springs","age":43,"friends":[]})" "\n";
+    }
+    return body;
+}
+
+/**
+ * \brief make_plain_body() compressed with gzip
+*/
+const unsigned char gzip_body[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0xcc, 0x31, 0x0a, 0xc2, 0x40,
+    0x14, 0x45, 0xd1, 0xde, 0x55, 0xc8, 0xaf, 0xa7, 0x11, 0xad, 0xd2, 0xdb, 0x0b, 0x96, 0x62, 0x31,
+    0x98, 0x18, 0x47, 0x92, 0x20, 0x89, 0x8d, 0x04, 0xf7, 0xee, 0xec, 0xc2, 0xe6, 0x94, 0xef, 0xf2,
+    0x38, 0x6b, 0x94, 0x36, 0x9a, 0x5d, 0x8a, 0x29, 0x8f, 0x5d, 0x34, 0x71, 0x1c, 0xca, 0x33, 0x3f,
+    0x22, 0xc5, 0xad, 0xbc, 0x3f, 0x75, 0x9f, 0xf2, 0x30, 0x6e, 0xcf, 0xaf, 0xb9, 0x4c, 0xfd, 0x52,
+    0x6b, 0xee, 0xeb, 0xe9, 0xb0, 0x4f, 0x71, 0x9f, 0x4b, 0x37, 0xb5, 0x4b, 0x34, 0x97, 0xeb, 0x77,
+    0xb3, 0x42, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40,
+    0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10,
+    0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04,
+    0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81,
+    0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20,
+    0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08,
+    0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x81, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02,
+    0x81, 0x40, 0x20, 0x10, 0x08, 0xe4, 0x1f, 0xc8, 0x0f, 0x1c, 0xc9, 0xca, 0xce, 0xc4, 0x86, 0x00,
+    0x00,
+};
+
+/**
+ * \brief Serves gzip_body if the request accepts gzip, otherwise the plain body
+*/
+TestHttpResponse serve_gzip(const TestHttpRequest& request)
+{
+    TestHttpResponse response;
+    auto accept_encoding = request.headers.find("accept-encoding");
+    if ((accept_encoding != request.headers.end()) && (accept_encoding->second.find("gzip") != std::string::npos))
+    {
+        response.body.assign(reinterpret_cast<const char*>(gzip_body), sizeof(gzip_body));
+        response.headers.push_back("Content-Encoding: gzip");
+    }
+    else
+    {
+        response.body = make_plain_body();
+    }
+    return response;
+}
+} // namespace
+
+TEST(TestClient, QueryEndpoint)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = large_body;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The response was not acquired in full";
+}
+
+TEST(TestClient, RepeatedQueriesReuseConnection)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = large_body;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    for (int i_query = 0; i_query < 3; i_query++)
+    {
+        CUT.query_endpoint();
+        ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+        ASSERT_EQ(CUT.get_response(), large_body) << "The response was not acquired in full";
+    }
+
+    ASSERT_EQ(server.get_num_requests(), 3) << "Each query should make one request";
+    ASSERT_EQ(server.get_num_connections(), 1) << "The connection was not reused between queries";
+}
+
+TEST(TestClient, QueryEndpointIntoQueue)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = large_body;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    ChunkQueue queue(4);
+    std::string received;
+
+    // Consume the queue on another thread, as the pipeline does
+    std::thread consumer([&]()
+    {
+        std::string chunk;
+        while (queue.pop(chunk))
+        {
+            received += chunk;
+        }
+    });
+    CUT.query_endpoint(queue);
+    consumer.join();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(received, large_body) << "The chunks pushed onto the queue do not make up the response";
+}
+
+TEST(TestClient, RangedQuery)
+{
+    std::atomic<int> n_range_requests(0);
+    std::atomic<int> n_compressed_requests(0);
+    TestHttpServer server([&](const TestHttpRequest& request)
+    {
+        n_compressed_requests += request.headers.count("accept-encoding");
+        return serve_body(request, large_body, true, n_range_requests);
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint_ranged(4);
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Ranged query of the test server failed";
+    ASSERT_EQ(n_range_requests, 4) << "The response was not requested as the expected number of ranges";
+    ASSERT_EQ(n_compressed_requests, 0) << "Ranges of a compressed response cannot be decoded separately";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The ranges were not joined into the original response";
+}
+
+TEST(TestClient, RangedQueryWithoutAcceptRanges)
+{
+    std::atomic<int> n_range_requests(0);
+    TestHttpServer server([&](const TestHttpRequest& request)
+    {
+        return serve_body(request, large_body, false, n_range_requests);
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint_ranged(4);
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(n_range_requests, 0) << "Ranges should not be requested if the server doesn't advertise them";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The fallback to a single stream did not acquire the response";
+}
+
+TEST(TestClient, RangedQueryIgnoredByServer)
+{
+    // Advertises ranges, but always responds with the whole body
+    TestHttpServer server([&](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = large_body;
+        response.headers.push_back("Accept-Ranges: bytes");
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint_ranged(4);
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The fallback to a single stream did not acquire the response";
+}
+
+TEST(TestClient, SmallResponseIsNotSplit)
+{
+    const std::string small_body = make_body(Client::MIN_RANGE_SEGMENT_SIZE);
+    std::atomic<int> n_range_requests(0);
+    TestHttpServer server([&](const TestHttpRequest& request)
+    {
+        return serve_body(request, small_body, true, n_range_requests);
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint_ranged(4);
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(n_range_requests, 0) << "A response smaller than two segments should be acquired as one stream";
+    ASSERT_EQ(CUT.get_response(), small_body) << "The response was not acquired in full";
+}
+
+TEST(TestClient, CompressedResponseIsDecoded)
+{
+    TestHttpServer server(serve_gzip);
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(CUT.get_response(), make_plain_body()) << "The compressed response was not decoded";
+    ASSERT_EQ(CUT.get_transfer_stats().bytes_on_wire, sizeof(gzip_body)) << "Bytes on the wire should be the compressed size";
+    ASSERT_EQ(CUT.get_transfer_stats().bytes_decoded, make_plain_body().size()) << "Bytes decoded should be the plain size";
+}
+
+TEST(TestClient, CompressedResponseIntoQueue)
+{
+    TestHttpServer server(serve_gzip);
+
+    Client CUT(server.url().c_str());
+    ChunkQueue queue(4);
+    std::string received;
+    std::thread consumer([&queue, &received]
+    {
+        std::string chunk;
+        while (queue.pop(chunk))
+        {
+            received += chunk;
+        }
+    });
+    CUT.query_endpoint(queue);
+    consumer.join();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(received, make_plain_body()) << "The compressed response was not decoded into the queue";
+    ASSERT_EQ(CUT.get_transfer_stats().bytes_decoded, received.size()) << "Bytes decoded should be the plain size";
+}
+
+TEST(TestClient, CompressionDisabled)
+{
+    TestHttpServer server(serve_gzip);
+
+    Client CUT(server.url().c_str(), false);
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_EQ(CUT.get_response(), make_plain_body()) << "The plain response was not acquired in full";
+    ASSERT_EQ(CUT.get_transfer_stats().bytes_on_wire, make_plain_body().size()) << "Compression was offered when disabled";
+}
+
+TEST(TestClient, ErrorStatusAbortsTransfer)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.status = 500;
+        response.body = "500 - Something bad happened!" + std::string(large_body.size(), ' ');
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::HTTP_STATUS) << "The error status was not detected";
+    ASSERT_TRUE(CUT.get_response().empty()) << "No part of an error response should be kept";
+    ASSERT_LT(CUT.get_transfer_stats().bytes_on_wire, large_body.size()) << "The transfer was not aborted early";
+}
+
+TEST(TestClient, ErrorStatusWithoutBody)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.status = 404;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::HTTP_STATUS) << "The error status was not detected";
+}
+
+TEST(TestClient, NonJsonBodyAbortsTransfer)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = "\r\n<html>\r\n<head><title>400 Bad Request</title></head>" + std::string(large_body.size(), ' ');
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    ChunkQueue queue(4);
+    int n_chunks = 0;
+    std::thread consumer([&queue, &n_chunks]
+    {
+        std::string chunk;
+        while (queue.pop(chunk))
+        {
+            n_chunks++;
+        }
+    });
+    CUT.query_endpoint(queue);
+    consumer.join();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NON_JSON_BODY) << "The HTML body was not detected";
+    ASSERT_EQ(n_chunks, 0) << "No part of a non-json response should be passed on";
+    ASSERT_LT(CUT.get_transfer_stats().bytes_on_wire, large_body.size()) << "The transfer was not aborted early";
+}
+
+TEST(TestClient, NonJsonBodyIsNotRequestedAgainAfterRanges)
+{
+    std::atomic<int> n_range_requests(0);
+    const std::string html = "<html>" + large_body;
+    TestHttpServer server([&](const TestHttpRequest& request)
+    {
+        return serve_body(request, html, true, n_range_requests);
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.query_endpoint_ranged(4);
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NON_JSON_BODY) << "The HTML body was not detected";
+    ASSERT_EQ(server.get_num_requests(), 1 + n_range_requests) << "A rejected body should not be requested again";
+}
+
+namespace
+{
+/**
+ * \brief Retry policy with short waits, for tests
+*/
+Client::RetryPolicy fast_retries(int max_attempts)
+{
+    Client::RetryPolicy policy;
+    policy.max_attempts = max_attempts;
+    policy.initial_backoff = std::chrono::milliseconds(1);
+    policy.max_backoff = std::chrono::milliseconds(5);
+    return policy;
+}
+} // namespace
+
+TEST(TestClient, RetriesIntermittentFailure)
+{
+    std::atomic<int> n_requests(0);
+    TestHttpServer server([&n_requests](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        if (++n_requests <= 2)
+        {
+            response.status = 500;
+            response.body = "500 - Something bad happened!";
+        }
+        else
+        {
+            response.body = large_body;
+        }
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(fast_retries(3));
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "The query was not retried until it succeeded";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The response of the successful attempt was not kept";
+    ASSERT_EQ(CUT.get_transfer_stats().n_requests, 3) << "Expecting two failed attempts and one successful attempt";
+}
+
+TEST(TestClient, RetriesGiveUp)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.status = 503;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(fast_retries(3));
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::HTTP_STATUS) << "The last error was not returned";
+    ASSERT_EQ(server.get_num_requests(), 3) << "The query should be attempted max_attempts times";
+}
+
+TEST(TestClient, ClientErrorIsNotRetried)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.status = 400;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(fast_retries(3));
+    CUT.query_endpoint();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::HTTP_STATUS) << "The error status was not detected";
+    ASSERT_EQ(server.get_num_requests(), 1) << "A client error would only recur, so should not be retried";
+}
+
+TEST(TestClient, RetriesIntoQueue)
+{
+    std::atomic<int> n_requests(0);
+    TestHttpServer server([&n_requests](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = (++n_requests == 1) ? "500 - Something bad happened!" : large_body;
+        return response;
+    });
+
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(fast_retries(2));
+    ChunkQueue queue(4);
+    std::string received;
+    std::thread consumer([&queue, &received]
+    {
+        std::string chunk;
+        while (queue.pop(chunk))
+        {
+            received += chunk;
+        }
+    });
+    CUT.query_endpoint(queue);
+    consumer.join();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "The query was not retried until it succeeded";
+    ASSERT_EQ(received, large_body) << "Only the successful attempt should reach the queue";
+}
+
+TEST(TestClient, HedgedRequestOvertakesStalledRequest)
+{
+    // The first request stalls until the query has returned, or for long enough to fail the test if the query waits for it
+    std::atomic<int> n_requests(0);
+    std::mutex mutex;
+    std::condition_variable released;
+    bool query_returned = false;
+    std::atomic<bool> stalled_answered(false);
+    TestHttpServer server([&](const TestHttpRequest&)
+    {
+        if (++n_requests == 1)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            released.wait_for(lock, std::chrono::seconds(10), [&query_returned] { return query_returned; });
+            stalled_answered = true;
+        }
+        TestHttpResponse response;
+        response.body = large_body;
+        return response;
+    });
+
+    Client::RetryPolicy policy;
+    policy.hedge_after = std::chrono::milliseconds(50);
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(policy);
+    CUT.query_endpoint();
+    const bool answered_before_return = stalled_answered;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        query_returned = true;
+    }
+    released.notify_all();
+
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "The hedged query failed";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The response of the hedged request was not kept";
+    ASSERT_EQ(CUT.get_transfer_stats().n_requests, 2) << "A second request should have been sent";
+    ASSERT_FALSE(answered_before_return) << "The query waited for the stalled request";
+}
+
+TEST(TestClient, HedgeNotSentForFastResponse)
+{
+    TestHttpServer server([](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = large_body;
+        return response;
+    });
+
+    Client::RetryPolicy policy;
+    policy.hedge_after = std::chrono::milliseconds(2000);
+    Client CUT(server.url().c_str());
+    CUT.set_retry_policy(policy);
+    for (int i_query = 0; i_query < 2; i_query++)
+    {
+        CUT.query_endpoint();
+        ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "The query failed";
+        ASSERT_EQ(CUT.get_response(), large_body) << "The response was not acquired in full";
+        ASSERT_EQ(CUT.get_transfer_stats().n_requests, 1) << "No second request should be sent for a fast response";
+    }
+    ASSERT_EQ(server.get_num_connections(), 1) << "The connection was not reused between hedged queries";
+}
+
+namespace
+{
+/**
+ * \brief Temporary directory, removed with its contents when it goes out of scope
+*/
+class TemporaryDirectory
+{
+public:
+    TemporaryDirectory()
+    {
+        char path[] = "/tmp/client_testXXXXXX";
+        m_path = mkdtemp(path);
+    }
+    ~TemporaryDirectory() { std::filesystem::remove_all(m_path); }
+
+    const char* path() const { return m_path.c_str(); }
+
+private:
+    std::string m_path;
+};
+
+/**
+ * \brief Serves the body with an ETag, or 304 if the request already has it
+*/
+TestHttpResponse serve_etag(const TestHttpRequest& request, const std::string& body, const std::string& etag)
+{
+    TestHttpResponse response;
+    auto if_none_match = request.headers.find("if-none-match");
+    if ((if_none_match != request.headers.end()) && (if_none_match->second == etag))
+    {
+        response.status = 304;
+    }
+    else
+    {
+        response.body = body;
+    }
+    response.headers.push_back("ETag: " + etag);
+    return response;
+}
+} // namespace
+
+TEST(TestClient, UnchangedResponseIsTakenFromCache)
+{
+    std::atomic<int> n_not_modified(0);
+    TestHttpServer server([&n_not_modified](const TestHttpRequest& request)
+    {
+        TestHttpResponse response = serve_etag(request, large_body, "\"v1\"");
+        n_not_modified += (response.status == 304);
+        return response;
+    });
+
+    TemporaryDirectory directory;
+    ResponseCache cache(directory.path());
+    Client CUT(server.url().c_str());
+    CUT.set_cache(&cache);
+
+    CUT.query_endpoint();
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_FALSE(CUT.is_not_modified()) << "Nothing was cached for the first query";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The response was not acquired in full";
+
+    CUT.query_endpoint();
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "A 304 response should not be an error";
+    ASSERT_TRUE(CUT.is_not_modified()) << "The second query was not conditional on the cached ETag";
+    ASSERT_EQ(n_not_modified, 1) << "The server should have responded 304 to the second query";
+    ASSERT_EQ(CUT.get_response(), large_body) << "The cached body was not returned";
+    ASSERT_EQ(CUT.get_transfer_stats().bytes_on_wire, 0u) << "The body should not be downloaded again";
+}
+
+TEST(TestClient, ChangedResponseReplacesCache)
+{
+    std::atomic<int> version(1);
+    TestHttpServer server([&version](const TestHttpRequest& request)
+    {
+        return serve_etag(request, make_body(1000 * version), "\"v" + std::to_string(version) + "\"");
+    });
+
+    TemporaryDirectory directory;
+    ResponseCache cache(directory.path());
+    Client CUT(server.url().c_str());
+    CUT.set_cache(&cache);
+
+    CUT.query_endpoint();
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+
+    Results results;
+    results.most_common_first_name = "Elijah";
+    results.most_common_hobby = "Golf";
+    results.cities.push_back({"Palm Springs", 43, 1, "Elijah"});
+    ASSERT_TRUE(cache.store_results(server.url(), results)) << "The results were not cached with the response";
+
+    Results cached_results;
+    ASSERT_TRUE(cache.load_results(server.url(), cached_results)) << "The cached results were not found";
+    ASSERT_EQ(cached_results.cities.size(), 1u);
+    EXPECT_EQ(cached_results.cities[0].city_name, "Palm Springs");
+    EXPECT_EQ(cached_results.cities[0].average_age, 43);
+    EXPECT_EQ(cached_results.cities[0].average_number_of_friends, 1);
+    EXPECT_EQ(cached_results.cities[0].user_with_most_friends, "Elijah");
+    EXPECT_EQ(cached_results.most_common_first_name, "Elijah");
+    EXPECT_EQ(cached_results.most_common_hobby, "Golf");
+
+    version = 2;
+    CUT.query_endpoint();
+    ASSERT_EQ(CUT.get_error(), Client::ErrorType::NONE) << "Query of the test server failed";
+    ASSERT_FALSE(CUT.is_not_modified()) << "The changed response was taken from the cache";
+    ASSERT_EQ(CUT.get_response(), make_body(2000)) << "The changed response was not acquired in full";
+    ASSERT_FALSE(cache.load_results(server.url(), cached_results)) << "Results of the old response were kept";
+
+    std::string cached_body;
+    ASSERT_TRUE(cache.load_body(server.url(), cached_body));
+    ASSERT_EQ(cached_body, make_body(2000)) << "The changed response was not cached";
+}
@@ -16,6 +16,7 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -61,6 +62,20 @@ const std::string Barry_compact(R"({"id":600003,"name":"Barry","city":"Washingto
                                         R"("friends":[{"name":"Morris","hobbies":["Movie Watching","Golf"]},)"
                                         R"({"name":"Robin","hobbies":["Shopping","Calligraphy","Martial Arts"]}]})");
 
+const test_records Escaped_record = {600004, "Quote \" and \\", "Brace } City", 30, {
+    { "[Bracket", {"{Reading}", "\\\""} }
+}};
+const std::string Escaped_compact(R"({"id":600004,"name":"Quote \" and \\","city":"Brace } City","age":30,)"
+                                        R"("friends":[{"name":"[Bracket","hobbies":["{Reading}","\\\""]}]})");
+
+// Runs of backslashes and braces in strings longer than the 64 bytes scanned at a time
+const test_records Long_escaped_record = {600005, std::string(35, '\\') + "\"" + std::string(60, '}'), "Brace } City", 30, {
+    { std::string(70, '{'), {std::string(64, '\\')} }
+}};
+const std::string Long_escaped_compact(R"({"id":600005,"name":")" + std::string(70, '\\') + R"(\")" + std::string(60, '}') +
+                                        R"(","city":"Brace } City","age":30,"friends":[{"name":")" + std::string(70, '{') +
+                                        R"(","hobbies":[")" + std::string(128, '\\') + R"("]}]})");
+
 const std::string Elijah_pretty_print_array(std::string("[\n") + Elijah_pretty_print + std::string("\n]"));
 const std::string Elijah_compact_array(std::string("[") + Elijah_compact + std::string("]"));
 const std::string Elijah_white_space_start(std::string("    ") + Elijah_compact);
@@ -81,6 +96,53 @@ const std::string Elijah_Barry_compact_array(std::string("[") + Elijah_compact +
 
 const std::vector<test_records> case_one_record = {Elijah_record};
 const std::vector<test_records> case_two_records = {Elijah_record, Barry_record};
+const std::vector<test_records> case_escaped_records = {Escaped_record, Elijah_record};
+const std::vector<test_records> case_long_escaped_records = {Long_escaped_record, Elijah_record};
+
+/**
+ * \brief Checks that a parsed record matches the expected record
+*/
+void check_record(const rapidjson::Value* record, const test_records& expected_record)
+{
+    ASSERT_TRUE(record->HasMember("id")) << "\"id\" field not present when parsed";
+    ASSERT_TRUE(record->HasMember("name")) << "\"name\" field not present when parsed";
+    ASSERT_TRUE(record->HasMember("city")) << "\"city\" field not present when parsed";
+    ASSERT_TRUE(record->HasMember("age")) << "\"age\" field not present when parsed";
+    ASSERT_TRUE(record->HasMember("friends")) << "\"friends\" field not present when parsed";
+
+    ASSERT_TRUE((*record)["id"].IsInt()) << "\"id\" field is not type int";
+    ASSERT_TRUE((*record)["name"].IsString()) << "\"name\" field is not type string";
+    ASSERT_TRUE((*record)["city"].IsString()) << "\"city\" field is not type string";
+    ASSERT_TRUE((*record)["age"].IsInt()) << "\"age\" field is not type int";
+    ASSERT_TRUE((*record)["friends"].IsArray()) << "\"friends\" field is not type Array";
+
+    EXPECT_EQ((*record)["id"].GetInt(), expected_record.id) << "\"id\" field did not parse the correct value";
+    EXPECT_EQ((*record)["name"].GetString(), expected_record.name) << "\"name\" field did not parse the correct value";
+    EXPECT_EQ((*record)["city"].GetString(), expected_record.city) << "\"city\" field did not parse the correct value";
+    EXPECT_EQ((*record)["age"].GetInt(), expected_record.age) << "\"age\" field did not parse the correct value";
+
+    const auto& friends_array = (*record)["friends"].GetArray();
+    ASSERT_EQ(friends_array.Size(), expected_record.friends.size()) << "\"friends\" array is the wrong size";
+    
+    for (size_t i_friend = 0; i_friend < expected_record.friends.size(); i_friend++)
+    {
+        const auto& hfriend = friends_array[i_friend];
+        ASSERT_TRUE(hfriend.HasMember("name")) << "\"name\" field not present in the friends array when parsed";
+        ASSERT_TRUE(hfriend.HasMember("hobbies")) << "\"hobbies\" field not present in the friends array when parsed";
+
+        ASSERT_TRUE(hfriend["name"].IsString()) << "\"name\" field in the friends array is not type string";
+        ASSERT_TRUE(hfriend["hobbies"].IsArray()) << "\"hobbies\" field in the friends array is not type Array";
+
+        EXPECT_EQ(hfriend["name"].GetString(), expected_record.friends[i_friend].name) << "\"name\" from fireds array was not parsed correctly";
+
+        const auto& hobbies_array = hfriend["hobbies"].GetArray();
+        ASSERT_EQ(hobbies_array.Size(), expected_record.friends[i_friend].hobbies.size()) << "\"hobbies\" array is the wrong size";
+        for(size_t i_hobby = 0; i_hobby < expected_record.friends[i_friend].hobbies.size(); i_hobby++)
+        {
+            EXPECT_EQ(hobbies_array[i_hobby].GetString(), expected_record.friends[i_friend].hobbies[i_hobby]) << "\"hobbies\" field did not parse the correct value";
+        }
+    }
+}
 } // namespace
 
 
@@ -102,49 +164,118 @@ TEST_P(TestDataObjectsInput, ValidJsonInput)
         ASSERT_NE(record, nullptr) << "The first object was not processed";
         ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if successful";
 
-        ASSERT_TRUE(record->HasMember("id")) << "\"id\" field not present when parsed";
-        ASSERT_TRUE(record->HasMember("name")) << "\"name\" field not present when parsed";
-        ASSERT_TRUE(record->HasMember("city")) << "\"city\" field not present when parsed";
-        ASSERT_TRUE(record->HasMember("age")) << "\"age\" field not present when parsed";
-        ASSERT_TRUE(record->HasMember("friends")) << "\"friends\" field not present when parsed";
-
-        ASSERT_TRUE((*record)["id"].IsInt()) << "\"id\" field is not type int";
-        ASSERT_TRUE((*record)["name"].IsString()) << "\"name\" field is not type string";
-        ASSERT_TRUE((*record)["city"].IsString()) << "\"city\" field is not type string";
-        ASSERT_TRUE((*record)["age"].IsInt()) << "\"age\" field is not type int";
-        ASSERT_TRUE((*record)["friends"].IsArray()) << "\"friends\" field is not type Array";
-
-        EXPECT_EQ((*record)["id"].GetInt(), expected_record.id) << "\"id\" field did not parse the correct value";
-        EXPECT_EQ((*record)["name"].GetString(), expected_record.name) << "\"name\" field did not parse the correct value";
-        EXPECT_EQ((*record)["city"].GetString(), expected_record.city) << "\"city\" field did not parse the correct value";
-        EXPECT_EQ((*record)["age"].GetInt(), expected_record.age) << "\"age\" field did not parse the correct value";
-
-        const auto& friends_array = (*record)["friends"].GetArray();
-        ASSERT_EQ(friends_array.Size(), expected_record.friends.size()) << "\"friends\" array is the wrong size";
-        
-        for (size_t i_friend = 0; i_friend < expected_record.friends.size(); i_friend++)
+        check_record(record, expected_record);
+        if (HasFatalFailure())
         {
-            const auto& hfriend = friends_array[i_friend];
-            ASSERT_TRUE(hfriend.HasMember("name")) << "\"name\" field not present in the friends array when parsed";
-            ASSERT_TRUE(hfriend.HasMember("hobbies")) << "\"hobbies\" field not present in the friends array when parsed";
+            return;
+        }
+    }
+    auto next_record = CUT.get_next_object();
+    ASSERT_EQ(next_record, nullptr) << "get_next_object should result in nullptr when there are no more objects";
+    ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if come to the end of the buffer without error";
+}
 
-            ASSERT_TRUE(hfriend["name"].IsString()) << "\"name\" field in the friends array is not type string";
-            ASSERT_TRUE(hfriend["hobbies"].IsArray()) << "\"hobbies\" field in the friends array is not type Array";
+TEST_P(TestDataObjectsInput, ValidJsonInputFromView)
+{
+    auto param = GetParam();
+    const std::string test_input = param.GetParam();
+    auto expected_output = param.GetExpected();
 
-            EXPECT_EQ(hfriend["name"].GetString(), expected_record.friends[i_friend].name) << "\"name\" from fireds array was not parsed correctly";
+    // A view, eg. of a mapped file, has no null terminator after the last byte
+    const std::vector<char> view(test_input.begin(), test_input.end());
+    DataObjects CUT(view.data(), view.size());
 
-            const auto& hobbies_array = hfriend["hobbies"].GetArray();
-            ASSERT_EQ(hobbies_array.Size(), expected_record.friends[i_friend].hobbies.size()) << "\"hobbies\" array is the wrong size";
-            for(size_t i_hobby = 0; i_hobby < expected_record.friends[i_friend].hobbies.size(); i_hobby++)
-            {
-                EXPECT_EQ(hobbies_array[i_hobby].GetString(), expected_record.friends[i_friend].hobbies[i_hobby]) << "\"hobbies\" field did not parse the correct value";
-            }
+    for(auto expected_record : expected_output)
+    {
+        auto record = CUT.get_next_object();
+        ASSERT_NE(record, nullptr) << "The first object was not processed";
+        ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if successful";
+
+        check_record(record, expected_record);
+        if (HasFatalFailure())
+        {
+            return;
         }
     }
     auto next_record = CUT.get_next_object();
     ASSERT_EQ(next_record, nullptr) << "get_next_object should result in nullptr when there are no more objects";
     ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if come to the end of the buffer without error";
 }
+
+TEST_P(TestDataObjectsInput, ValidJsonInputWithSmallArena)
+{
+    auto param = GetParam();
+    auto test_input = param.GetParam();
+    auto expected_output = param.GetExpected();
+
+    // Blocks which don't fit in the arena overflow into chunks freed before the next block
+    DataObjects CUT(std::move(test_input), 256);
+
+    for(auto expected_record : expected_output)
+    {
+        auto record = CUT.get_next_object();
+        ASSERT_NE(record, nullptr) << "The first object was not processed";
+        ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if successful";
+
+        check_record(record, expected_record);
+        if (HasFatalFailure())
+        {
+            return;
+        }
+    }
+    auto next_record = CUT.get_next_object();
+    ASSERT_EQ(next_record, nullptr) << "get_next_object should result in nullptr when there are no more objects";
+    ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if come to the end of the buffer without error";
+}
+
+TEST_P(TestDataObjectsInput, ValidJsonInputInChunks)
+{
+    auto param = GetParam();
+    const std::string test_input = param.GetParam();
+    auto expected_output = param.GetExpected();
+
+    // Records should come out the same however the buffer is split into chunks
+    for (size_t chunk_size : {1, 7, 64})
+    {
+        DataObjects CUT;
+        size_t n_records = 0;
+
+        auto check_available_records = [&]()
+        {
+            auto record = CUT.get_next_object();
+            while (record != nullptr)
+            {
+                ASSERT_LT(n_records, expected_output.size()) << "More objects were processed than expected";
+                check_record(record, expected_output[n_records++]);
+                if (HasFatalFailure())
+                {
+                    return;
+                }
+                record = CUT.get_next_object();
+            }
+            ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The error should be none if successful";
+        };
+
+        for (size_t offset = 0; offset < test_input.size(); offset += chunk_size)
+        {
+            CUT.feed(test_input.data() + offset, std::min(chunk_size, test_input.size() - offset));
+            check_available_records();
+            if (HasFatalFailure())
+            {
+                return;
+            }
+        }
+        CUT.finish();
+        check_available_records();
+        if (HasFatalFailure())
+        {
+            return;
+        }
+
+        ASSERT_EQ(n_records, expected_output.size()) << "Not all objects were processed with chunk size " << chunk_size;
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(ValidJsonInput, TestDataObjectsInput,
     ::testing::Values(
         ParamWithDescription<const std::string, const std::vector<test_records>>(
@@ -180,7 +311,13 @@ INSTANTIATE_TEST_CASE_P(ValidJsonInput, TestDataObjectsInput,
         ParamWithDescription<const std::string, const std::vector<test_records>>(
             Elijah_Barry_compact_no_whitespace_no_comma, case_two_records, "two_compact_format_records_no_whitespace_no_comma"),
         ParamWithDescription<const std::string, const std::vector<test_records>>(
-            Elijah_Barry_compact_array, case_two_records, "two_compact_format_records_as_array")),
+            Elijah_Barry_compact_array, case_two_records, "two_compact_format_records_as_array"),
+        ParamWithDescription<const std::string, const std::vector<test_records>>(
+            "[ ]\n[ " + Elijah_compact + " ,\n " + Barry_compact + " ]", case_two_records, "empty_array_and_white_space_in_array"),
+        ParamWithDescription<const std::string, const std::vector<test_records>>(
+            Escaped_compact + Elijah_compact, case_escaped_records, "escaped_quotes_and_braces_in_strings"),
+        ParamWithDescription<const std::string, const std::vector<test_records>>(
+            Long_escaped_compact + Elijah_compact, case_long_escaped_records, "escapes_and_braces_across_scanned_blocks")),
     [](const testing::TestParamInfo<ParamWithDescription<const std::string, const std::vector<test_records>>>& info)
     {
         return info.param.GetDescription();
@@ -227,4 +364,233 @@ INSTANTIATE_TEST_CASE_P(BadFormatInput, TestBadFormatDataObjectsInput,
     {
         return info.param.GetDescription();
     }
-    );
\ No newline at end of file
+    );
+TEST(TestDataObjects, ArrayElementsOfAnyType)
+{
+    // The elements of an array at the top level are returned one at a time, whatever their type
+    const std::string test_input(R"([1, "a\"]b" ,[2,{"x":3}],{"id":4},null])");
+    const std::vector<char> view(test_input.begin(), test_input.end());
+    DataObjects owned(std::string(test_input.data(), test_input.size()));
+    DataObjects viewed(view.data(), view.size());
+
+    for (DataObjects* CUT : {&owned, &viewed})
+    {
+        auto value = CUT->get_next_object();
+        ASSERT_NE(value, nullptr);
+        ASSERT_TRUE(value->IsInt());
+        EXPECT_EQ(value->GetInt(), 1);
+
+        value = CUT->get_next_object();
+        ASSERT_NE(value, nullptr);
+        ASSERT_TRUE(value->IsString());
+        EXPECT_EQ(std::string(value->GetString()), "a\"]b");
+
+        value = CUT->get_next_object();
+        ASSERT_NE(value, nullptr);
+        ASSERT_TRUE(value->IsArray()) << "An array in an array should be returned whole";
+        EXPECT_EQ(value->Size(), 2u);
+
+        value = CUT->get_next_object();
+        ASSERT_NE(value, nullptr);
+        ASSERT_TRUE(value->IsObject());
+
+        value = CUT->get_next_object();
+        ASSERT_NE(value, nullptr);
+        EXPECT_TRUE(value->IsNull());
+
+        EXPECT_EQ(CUT->get_next_object(), nullptr);
+        EXPECT_EQ(CUT->get_error(), DataObjects::ErrorType::NONE);
+    }
+}
+
+TEST(TestDataObjects, ArrayElementsBeforeArrayIsComplete)
+{
+    // Each element is returned as soon as it is complete, rather than once the whole array is
+    DataObjects CUT;
+    const std::string first_chunk = "[" + Elijah_compact + ",\n" + Barry_compact.substr(0, 20);
+    CUT.feed(first_chunk.data(), first_chunk.size());
+
+    auto record = CUT.get_next_object();
+    ASSERT_NE(record, nullptr) << "The first element should be returned before the array is complete";
+    check_record(record, Elijah_record);
+    ASSERT_EQ(CUT.get_next_object(), nullptr);
+    ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The array may yet be completed";
+
+    const std::string second_chunk = Barry_compact.substr(20) + "]";
+    CUT.feed(second_chunk.data(), second_chunk.size());
+    CUT.finish();
+    record = CUT.get_next_object();
+    ASSERT_NE(record, nullptr);
+    check_record(record, Barry_record);
+    EXPECT_EQ(CUT.get_next_object(), nullptr);
+    EXPECT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE);
+}
+
+TEST(TestDataObjects, ArrayStringElementSplitAfterBackslash)
+{
+    // Each split leaves a chunk ending in the middle of a string, one of them just after the backslash of an escape
+    const std::string test_input(R"([1, "a\"]b\\" ,2])");
+    for (size_t split = 1; split < test_input.size(); split++)
+    {
+        DataObjects CUT;
+        CUT.feed(test_input.data(), split);
+        std::vector<rapidjson::Type> types;
+        for (auto value = CUT.get_next_object(); value != nullptr; value = CUT.get_next_object())
+        {
+            types.push_back(value->GetType());
+        }
+        ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "split at " << split;
+
+        CUT.feed(test_input.data() + split, test_input.size() - split);
+        CUT.finish();
+        for (auto value = CUT.get_next_object(); value != nullptr; value = CUT.get_next_object())
+        {
+            if (value->IsString())
+            {
+                EXPECT_EQ(std::string(value->GetString()), "a\"]b\\") << "split at " << split;
+            }
+            types.push_back(value->GetType());
+        }
+        EXPECT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "split at " << split;
+        EXPECT_EQ(types, (std::vector<rapidjson::Type>{rapidjson::kNumberType, rapidjson::kStringType, rapidjson::kNumberType}))
+            << "split at " << split;
+    }
+}
+
+class TestBadArrayDataObjectsInput :
+    public ::testing::TestWithParam<ParamWithDescription<const std::string, const size_t>>
+{};
+TEST_P(TestBadArrayDataObjectsInput, ElementsBeforeError)
+{
+    // The elements before the error are returned, and then the error is reported
+    auto param = GetParam();
+    DataObjects CUT(std::string(param.GetParam()));
+
+    size_t n_values = 0;
+    while (CUT.get_next_object() != nullptr)
+    {
+        n_values++;
+    }
+    EXPECT_EQ(n_values, param.GetExpected()) << "Unexpected number of elements before the error";
+    EXPECT_EQ(CUT.get_error(), DataObjects::ErrorType::FORMAT) << "The error should indicate the format error";
+}
+INSTANTIATE_TEST_CASE_P(BadArrayInput, TestBadArrayDataObjectsInput,
+    ::testing::Values(
+        ParamWithDescription<const std::string, const size_t>("[{} {}]", 1, "missing_comma"),
+        ParamWithDescription<const std::string, const size_t>("[{},]", 1, "trailing_comma"),
+        ParamWithDescription<const std::string, const size_t>("[,{}]", 0, "leading_comma"),
+        ParamWithDescription<const std::string, const size_t>("[{},{}", 2, "not_closed"),
+        ParamWithDescription<const std::string, const size_t>("[{},{}}]", 2, "closing_brace_in_array"),
+        ParamWithDescription<const std::string, const size_t>("[{},nul]", 1, "bad_literal")),
+    [](const testing::TestParamInfo<ParamWithDescription<const std::string, const size_t>>& info)
+    {
+        return info.param.GetDescription();
+    }
+    );
+
+/**
+ * \brief Expected outcome of parsing an ill formatted response in recovery mode
+*/
+struct recovery_case
+{
+    std::vector<int> ids;                               /// Ids of the records returned, in order
+    std::vector<std::pair<size_t, size_t>> skipped;     /// Ranges of bytes skipped
+};
+
+const std::string truncated_record(R"({"id":5,"name":"Tru)");
+
+class TestRecoveryDataObjectsInput :
+    public ::testing::TestWithParam<ParamWithDescription<const std::string, const recovery_case>>
+{};
+TEST_P(TestRecoveryDataObjectsInput, SkipsIllFormattedJson)
+{
+    auto param = GetParam();
+    const std::string test_input = param.GetParam();
+    const recovery_case expected = param.GetExpected();
+
+    // The same records should be found and bytes skipped whether the response is whole or in chunks
+    for (size_t chunk_size : {size_t(0), size_t(1), size_t(7)})
+    {
+        SCOPED_TRACE("Chunk size: " + std::to_string(chunk_size));
+        DataObjects CUT = (chunk_size == 0) ? DataObjects(std::string(test_input)) : DataObjects();
+        CUT.set_recovery(1);
+
+        std::vector<int> ids;
+        auto add_available_records = [&]()
+        {
+            for (auto record = CUT.get_next_object(); record != nullptr; record = CUT.get_next_object())
+            {
+                ids.push_back((record->IsObject() && record->HasMember("id")) ? (*record)["id"].GetInt() : -1);
+            }
+        };
+        for (size_t offset = 0; (chunk_size > 0) && (offset < test_input.size()); offset += chunk_size)
+        {
+            CUT.feed(test_input.data() + offset, std::min(chunk_size, test_input.size() - offset));
+            add_available_records();
+        }
+        CUT.finish();
+        add_available_records();
+
+        EXPECT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The response should be recovered";
+        EXPECT_EQ(ids, expected.ids) << "Unexpected records";
+        std::vector<std::pair<size_t, size_t>> skipped;
+        for (const auto& range : CUT.get_skipped())
+        {
+            skipped.emplace_back(range.begin, range.end);
+        }
+        EXPECT_EQ(skipped, expected.skipped) << "Unexpected ranges skipped";
+    }
+}
+INSTANTIATE_TEST_CASE_P(RecoveryInput, TestRecoveryDataObjectsInput,
+    ::testing::Values(
+        ParamWithDescription<const std::string, const recovery_case>(
+            Elijah_compact + "\n" + truncated_record + "\n" + Barry_compact,
+            {{600002, 600003}, {{Elijah_compact.size() + 1, Elijah_compact.size() + truncated_record.size() + 2}}},
+            "truncated_record"),
+        ParamWithDescription<const std::string, const recovery_case>(
+            "[" + Elijah_compact + R"(,{"id":1,},)" + Barry_compact + "]",
+            {{600002, 600003}, {{Elijah_compact.size() + 2, Elijah_compact.size() + 11}}},
+            "bad_element"),
+        ParamWithDescription<const std::string, const recovery_case>(
+            "[" + Elijah_compact + " " + Barry_compact + "]", {{600002, 600003}, {}}, "missing_comma"),
+        ParamWithDescription<const std::string, const recovery_case>(
+            "[," + Elijah_compact + "]", {{600002}, {{1, 2}}}, "leading_comma"),
+        ParamWithDescription<const std::string, const recovery_case>(
+            "[" + Elijah_compact + "," + Barry_compact, {{600002, 600003}, {}}, "array_not_closed"),
+        ParamWithDescription<const std::string, const recovery_case>(
+            Elijah_compact + " garbage", {{600002}, {{Elijah_compact.size() + 1, Elijah_compact.size() + 8}}}, "trailing_garbage")),
+    [](const testing::TestParamInfo<ParamWithDescription<const std::string, const recovery_case>>& info)
+    {
+        return info.param.GetDescription();
+    }
+    );
+
+TEST(TestDataObjects, RecoveryFailsWhenTooMuchIsSkipped)
+{
+    const std::string test_input = Elijah_compact + "\n" + truncated_record + "\n" + Barry_compact;
+    const double skipped_fraction = (truncated_record.size() + 1.0) / test_input.size();
+
+    DataObjects allowed{std::string(test_input)};
+    allowed.set_recovery(skipped_fraction * 1.01);
+    while (allowed.get_next_object() != nullptr)
+    {
+    }
+    EXPECT_EQ(allowed.get_error(), DataObjects::ErrorType::NONE) << "The bytes skipped are within the limit";
+
+    DataObjects CUT{std::string(test_input)};
+    CUT.set_recovery(skipped_fraction * 0.99);
+    auto record = CUT.get_next_object();
+    ASSERT_NE(record, nullptr) << "The record before the ill formatted json should be returned";
+    EXPECT_EQ(CUT.get_next_object(), nullptr);
+    EXPECT_EQ(CUT.get_error(), DataObjects::ErrorType::FORMAT) << "Too much of the response was skipped";
+}
+
+TEST(TestDataObjects, ClassifyStart)
+{
+    ASSERT_EQ(DataObjects::classify_start("", 0), DataObjects::BodyStart::UNKNOWN);
+    ASSERT_EQ(DataObjects::classify_start(" \r\n\t", 4), DataObjects::BodyStart::UNKNOWN);
+    ASSERT_EQ(DataObjects::classify_start("\n  {\"id\":1}", 11), DataObjects::BodyStart::JSON);
+    ASSERT_EQ(DataObjects::classify_start("[{}]", 4), DataObjects::BodyStart::JSON);
+    ASSERT_EQ(DataObjects::classify_start("<html>", 6), DataObjects::BodyStart::NOT_JSON);
+    ASSERT_EQ(DataObjects::classify_start("500 - Something bad happened!", 29), DataObjects::BodyStart::NOT_JSON);
+}
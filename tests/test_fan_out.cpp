@@ -0,0 +1,183 @@
+/**
+ * \brief This file contains tests for the MultiClient and FanOut classes.
+ * 
+ * Each endpoint is a TestHttpServer on the loopback interface, and the tables populated from all
+ * of them are compared with tables populated from the same responses one after another.
+*/
+
+#include "fan_out.hpp"
+#include "multi_client.hpp"
+#include "data_objects.hpp"
+#include "sharded_tables.hpp"
+#include "tables.hpp"
+
+#include "compare_tables.hpp"
+#include "http_server.hpp"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// Each city has a single user with most friends, and no two names or hobbies are as common as each other
+const std::string first_body(R"({"id":1,"name":"Elijah","city":"Palm Springs","age":43,"friends":[{"name":"Nora","hobbies":["Reading"]}]})" "\n"
+                             R"({"id":2,"name":"Barry","city":"Washington","age":23,"friends":[]})" "\n"
+                             R"({"id":3,"name":"Elijah","city":"Washington","age":31,"friends":[{"name":"Luke","hobbies":["Golf","Reading"]}]})");
+const std::string second_body(R"([{"id":4,"name":"Paul","city":"Palm Springs","age":86,"friends":[{"name":"Ringo","hobbies":["Reading"]},)"
+                              R"({"name":"George","hobbies":["Golf"]}]},)"
+                              R"({"id":5,"name":"Elijah","city":"Las Vegas","age":20,"friends":[]}])");
+const std::string third_body(R"({"id":6,"name":"John","city":"Las Vegas","age":40,"friends":[{"name":"Yoko","hobbies":["Reading"]}]})");
+
+// Citizens of Austin and Boston with as many friends as each other, records without ids, and ids in several responses
+const std::string tied_first_body(R"({"name":"Adam","city":"Austin","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]}]})" "\n"
+                                  R"({"id":10,"name":"Carl","city":"Boston","age":50,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+const std::string tied_second_body(R"({"name":"Barry","city":"Austin","age":40,"friends":[{"name":"Yan","hobbies":["Golf"]}]})" "\n"
+                                   R"({"id":10,"name":"Dora","city":"Boston","age":20,"friends":[{"name":"Yan","hobbies":["Golf"]},{"name":"Yan","hobbies":["Golf"]}]})" "\n"
+                                   R"({"id":11,"name":"Eve","city":"Boston","age":60,"friends":[{"name":"Yan","hobbies":["Golf"]},{"name":"Yan","hobbies":["Golf"]}]})");
+const std::string tied_third_body(R"({"name":"Finn","city":"Austin","age":70,"friends":[{"name":"Yan","hobbies":["Golf"]}]})" "\n"
+                                  R"({"id":1,"name":"Gina","city":"Chicago","age":80,"friends":[]})");
+
+/**
+ * \brief Serves the same body to every request, after the delay given
+*/
+std::unique_ptr<TestHttpServer> serve(const std::string& body, int status = 200,
+                                      std::chrono::milliseconds delay = std::chrono::milliseconds(0))
+{
+    return std::unique_ptr<TestHttpServer>(new TestHttpServer([body, status, delay](const TestHttpRequest&)
+    {
+        std::this_thread::sleep_for(delay);
+        TestHttpResponse response;
+        response.status = status;
+        response.body = body;
+        return response;
+    }));
+}
+
+/**
+ * \brief Populates tables from the bodies one after another, as the results of all of them should be
+*/
+Results expected_results(const std::vector<std::string>& bodies)
+{
+    Tables tables;
+    for (const auto& body : bodies)
+    {
+        DataObjects data_objects{std::string(body)};
+        for (auto record = data_objects.get_next_object(); record != nullptr; record = data_objects.get_next_object())
+        {
+            tables.add_record(record);
+        }
+        EXPECT_EQ(data_objects.get_error(), DataObjects::ErrorType::NONE) << "This test json string is ill formatted";
+    }
+    return tables.query_results();
+}
+} // namespace
+
+TEST(TestFanOut, MergesResultsOfAllEndpoints)
+{
+    auto first = serve(first_body);
+    auto second = serve(second_body);
+    auto third = serve(third_body);
+
+    MultiClient client({first->url(), second->url(), third->url()}, 2);
+    Tables CUT;
+    FanOut fan_out(client, CUT);
+    fan_out.run();
+
+    ASSERT_EQ(fan_out.get_error(), FanOut::ErrorType::NONE) << "Querying the endpoints failed";
+    ASSERT_EQ(client.get_error(), MultiClient::ErrorType::NONE);
+    EXPECT_EQ(fan_out.get_bad_records(), 0);
+    check_same_results(CUT.query_results(), expected_results({first_body, second_body, third_body}));
+    EXPECT_EQ(first->get_num_requests() + second->get_num_requests() + third->get_num_requests(), 3)
+        << "Each endpoint should be queried once";
+}
+
+TEST(TestFanOut, ResultsDoNotDependOnWhichEndpointIsSlowest)
+{
+    // The records are added as if the responses were concatenated in the order of the endpoints, whichever arrives first
+    const std::vector<std::string> bodies {tied_first_body, tied_second_body, tied_third_body};
+    const Results expected = expected_results(bodies);
+    for (size_t i_slow = 0; i_slow < bodies.size(); i_slow++)
+    {
+        std::vector<std::unique_ptr<TestHttpServer>> servers;
+        std::vector<std::string> endpoints;
+        for (size_t i_body = 0; i_body < bodies.size(); i_body++)
+        {
+            servers.push_back(serve(bodies[i_body], 200, std::chrono::milliseconds((i_body == i_slow) ? 200 : 0)));
+            endpoints.push_back(servers.back()->url());
+        }
+
+        MultiClient client(endpoints);
+        Tables CUT;
+        FanOut fan_out(client, CUT);
+        fan_out.run();
+
+        ASSERT_EQ(fan_out.get_error(), FanOut::ErrorType::NONE) << "Querying the endpoints failed";
+        const Results results = CUT.query_results();
+        check_same_results(results, expected);
+        ASSERT_EQ(results.cities.size(), 3u) << "Endpoint " << i_slow << " was slowest";
+        EXPECT_EQ(results.cities[0].user_with_most_friends, "Barry") << "Endpoint " << i_slow << " was slowest";
+        EXPECT_EQ(results.cities[1].user_with_most_friends, "Dora") << "Endpoint " << i_slow << " was slowest";
+    }
+}
+
+TEST(TestFanOut, PopulatesShardedTables)
+{
+    // Citizens without ids, and ids in several responses, are numbered and replaced across the shards as in a single Tables
+    auto first = serve(tied_first_body);
+    auto second = serve(tied_second_body);
+    auto third = serve(tied_third_body);
+
+    MultiClient client({first->url(), second->url(), third->url()});
+    ShardedTables CUT(2);
+    FanOut fan_out(client, CUT);
+    fan_out.run();
+
+    ASSERT_EQ(fan_out.get_error(), FanOut::ErrorType::NONE) << "Querying the endpoints failed";
+    check_same_results(CUT.query_results(), expected_results({tied_first_body, tied_second_body, tied_third_body}));
+}
+
+TEST(TestFanOut, OneEndpointFails)
+{
+    auto first = serve(first_body);
+    auto failing = serve("500 - Something bad happened!", 500);
+    auto not_json = serve("<html>Service unavailable</html>");
+    auto third = serve(third_body);
+
+    MultiClient client({first->url(), failing->url(), not_json->url(), third->url()});
+    Tables CUT;
+    FanOut fan_out(client, CUT);
+    fan_out.run();
+
+    EXPECT_EQ(fan_out.get_error(), FanOut::ErrorType::QUERY) << "A failed endpoint should fail the query";
+    EXPECT_EQ(client.get_error(0), MultiClient::ErrorType::NONE);
+    EXPECT_EQ(client.get_error(1), MultiClient::ErrorType::HTTP_STATUS);
+    EXPECT_EQ(client.get_error(2), MultiClient::ErrorType::NON_JSON_BODY);
+    EXPECT_EQ(client.get_error(3), MultiClient::ErrorType::NONE);
+
+    // The endpoints which responded are still merged, without anything from those which failed
+    check_same_results(CUT.query_results(), expected_results({first_body, third_body}));
+}
+
+TEST(TestFanOut, SameClientQueriedAgain)
+{
+    // As in polling mode, the client and its connections are kept, and each run starts afresh
+    auto first = serve(first_body);
+    auto second = serve(second_body);
+
+    MultiClient client({first->url(), second->url()});
+    for (int i_run = 0; i_run < 2; i_run++)
+    {
+        Tables CUT;
+        FanOut fan_out(client, CUT);
+        fan_out.run();
+        ASSERT_EQ(fan_out.get_error(), FanOut::ErrorType::NONE) << "Run " << i_run << " failed";
+        check_same_results(CUT.query_results(), expected_results({first_body, second_body}));
+    }
+    EXPECT_EQ(first->get_num_connections(), 1) << "The connection should be reused";
+    EXPECT_EQ(second->get_num_connections(), 1) << "The connection should be reused";
+}
@@ -0,0 +1,161 @@
+/**
+ * \brief This file contains tests for the FlatHashMap class.
+ *
+ * The map is checked against a std::map holding the same entries, through inserts and erases
+ * which leave runs of entries probing past each other.
+*/
+
+#include "flat_hash_map.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+/**
+ * \brief Hash which sends every key to the same few slots, so that the entries probe past each other
+*/
+struct CollidingHash
+{
+    size_t operator()(unsigned int key) const
+    {
+        return key % 3;
+    }
+};
+
+/**
+ * \brief Expects the map to hold exactly the entries of the expected map
+*/
+template <typename Map>
+void expect_same_entries(const Map& map, const std::map<unsigned int, unsigned int>& expected)
+{
+    ASSERT_EQ(map.size(), expected.size());
+    size_t n_iterated = 0;
+    for (const auto& entry : map)
+    {
+        const auto expected_entry = expected.find(entry.first);
+        ASSERT_NE(expected_entry, expected.end()) << "Key " << entry.first << " should have been erased";
+        EXPECT_EQ(entry.second, expected_entry->second) << "Value of key " << entry.first;
+        n_iterated++;
+    }
+    EXPECT_EQ(n_iterated, expected.size()) << "Iteration should visit every entry once";
+    for (const auto& expected_entry : expected)
+    {
+        const auto entry = map.find(expected_entry.first);
+        ASSERT_NE(entry, map.end()) << "Key " << expected_entry.first << " is missing";
+        EXPECT_EQ(entry->second, expected_entry.second) << "Value of key " << expected_entry.first;
+    }
+}
+
+/**
+ * \brief Inserts and erases the same pseudo-random keys in both maps
+*/
+template <typename Map>
+void insert_and_erase(Map& map, std::map<unsigned int, unsigned int>& expected, unsigned int key_range)
+{
+    uint64_t state = 1;
+    for (unsigned int i_op = 0; i_op < 20000; i_op++)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const unsigned int key = static_cast<unsigned int>(state >> 33) % key_range;
+        if ((state >> 20) % 3 == 0)
+        {
+            EXPECT_EQ(map.erase(key), expected.erase(key)) << "Erasing key " << key;
+        }
+        else
+        {
+            map[key] = i_op;
+            expected[key] = i_op;
+        }
+    }
+}
+} // namespace
+
+TEST(TestFlatHashMap, MatchesStdMap)
+{
+    FlatHashMap<unsigned int, unsigned int> map;
+    std::map<unsigned int, unsigned int> expected;
+    insert_and_erase(map, expected, 5000);
+    expect_same_entries(map, expected);
+}
+
+TEST(TestFlatHashMap, MatchesStdMapWithCollisions)
+{
+    // Every key hashes to one of three slots, so erasing has to move the entries after it back
+    FlatHashMap<unsigned int, unsigned int, CollidingHash> map;
+    std::map<unsigned int, unsigned int> expected;
+    insert_and_erase(map, expected, 500);
+    expect_same_entries(map, expected);
+}
+
+TEST(TestFlatHashMap, KeysDifferingInHighBits)
+{
+    FlatHashMap<unsigned int, unsigned int> map;
+    std::map<unsigned int, unsigned int> expected;
+    for (unsigned int i_key = 0; i_key < 4096; i_key++)
+    {
+        map.emplace(i_key << 20, i_key);
+        expected.emplace(i_key << 20, i_key);
+    }
+    expect_same_entries(map, expected);
+}
+
+TEST(TestFlatHashMap, EmplaceKeepsExistingValue)
+{
+    FlatHashMap<unsigned int, unsigned int> map;
+    EXPECT_TRUE(map.emplace(7, 1).second);
+    const auto existing = map.emplace(7, 2);
+    EXPECT_FALSE(existing.second) << "The key was already in the map";
+    EXPECT_EQ(existing.first->second, 1u) << "The value should not be replaced";
+    EXPECT_EQ(map.size(), 1u);
+}
+
+TEST(TestFlatHashMap, ReserveKeepsEntriesInPlace)
+{
+    FlatHashMap<unsigned int, std::vector<unsigned int>> map;
+    map.reserve(1000);
+    std::vector<unsigned int>& first = map[0];
+    first.push_back(42);
+    for (unsigned int key = 1; key < 1000; key++)
+    {
+        map[key].push_back(key);
+    }
+    EXPECT_EQ(&first, &map[0]) << "Inserting no more entries than reserved should not move any";
+    EXPECT_EQ(first, std::vector<unsigned int>{42});
+}
+
+TEST(TestFlatHashMap, ClearThenReuse)
+{
+    FlatHashMap<unsigned int, unsigned int> map;
+    std::map<unsigned int, unsigned int> expected;
+    insert_and_erase(map, expected, 5000);
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(map.begin(), map.end()) << "A cleared map should have nothing to iterate";
+    EXPECT_EQ(map.find(1), map.end());
+
+    expected.clear();
+    insert_and_erase(map, expected, 5000);
+    expect_same_entries(map, expected);
+}
+
+TEST(TestFlatHashMap, StringViewKeys)
+{
+    const std::vector<std::string> strings = {"Palm Springs", "Washington", "Las Vegas", ""};
+    FlatHashMap<std::string_view, unsigned int> map;
+    for (unsigned int i_string = 0; i_string < strings.size(); i_string++)
+    {
+        map.emplace(strings[i_string], i_string);
+    }
+
+    const std::string washington("Washington");
+    ASSERT_NE(map.find(washington), map.end()) << "Keys should be compared by their characters";
+    EXPECT_EQ(map.find(washington)->second, 1u);
+    EXPECT_EQ(map.find(std::string_view()), map.find(""));
+    EXPECT_EQ(map.find("Las"), map.end());
+}
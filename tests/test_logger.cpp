@@ -0,0 +1,169 @@
+/**
+ * \brief This file contains tests for the Logger, LogType and LogMessage classes.
+ *
+ * Each test captures the output of the Logger in a string stream, and restores the Logger's
+ * settings when it finishes, since there is one Logger for the program.
+*/
+
+#include "logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+/**
+ * \brief Captures the output of the Logger while in scope
+*/
+class CapturedLog
+{
+public:
+    CapturedLog()
+    {
+        Logger::get().set_output(m_stream);
+    }
+    ~CapturedLog()
+    {
+        Logger& logger = Logger::get();
+        logger.set_output(std::cerr);
+        logger.set_level(Logger::Level::INFO);
+        logger.set_rate_limit(10);
+    }
+
+    /**
+     * \brief Returns everything logged so far
+    */
+    std::string text()
+    {
+        Logger::get().flush();
+        return m_stream.str();
+    }
+
+private:
+    std::ostringstream m_stream;
+};
+
+/**
+ * \brief Returns the number of times a substring appears in the text
+*/
+size_t count(const std::string& text, const std::string& substring)
+{
+    size_t n = 0;
+    for (size_t pos = text.find(substring); pos != std::string::npos; pos = text.find(substring, pos + 1))
+    {
+        n++;
+    }
+    return n;
+}
+} // namespace
+
+TEST(TestLogger, Levels)
+{
+    CapturedLog log;
+    Logger::get().set_level(Logger::Level::WARNING);
+    LogMessage(Logger::Level::DEBUG) << "debug " << 1;
+    LogMessage(Logger::Level::INFO) << "info " << 2;
+    LogMessage(Logger::Level::WARNING) << "warning " << 3;
+    LogMessage(Logger::Level::ERROR) << "error " << 4;
+    EXPECT_EQ(log.text(), "WARNING: warning 3\n\nERROR: error 4\n\n");
+
+    LogMessage not_logged(Logger::Level::INFO);
+    EXPECT_FALSE(not_logged.is_logged()) << "A message below the level shouldn't be formatted";
+}
+
+TEST(TestLogger, ParseLevel)
+{
+    Logger::Level level = Logger::Level::INFO;
+    EXPECT_TRUE(Logger::parse_level("error", level));
+    EXPECT_EQ(level, Logger::Level::ERROR);
+    EXPECT_TRUE(Logger::parse_level("debug", level));
+    EXPECT_EQ(level, Logger::Level::DEBUG);
+    EXPECT_FALSE(Logger::parse_level("loud", level));
+    EXPECT_EQ(level, Logger::Level::DEBUG);
+}
+
+TEST(TestLogger, RateLimitIsSummarised)
+{
+    // Whichever second each message falls in, every message is either logged or counted in a summary
+    CapturedLog log;
+    Logger::get().set_rate_limit(5);
+    const size_t n_messages = 1000;
+    {
+        LogType type(Logger::Level::WARNING, "test records");
+        for (size_t i_message = 0; i_message < n_messages; i_message++)
+        {
+            LogMessage(type) << "test record " << i_message;
+        }
+    }
+    const std::string text = log.text();
+
+    const size_t n_logged = count(text, "WARNING: test record ");
+    size_t n_summarised = 0;
+    const std::regex summary("WARNING: ([0-9]+) more test records were not logged");
+    for (std::sregex_iterator it(text.begin(), text.end(), summary); it != std::sregex_iterator(); it++)
+    {
+        n_summarised += std::stoul((*it)[1]);
+    }
+    EXPECT_GE(n_logged, 5u);
+    EXPECT_LT(n_logged, 100u);
+    EXPECT_EQ(n_logged + n_summarised, n_messages);
+}
+
+TEST(TestLogger, ConcurrentProducers)
+{
+    // Errors are never dropped, so every message arrives, and each thread's messages arrive in order
+    CapturedLog log;
+    const int n_threads = 4;
+    const int n_messages = 5000;
+    std::vector<std::thread> threads;
+    for (int i_thread = 0; i_thread < n_threads; i_thread++)
+    {
+        threads.emplace_back([i_thread]
+        {
+            for (int i_message = 0; i_message < n_messages; i_message++)
+            {
+                LogMessage(Logger::Level::ERROR) << "thread " << i_thread << " message " << i_message;
+            }
+        });
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const std::string text = log.text();
+
+    std::vector<int> next_message(n_threads, 0);
+    std::istringstream lines(text);
+    std::string line;
+    int i_thread;
+    int i_message;
+    while (std::getline(lines, line))
+    {
+        if (std::sscanf(line.c_str(), "ERROR: thread %d message %d", &i_thread, &i_message) == 2)
+        {
+            ASSERT_EQ(i_message, next_message[i_thread]) << "Thread " << i_thread;
+            next_message[i_thread]++;
+        }
+    }
+    EXPECT_EQ(next_message, std::vector<int>(n_threads, n_messages));
+}
+
+TEST(TestLogger, Excerpt)
+{
+    CapturedLog log;
+    const std::string block(1000, 'x');
+    LogMessage(Logger::Level::ERROR).excerpt(block.data(), block.size());
+    EXPECT_EQ(log.text(), "ERROR: " + std::string(LogMessage::EXCERPT_SIZE, 'x') + "... (744 more bytes)\n\n");
+
+    CapturedLog debug_log;
+    Logger::get().set_level(Logger::Level::DEBUG);
+    LogMessage(Logger::Level::ERROR).excerpt(block.data(), block.size());
+    EXPECT_EQ(debug_log.text(), "ERROR: " + block + "\n\n") << "The whole block is logged for debugging";
+}
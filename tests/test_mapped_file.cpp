@@ -0,0 +1,139 @@
+/**
+ * \brief This file contains tests for the MappedFile class.
+ * 
+ * Each test writes a capture to a temporary file, maps it, and checks the contents can be
+ * parsed in place.
+*/
+
+#include "mapped_file.hpp"
+#include "data_objects.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+/**
+ * \brief Temporary file, removed when it goes out of scope
+*/
+class TemporaryFile
+{
+public:
+    TemporaryFile(const std::string& contents)
+    {
+        char path[] = "/tmp/mapped_file_testXXXXXX";
+        int fd = mkstemp(path);
+        close(fd);
+        m_path = path;
+        std::ofstream(m_path, std::ios::binary) << contents;
+    }
+    ~TemporaryFile() { std::remove(m_path.c_str()); }
+
+    const char* path() const { return m_path.c_str(); }
+
+private:
+    std::string m_path;
+};
+
+const std::string Elijah_compact(R"({"id":600002,"name":"Elijah","city":"Palm Springs","age":43,)"
+                                    R"("friends":[{"name":"Charlotte","hobbies":["Reading"]}]})");
+} // namespace
+
+TEST(TestMappedFile, MapsContents)
+{
+    TemporaryFile file(Elijah_compact);
+    MappedFile CUT(file.path());
+
+    ASSERT_EQ(CUT.get_error(), MappedFile::ErrorType::NONE) << "Mapping the file failed";
+    ASSERT_EQ(std::string(CUT.get_data(), CUT.get_size()), Elijah_compact) << "The mapping doesn't match the file";
+}
+
+TEST(TestMappedFile, EmptyFile)
+{
+    TemporaryFile file("");
+    MappedFile CUT(file.path());
+
+    ASSERT_EQ(CUT.get_error(), MappedFile::ErrorType::NONE) << "An empty file is still a valid capture";
+    ASSERT_EQ(CUT.get_size(), 0) << "An empty file should have no contents";
+}
+
+TEST(TestMappedFile, MissingFile)
+{
+    MappedFile CUT("/tmp/mapped_file_test_does_not_exist");
+
+    ASSERT_EQ(CUT.get_error(), MappedFile::ErrorType::OPEN) << "A missing file should fail to open";
+    ASSERT_EQ(CUT.get_data(), nullptr) << "Nothing should be mapped for a missing file";
+}
+
+TEST(TestMappedFile, ParseWholePages)
+{
+    // Fill exactly one page, so there is no zero padding after the last byte of the mapping
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    std::string contents;
+    size_t n_records = 0;
+    while (contents.size() + Elijah_compact.size() + 1 <= page_size)
+    {
+        contents += Elijah_compact + "\n";
+        n_records++;
+    }
+    contents.resize(page_size - 1, ' ');
+    contents += '\n';
+
+    TemporaryFile file(contents);
+    MappedFile mapping(file.path());
+    ASSERT_EQ(mapping.get_error(), MappedFile::ErrorType::NONE) << "Mapping the file failed";
+
+    DataObjects CUT(mapping.get_data(), mapping.get_size());
+    size_t n_parsed = 0;
+    while (CUT.get_next_object() != nullptr)
+    {
+        n_parsed++;
+    }
+    ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << "The mapped capture should parse without error";
+    ASSERT_EQ(n_parsed, n_records) << "Not every record in the mapped capture was parsed";
+}
+
+TEST(TestMappedFile, ReplayDirectoryWithEmptyCapture)
+{
+    char path[] = "/tmp/mapped_file_test_dirXXXXXX";
+    ASSERT_NE(mkdtemp(path), nullptr);
+    const std::string directory(path);
+    std::ofstream(directory + "/1.json", std::ios::binary) << Elijah_compact;
+    std::ofstream(directory + "/2.json", std::ios::binary) << "";
+    std::ofstream(directory + "/3.json", std::ios::binary) << Elijah_compact;
+
+    const std::vector<std::string> captures = MappedFile::list_captures(directory);
+    ASSERT_EQ(captures, (std::vector<std::string>{directory + "/1.json", directory + "/3.json"}))
+        << "The empty capture should be left out, and the others listed in name order";
+
+    size_t n_parsed = 0;
+    for (const auto& capture : captures)
+    {
+        MappedFile mapping(capture.c_str());
+        ASSERT_EQ(mapping.get_error(), MappedFile::ErrorType::NONE) << "Mapping " << capture << " failed";
+        DataObjects CUT(mapping.get_data(), mapping.get_size());
+        while (CUT.get_next_object() != nullptr)
+        {
+            n_parsed++;
+        }
+        ASSERT_EQ(CUT.get_error(), DataObjects::ErrorType::NONE) << capture << " should parse without error";
+    }
+    EXPECT_EQ(n_parsed, 2u);
+
+    for (const char* name : {"/1.json", "/2.json", "/3.json"})
+    {
+        std::remove((directory + name).c_str());
+    }
+    rmdir(path);
+}
+
+TEST(TestMappedFile, SingleCaptureIsListed)
+{
+    TemporaryFile file("");
+    ASSERT_EQ(MappedFile::list_captures(file.path()), std::vector<std::string>{file.path()});
+}
@@ -0,0 +1,276 @@
+/**
+ * \brief This file contains tests for the ParallelParser class.
+ *
+ * Whatever the number of threads, and wherever the regions happen to split the response, the
+ * tables must end up the same as when the response is parsed by a single DataObjects. The
+ * responses are generated with strings full of braces, quotes and backslashes, so that the
+ * regions split inside them, and the regions are made tiny so that every response is split many
+ * times over.
+*/
+
+#include "data_objects.hpp"
+#include "parallel_parser.hpp"
+#include "record_handler.hpp"
+
+#include "compare_tables.hpp"
+#include "parameterise_description.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+namespace
+{
+/**
+ * \brief How the generated records are laid out in the response
+*/
+enum class Layout {
+    ARRAY,      /// A single array of records
+    OBJECTS,    /// Records at the top level, one per line
+    COMMAS,     /// Records at the top level, separated by commas
+    MIXED,      /// Arrays of records and records at the top level, with values which aren't records in the arrays
+};
+
+/**
+ * \brief Prints the layout when gtest reports a failing parameter
+*/
+std::ostream& operator<<(std::ostream& os, Layout layout)
+{
+    return os << static_cast<int>(layout);
+}
+
+/**
+ * \brief Generates strings which confuse a scan that starts in the middle of them
+*/
+std::string awkward_string(std::mt19937& random)
+{
+    static const char* const pieces[] = { "{", "}", "[", "]", "\\\"", "\\\\", "\\\\\\\"", ",", ":", " ",
+                                          "\\n", "\\u0041", "Ann", "\\/", "\\\\\\\\", "\\\"}]" };
+    std::string text;
+    const int n_pieces = random() % 8;
+    for (int i_piece = 0; i_piece < n_pieces; i_piece++)
+    {
+        text += pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))];
+    }
+    return "\"" + text + "\"";
+}
+
+/**
+ * \brief Generates a record, which is sometimes invalid, sometimes has no id, and sometimes repeats an id
+*/
+std::string generate_record(std::mt19937& random)
+{
+    std::string record = "{";
+    const int kind = random() % 10;
+    if (kind != 0)
+    {
+        record += "\"id\":" + std::to_string(random() % 50) + ",";
+    }
+    record += "\"name\":" + awkward_string(random) + ",";
+    if (kind != 1)
+    {
+        record += "\"city\":" + awkward_string(random) + ",";
+    }
+    record += "\"age\":" + std::to_string(random() % 90) + ",";
+    record += "\"note\":{\"text\":" + awkward_string(random) + ",\"list\":[[],{},[" + awkward_string(random) + "]]},";
+    record += "\"friends\":[";
+    const int n_friends = random() % 4;
+    for (int i_friend = 0; i_friend < n_friends; i_friend++)
+    {
+        record += (i_friend > 0) ? "," : "";
+        record += "{\"name\":" + awkward_string(random) + ",\"hobbies\":[" + awkward_string(random) + "," +
+                  awkward_string(random) + "]}";
+    }
+    record += "]}";
+    return record;
+}
+
+/**
+ * \brief Generates a response of records laid out as given
+*/
+std::string generate_response(Layout layout, int n_records, unsigned int seed)
+{
+    std::mt19937 random(seed);
+    std::string response;
+    switch (layout)
+    {
+    case Layout::ARRAY:
+        response = "[\n";
+        for (int i_record = 0; i_record < n_records; i_record++)
+        {
+            response += (i_record > 0) ? ",\n" : "";
+            response += generate_record(random);
+        }
+        response += "\n]\n";
+        break;
+    case Layout::OBJECTS:
+    case Layout::COMMAS:
+        for (int i_record = 0; i_record < n_records; i_record++)
+        {
+            response += ((i_record > 0) && (layout == Layout::COMMAS)) ? ",\n" : "\n";
+            response += generate_record(random);
+        }
+        break;
+    case Layout::MIXED:
+        for (int i_record = 0; i_record < n_records;)
+        {
+            if (random() % 3 == 0)
+            {
+                response += generate_record(random) + "\n";
+                i_record++;
+                continue;
+            }
+            response += "[";
+            const int n_elements = random() % 6;
+            for (int i_element = 0; i_element < n_elements; i_element++, i_record++)
+            {
+                response += (i_element > 0) ? " , " : "";
+                const int kind = random() % 8;
+                response += (kind == 0) ? awkward_string(random) :
+                            (kind == 1) ? "[" + generate_record(random) + "]" :
+                            (kind == 2) ? "12" :
+                                          generate_record(random);
+            }
+            response += "]\n";
+        }
+        break;
+    }
+    return response;
+}
+
+/**
+ * \brief Parses the response with a single DataObjects, as the program does without threads
+*/
+DataObjects::ErrorType parse_serial(const std::string& response, Tables& tables, int& n_bad_records)
+{
+    DataObjects json_objects(response.data(), response.size());
+    RecordHandler records(tables);
+    while (json_objects.parse_next_block(records))
+    {
+    }
+    n_bad_records = records.get_bad_records();
+    return json_objects.get_error();
+}
+
+/**
+ * \brief Expects every number of threads to give the same tables as parsing serially
+ *
+ * \returns true if parsing serially failed
+*/
+bool expect_same_as_serial(const std::string& response)
+{
+    TablesForTest expected;
+    int expected_bad_records = 0;
+    const bool expected_error = (parse_serial(response, expected, expected_bad_records) != DataObjects::ErrorType::NONE);
+
+    for (unsigned int n_threads = 2; n_threads <= 16; n_threads++)
+    {
+        SCOPED_TRACE("Threads: " + std::to_string(n_threads));
+        TablesForTest CUT;
+        ParallelParser parser(CUT, n_threads, 1);
+        parser.parse(response.data(), response.size());
+
+        EXPECT_EQ(parser.get_error() != ParallelParser::ErrorType::NONE, expected_error) << "Error differs from parsing serially";
+        EXPECT_EQ(parser.get_bad_records(), expected_bad_records) << "Number of bad records differs from parsing serially";
+        expect_same_tables(CUT, expected);
+
+        const Results results = CUT.query_results();
+        const Results expected_results = expected.query_results();
+        EXPECT_EQ(results.cities.size(), expected_results.cities.size()) << "Number of cities differs";
+        if (results.cities.size() != expected_results.cities.size())
+        {
+            continue;
+        }
+        for (size_t i_city = 0; i_city < results.cities.size(); i_city++)
+        {
+            EXPECT_EQ(results.cities[i_city].city_name, expected_results.cities[i_city].city_name);
+            EXPECT_EQ(results.cities[i_city].average_age, expected_results.cities[i_city].average_age);
+            EXPECT_EQ(results.cities[i_city].average_number_of_friends, expected_results.cities[i_city].average_number_of_friends);
+            EXPECT_EQ(results.cities[i_city].user_with_most_friends, expected_results.cities[i_city].user_with_most_friends);
+        }
+        EXPECT_EQ(results.most_common_first_name, expected_results.most_common_first_name);
+        EXPECT_EQ(results.most_common_hobby, expected_results.most_common_hobby);
+    }
+    return expected_error;
+}
+} // namespace
+
+class TestParallelParser :
+    public ::testing::TestWithParam<ParamWithDescription<const Layout, const unsigned int>>
+{};
+TEST_P(TestParallelParser, SameAsSerial)
+{
+    auto param = GetParam();
+    for (unsigned int seed = param.GetExpected(); seed < param.GetExpected() + 10; seed++)
+    {
+        SCOPED_TRACE("Seed: " + std::to_string(seed));
+        EXPECT_FALSE(expect_same_as_serial(generate_response(param.GetParam(), 40, seed))) << "This test json string is ill formatted";
+    }
+}
+INSTANTIATE_TEST_CASE_P(SameAsSerial, TestParallelParser,
+    ::testing::Values(
+        ParamWithDescription<const Layout, const unsigned int>(Layout::ARRAY, 100, "array"),
+        ParamWithDescription<const Layout, const unsigned int>(Layout::OBJECTS, 200, "objects"),
+        ParamWithDescription<const Layout, const unsigned int>(Layout::COMMAS, 300, "objects_with_commas"),
+        ParamWithDescription<const Layout, const unsigned int>(Layout::MIXED, 400, "mixed")),
+    [](const testing::TestParamInfo<ParamWithDescription<const Layout, const unsigned int>>& info)
+    {
+        return info.param.GetDescription();
+    }
+);
+
+TEST(TestParallelParser, GeneratedIdsInOrder)
+{
+    // Records without ids are numbered in the order they appear, whichever thread parsed them
+    std::string response = "[";
+    for (int i_record = 0; i_record < 200; i_record++)
+    {
+        response += (i_record > 0) ? "," : "";
+        response += R"({"name":"N)" + std::to_string(i_record) + R"(","city":"C","age":1,"friends":[]})";
+    }
+    response += "]";
+
+    TablesForTest CUT;
+    ParallelParser parser(CUT, 8, 1);
+    parser.parse(response.data(), response.size());
+    ASSERT_EQ(parser.get_error(), ParallelParser::ErrorType::NONE);
+
+    const auto& citizens = CUT.get_citizen_table();
+    ASSERT_EQ(citizens.size(), 200u);
+    for (const auto& citizen : citizens)
+    {
+        EXPECT_EQ(citizen.second.name, "N" + std::to_string(citizen.first - 1)) << "Generated ids are out of order";
+    }
+}
+
+class TestParallelParserErrors :
+    public ::testing::TestWithParam<ParamWithDescription<const std::string, const bool>>
+{};
+TEST_P(TestParallelParserErrors, SameAsSerial)
+{
+    // Records before the error are added, and none after it
+    auto param = GetParam();
+    const std::string valid = generate_response(Layout::ARRAY, 20, 1);
+    const std::string response = valid.substr(0, valid.size() - 3) + param.GetParam() + valid.substr(valid.size() - 3) +
+                                 generate_response(Layout::OBJECTS, 20, 2);
+    EXPECT_EQ(expect_same_as_serial(response), param.GetExpected()) << "Unexpected result of parsing serially";
+}
+INSTANTIATE_TEST_CASE_P(SameAsSerial, TestParallelParserErrors,
+    ::testing::Values(
+        ParamWithDescription<const std::string, const bool>(R"( {"id":1})", true, "missing_comma"),
+        ParamWithDescription<const std::string, const bool>(R"(,)", true, "trailing_comma"),
+        ParamWithDescription<const std::string, const bool>(R"(,{"id":1,})", true, "bad_object"),
+        ParamWithDescription<const std::string, const bool>(R"(,nul)", true, "bad_literal"),
+        ParamWithDescription<const std::string, const bool>(R"(,{"id":1}})", true, "unbalanced")),
+    [](const testing::TestParamInfo<ParamWithDescription<const std::string, const bool>>& info)
+    {
+        return info.param.GetDescription();
+    }
+);
+
+TEST(TestParallelParser, TrailingGarbage)
+{
+    const std::string response = generate_response(Layout::OBJECTS, 20, 3) + "garbage";
+    EXPECT_TRUE(expect_same_as_serial(response)) << "Trailing garbage should fail to parse";
+}
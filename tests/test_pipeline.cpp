@@ -0,0 +1,127 @@
+/**
+ * \brief This file contains tests for the Pipeline class.
+ *
+ * The endpoint is a TestHttpServer on the loopback interface, and the tables populated while the
+ * response downloads are compared with tables populated from the whole response once it is buffered.
+*/
+
+#include "pipeline.hpp"
+#include "client.hpp"
+#include "data_objects.hpp"
+#include "sharded_tables.hpp"
+#include "tables.hpp"
+
+#include "compare_tables.hpp"
+#include "http_server.hpp"
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+namespace
+{
+/**
+ * \brief Returns a response of records, one per line, large enough to take many chunks
+*/
+std::string make_body(int n_records)
+{
+    static const char* const names[] = {"Elijah", "Barry", "Nora", "Paul"};
+    static const char* const cities[] = {"Palm Springs", "Washington", "Las Vegas"};
+    std::string body;
+    for (int i_record = 0; i_record < n_records; i_record++)
+    {
+        body += R"({"id":)" + std::to_string(i_record) + R"(,"name":")" + names[i_record % 4] + R"(","city":")" +
+                cities[i_record % 3] + R"(","age":)" + std::to_string(20 + i_record % 60) +
+                R"(,"friends":[{"name":"Luke","hobbies":["Golf","Reading"]}]})" "\n";
+    }
+    return body;
+}
+
+const std::string body = make_body(20000);
+
+/**
+ * \brief Serves the body given to every request, dropping the connection after drop_after bytes of it
+*/
+TestHttpServer::Handler serve(const std::string& response_body, size_t drop_after = std::string::npos)
+{
+    return [response_body, drop_after](const TestHttpRequest&)
+    {
+        TestHttpResponse response;
+        response.body = response_body;
+        response.drop_after = drop_after;
+        return response;
+    };
+}
+} // namespace
+
+TEST(TestPipeline, MatchesBufferedQuery)
+{
+    TestHttpServer server(serve(body));
+    Client client(server.url().c_str());
+
+    Tables CUT;
+    Pipeline pipeline(client, CUT, 4);
+    pipeline.run();
+    ASSERT_EQ(pipeline.get_error(), Pipeline::ErrorType::NONE) << "The pipelined query failed";
+    EXPECT_EQ(pipeline.get_bad_records(), 0);
+
+    // The same response, downloaded in full before it is parsed
+    client.query_endpoint();
+    ASSERT_EQ(client.get_error(), Client::ErrorType::NONE);
+    Tables expected;
+    DataObjects data_objects{std::string(client.get_response())};
+    for (auto record = data_objects.get_next_object(); record != nullptr; record = data_objects.get_next_object())
+    {
+        expected.add_record(record);
+    }
+    ASSERT_EQ(data_objects.get_error(), DataObjects::ErrorType::NONE);
+
+    check_same_results(CUT.query_results(), expected.query_results());
+}
+
+TEST(TestPipeline, PopulatesShardedTables)
+{
+    TestHttpServer server(serve(body));
+    Client client(server.url().c_str());
+
+    ShardedTables CUT(3);
+    Pipeline pipeline(client, CUT, 4);
+    pipeline.run();
+    ASSERT_EQ(pipeline.get_error(), Pipeline::ErrorType::NONE) << "The pipelined query failed";
+
+    Tables expected;
+    Pipeline expected_pipeline(client, expected, 4);
+    expected_pipeline.run();
+    ASSERT_EQ(expected_pipeline.get_error(), Pipeline::ErrorType::NONE);
+
+    check_same_results(CUT.query_results(), expected.query_results());
+}
+
+TEST(TestPipeline, MalformedBodyAbortsTransfer)
+{
+    const std::string malformed_body = make_body(100) + R"({"id":100,"name":})" + body;
+    TestHttpServer server(serve(malformed_body));
+    Client client(server.url().c_str());
+
+    Tables CUT;
+    Pipeline pipeline(client, CUT, 1);
+    pipeline.run();
+
+    EXPECT_EQ(pipeline.get_error(), Pipeline::ErrorType::FORMAT) << "The format error should be reported, not the aborted transfer";
+    EXPECT_NE(client.get_error(), Client::ErrorType::NONE) << "Closing the queue should abort the transfer";
+    EXPECT_LT(client.get_transfer_stats().bytes_decoded, malformed_body.size()) << "The rest of the response was downloaded";
+}
+
+TEST(TestPipeline, DroppedConnectionIsQueryError)
+{
+    // The connection is dropped in the middle of a record, which would be ill formatted if it were parsed
+    TestHttpServer server(serve(body, body.size() / 2 + 7));
+    Client client(server.url().c_str());
+
+    Tables CUT;
+    Pipeline pipeline(client, CUT, 4);
+    pipeline.run();
+
+    EXPECT_EQ(client.get_error(), Client::ErrorType::QUERY);
+    EXPECT_EQ(pipeline.get_error(), Pipeline::ErrorType::QUERY) << "The dropped connection should be reported, not the truncated json";
+}
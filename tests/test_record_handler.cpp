@@ -0,0 +1,272 @@
+/**
+ * \brief This file contains tests for the RecordHandler class.
+ *
+ * The RecordHandler adds records to the tables as rapidjson parses them, without building a
+ * document. It must accept and reject exactly the records that Tables::add_record() does for a
+ * rapidjson::Value, so each test parses the same response both ways and compares the tables.
+ * The records it collects are also added in batches, which must give the same tables as adding
+ * them one at a time.
+*/
+
+#include "data_objects.hpp"
+#include "record_handler.hpp"
+#include "tables.hpp"
+
+#include "compare_tables.hpp"
+#include "parameterise_description.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+/**
+ * \brief Adds every record of the response to the tables through rapidjson documents
+ *
+ * \returns Number of records which were not added
+*/
+int add_documents(const std::string &response, Tables &tables)
+{
+    DataObjects json_objects(std::string(response.data(), response.size()));
+    int n_bad_records = 0;
+    for (auto record = json_objects.get_next_object(); record != nullptr; record = json_objects.get_next_object())
+    {
+        if (!tables.add_record(record))
+        {
+            n_bad_records++;
+        }
+    }
+    EXPECT_EQ(json_objects.get_error(), DataObjects::ErrorType::NONE) << "This test json string is ill formatted";
+    return n_bad_records;
+}
+
+/**
+ * \brief Adds every record of the response to the tables through a RecordHandler
+ *
+ * \returns Number of records which were not added
+*/
+int add_events(const std::string &response, Tables &tables)
+{
+    DataObjects json_objects(std::string(response.data(), response.size()));
+    RecordHandler records(tables);
+    while (json_objects.parse_next_block(records))
+    {
+    }
+    EXPECT_EQ(json_objects.get_error(), DataObjects::ErrorType::NONE) << "This test json string is ill formatted";
+    return records.get_bad_records();
+}
+
+/**
+ * \brief Collects the valid records of the response, in order
+*/
+std::vector<Record> collect_records(const std::string &response)
+{
+    DataObjects json_objects(std::string(response.data(), response.size()));
+    std::vector<Record> collected;
+    RecordHandler records(collected);
+    while (json_objects.parse_next_block(records))
+    {
+    }
+    EXPECT_EQ(json_objects.get_error(), DataObjects::ErrorType::NONE) << "This test json string is ill formatted";
+    return collected;
+}
+
+/**
+ * \brief Adds the records to the tables in batches of the given size
+*/
+void add_batches(std::vector<Record> records, size_t batch_size, Tables &tables)
+{
+    for (size_t i_record = 0; i_record < records.size(); i_record += batch_size)
+    {
+        tables.add_records(records.data() + i_record, std::min(batch_size, records.size() - i_record));
+    }
+}
+
+/**
+ * \brief Adds the records to the tables one at a time
+*/
+void add_one_by_one(std::vector<Record> records, Tables &tables)
+{
+    for (auto &record : records)
+    {
+        tables.add_record(std::move(record));
+    }
+}
+
+const std::string Elijah_compact(R"({"id":600002,"name":"Elijah","city":"Palm Springs","age":43,)"
+                                    R"("friends":[{"name":"Charlotte","hobbies":["Reading"]}]})");
+const std::string Barry_compact(R"({"id":600003,"name":"Barry","city":"Washington","age":23,)"
+                                    R"("friends":[{"name":"Morris","hobbies":["Movie Watching","Golf"]},)"
+                                    R"({"name":"Robin","hobbies":["Shopping","Calligraphy","Martial Arts"]}]})");
+const std::string Elijah_compact_no_id(R"({"name":"Elijah","city":"Palm Springs","age":43,)"
+                                    R"("friends":[{"name":"Charlotte","hobbies":["Reading"]}]})");
+const std::string Barry_compact_no_id(R"({"name":"Barry","city":"Washington","age":23,"friends":[]})");
+
+// Only the first of repeated keys counts, whether or not it's valid
+const std::string repeated_keys(R"({"id":7,"id":"seven","name":"Anna","name":5,"city":"Reno","age":30,"age":[],)"
+                                    R"("friends":[{"name":"Ben","name":"Bob","hobbies":["Golf"],"hobbies":["Chess"]}],"friends":5})");
+const std::string repeated_invalid_key(R"({"id":8,"name":"Anna","city":"Reno","age":"thirty","age":30,"friends":[]})");
+
+// Ids must fit in an int
+const std::string id_string(R"({"id":"9","name":"Carl","city":"Reno","age":30,"friends":[]})");
+const std::string id_double(R"({"id":9.0,"name":"Carl","city":"Reno","age":30,"friends":[]})");
+const std::string id_too_large(R"({"id":2147483648,"name":"Carl","city":"Reno","age":30,"friends":[]})");
+const std::string id_largest(R"({"id":2147483647,"name":"Carl","city":"Reno","age":30,"friends":[]})");
+const std::string id_negative(R"({"id":-5,"name":"Carl","city":"Reno","age":30,"friends":[]})");
+const std::string id_null(R"({"id":null,"name":"Carl","city":"Reno","age":30,"friends":[]})");
+
+// Missing or mistyped fields
+const std::string no_city(R"({"id":10,"name":"Dora","age":30,"friends":[]})");
+const std::string city_object(R"({"id":10,"name":"Dora","city":{"name":"Reno"},"age":30,"friends":[]})");
+const std::string no_name(R"({"id":10,"city":"Reno","age":30,"friends":[]})");
+const std::string age_string(R"({"id":10,"name":"Dora","city":"Reno","age":"30","friends":[]})");
+const std::string no_friends(R"({"id":10,"name":"Dora","city":"Reno","age":30})");
+const std::string friends_object(R"({"id":10,"name":"Dora","city":"Reno","age":30,"friends":{"name":"Ed"}})");
+
+// Friends without a name, hobbies which aren't strings, and nested values with the same keys
+const std::string odd_friends(R"({"id":11,"name":"Eve","city":"Reno","age":30,"friends":[)"
+                                    R"({"hobbies":["Golf"]},{"name":12,"hobbies":["Golf"]},{"name":["Fay"]},)"
+                                    R"({"name":"Gil","hobbies":"Golf"},{"name":"Hal","hobbies":["Golf",3,["Chess"],{"name":"Go"},"Judo"]},)"
+                                    R"({"other":{"name":"Ida","hobbies":["Golf"]},"name":"Jon"},[{"name":"Kim"}]]})");
+const std::string nested_record_keys(R"({"extra":{"id":1,"name":"Zed","city":"Nowhere","age":1,"friends":[]},)"
+                                    R"("id":12,"name":"Fred","city":"Reno","age":30,"friends":[],"more":[{"city":"Elsewhere"}]})");
+} // namespace
+
+class TestRecordHandler :
+    public ::testing::TestWithParam<ParamWithDescription<const std::string, const int>>
+{};
+TEST_P(TestRecordHandler, SameTablesAsDocuments)
+{
+    auto param = GetParam();
+    const std::string test_input = param.GetParam();
+    const int expected_bad_records = param.GetExpected();
+
+    TablesForTest expected;
+    TablesForTest CUT;
+    EXPECT_EQ(add_documents(test_input, expected), expected_bad_records) << "Unexpected number of records failed validation";
+    EXPECT_EQ(add_events(test_input, CUT), expected_bad_records) << "The handler should reject the same records";
+
+    expect_same_tables(CUT, expected);
+}
+INSTANTIATE_TEST_CASE_P(SameTablesAsDocuments, TestRecordHandler,
+    ::testing::Values(
+        ParamWithDescription<const std::string, const int>(
+            Elijah_compact + "\n" + Barry_compact, 0, "two_records"),
+        ParamWithDescription<const std::string, const int>(
+            "[" + Elijah_compact + "," + Barry_compact + "]", 0, "array_of_records"),
+        ParamWithDescription<const std::string, const int>(
+            "[" + Elijah_compact_no_id + "]\n" + Barry_compact_no_id + "\n" + Elijah_compact, 0, "generated_ids"),
+        ParamWithDescription<const std::string, const int>(
+            repeated_keys, 0, "first_of_repeated_keys"),
+        ParamWithDescription<const std::string, const int>(
+            repeated_invalid_key, 1, "first_of_repeated_keys_invalid"),
+        ParamWithDescription<const std::string, const int>(
+            id_string + id_double + id_too_large + id_null, 4, "id_not_an_int"),
+        ParamWithDescription<const std::string, const int>(
+            id_largest + id_negative, 0, "id_limits"),
+        ParamWithDescription<const std::string, const int>(
+            no_city + city_object + no_name + age_string + no_friends + friends_object, 6, "missing_or_mistyped_fields"),
+        ParamWithDescription<const std::string, const int>(
+            no_city + Elijah_compact_no_id + Barry_compact_no_id, 1, "rejected_record_takes_no_id"),
+        ParamWithDescription<const std::string, const int>(
+            odd_friends, 0, "friends_without_names_and_hobbies_not_strings"),
+        ParamWithDescription<const std::string, const int>(
+            nested_record_keys, 0, "nested_values_with_record_keys")),
+    [](const testing::TestParamInfo<ParamWithDescription<const std::string, const int>>& info)
+    {
+        return info.param.GetDescription();
+    }
+);
+
+namespace
+{
+// Records which are new to the tables, repeat an id in the same batch, replace a citizen, move
+// between cities, have no id, a negative id or no city
+const std::string first_response("[" + Elijah_compact + "," + Barry_compact + "," + Elijah_compact_no_id + "," +
+    R"({"id":20,"name":"Gus","city":"Reno","age":30,"friends":[{"name":"Ben","hobbies":["Golf"]}]},)"
+    R"({"id":21,"name":"Hal","city":"","age":31,"friends":[]},)" + id_negative + "," + Barry_compact_no_id + "," +
+    R"({"id":20,"name":"Gus","city":"Elko","age":32,"friends":[{"name":"Bob","hobbies":["Chess","Golf"]}]},)"
+    R"({"id":3,"name":"Ivy","city":"Reno","age":33,"friends":[{"name":"Ann","hobbies":["Golf"]}]},)"
+    R"({"id":1,"name":"Jan","city":"Elko","age":34,"friends":[]}])");
+const std::string second_response("[" + Barry_compact + "," +
+    R"({"id":600002,"name":"Elijah","city":"Reno","age":44,"friends":[]},)" + Barry_compact_no_id + "," +
+    R"({"id":22,"name":"Kay","city":"Elko","age":35,"friends":[{"name":"Cal","hobbies":["Judo"]}]},)"
+    R"({"id":20,"name":"Gus","city":"Elko","age":32,"friends":[{"name":"Bob","hobbies":["Chess","Golf"]}]},)"
+    R"({"id":23,"name":"Lou","city":"Reno","age":36,"friends":[]},)" + Elijah_compact_no_id + "," +
+    R"({"id":22,"name":"Kay","city":"Reno","age":35,"friends":[]},)" + id_largest + "]");
+} // namespace
+
+class TestRecordBatches :
+    public ::testing::TestWithParam<size_t>
+{};
+TEST_P(TestRecordBatches, SameTablesAsOneByOne)
+{
+    const size_t batch_size = GetParam();
+    const std::vector<Record> first = collect_records(first_response);
+    const std::vector<Record> second = collect_records(second_response);
+
+    TablesForTest expected;
+    TablesForTest CUT;
+    add_one_by_one(first, expected);
+    add_batches(first, batch_size, CUT);
+    expect_same_tables(CUT, expected);
+
+    // A further response updates the citizens already in the tables
+    expected.begin_update();
+    CUT.begin_update();
+    add_one_by_one(second, expected);
+    add_batches(second, batch_size, CUT);
+    expected.end_update();
+    CUT.end_update();
+    expect_same_tables(CUT, expected);
+}
+INSTANTIATE_TEST_CASE_P(SameTablesAsOneByOne, TestRecordBatches, ::testing::Values(1, 2, 3, 5, 100));
+
+TEST(TestRecordBatches, NextBatch)
+{
+    // Every record is batched once, in order, and the elements of an array are batched separately
+    const std::string response = first_response + "\n" + no_name + "\n" + second_response + "\n" + Barry_compact;
+    DataObjects json_objects(std::string(response.data(), response.size()));
+    std::vector<Record> batch;
+    std::vector<size_t> batch_sizes;
+    TablesForTest CUT;
+    while (json_objects.next_batch(batch, 2))
+    {
+        batch_sizes.push_back(batch.size());
+        CUT.add_records(batch.data(), batch.size());
+        batch.clear();
+    }
+    EXPECT_EQ(json_objects.get_error(), DataObjects::ErrorType::NONE);
+    EXPECT_EQ(json_objects.get_bad_records(), 1) << "The record without a name should be counted";
+    EXPECT_EQ(batch_sizes, std::vector<size_t>(10, 2));
+
+    TablesForTest expected;
+    EXPECT_EQ(add_events(response, expected), 1);
+    expect_same_tables(CUT, expected);
+}
+
+TEST(TestRecordBatches, RecoveryForgetsPartialRecord)
+{
+    // The record which fails to parse has been partly seen by the handler when the error is found
+    const std::string bad_record(R"({"id":5,"name":"Bad","city":"Reno","age":1,"friends":[{"name":"Al","hobbies":["Go"]}],})");
+    const std::string response = Elijah_compact + "\n" + bad_record + "\n" + Barry_compact + "\n[" + bad_record + "," +
+                                 Elijah_compact_no_id + "]";
+    DataObjects json_objects(response.data(), response.size());
+    json_objects.set_recovery(0.5);
+    std::vector<Record> batch;
+    TablesForTest CUT;
+    while (json_objects.next_batch(batch))
+    {
+        CUT.add_records(batch.data(), batch.size());
+        batch.clear();
+    }
+    EXPECT_EQ(json_objects.get_error(), DataObjects::ErrorType::NONE);
+    EXPECT_EQ(json_objects.get_skipped().size(), 2u) << "Each bad record should be skipped";
+
+    TablesForTest expected;
+    EXPECT_EQ(add_events(Elijah_compact + "\n" + Barry_compact + "\n[" + Elijah_compact_no_id + "]", expected), 0);
+    expect_same_tables(CUT, expected);
+}
@@ -0,0 +1,135 @@
+#include "sharded_tables.hpp"
+#include "partial_results.hpp"
+#include "tables.hpp"
+
+#include "compare_tables.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+namespace
+{
+Record citizen(int id, const char* name, const char* city, size_t n_friends)
+{
+    Record record;
+    record.has_id = true;
+    record.id = id;
+    record.name = name;
+    record.age = 30;
+    record.city = city;
+    record.friends.resize(n_friends, {"Yan", {"Golf"}});
+    return record;
+}
+} // namespace
+
+class TestShardedTables : public ::testing::TestWithParam<unsigned int>
+{
+};
+
+TEST_P(TestShardedTables, TestMatchesTables)
+{
+    RecordGenerator generator;
+    ShardedTables CUT(GetParam());
+    Tables expected;
+    for (int i_update = 0; i_update < 20; i_update++)
+    {
+        CUT.begin_update();
+        expected.begin_update();
+        for (int i_batch = 0; i_batch < 3; i_batch++)
+        {
+            std::vector<Record> batch = generator.generate(20);
+            std::vector<Record> same_batch(batch);
+            CUT.add_records(batch.data(), batch.size());
+            expected.add_records(same_batch.data(), same_batch.size());
+        }
+        CUT.end_update();
+        expected.end_update();
+        check_same_results(CUT.query_results(), expected.query_results());
+
+        // Records replacing citizens outside of an update
+        std::vector<Record> batch = generator.generate(5);
+        std::vector<Record> same_batch(batch);
+        CUT.add_records(batch.data(), batch.size());
+        expected.add_records(same_batch.data(), same_batch.size());
+        check_same_results(CUT.query_results(), expected.query_results());
+    }
+}
+
+TEST_P(TestShardedTables, TestMostFriendsTieGoesToFirstInResponse)
+{
+    // Citizens with consecutive ids are in different shards, but the first in the response still wins
+    std::vector<Record> response {citizen(7, "Gina", "Austin", 2), citizen(4, "Dora", "Austin", 2),
+                                  citizen(5, "Ezra", "Austin", 2), citizen(6, "Finn", "Austin", 1)};
+    ShardedTables CUT(GetParam());
+    CUT.add_records(response.data(), response.size());
+
+    const Results results = CUT.query_results();
+    ASSERT_EQ(results.cities.size(), 1u);
+    EXPECT_EQ(results.cities[0].user_with_most_friends, "Gina");
+    EXPECT_EQ(results.cities[0].average_number_of_friends, 1);
+}
+
+INSTANTIATE_TEST_CASE_P(Shards, TestShardedTables, ::testing::Values(1u, 2u, 3u, 4u));
+
+TEST(TestPartialResults, TestMatchQueryResults)
+{
+    RecordGenerator generator;
+    Tables tables;
+    for (int i_update = 0; i_update < 10; i_update++)
+    {
+        tables.begin_update();
+        std::vector<Record> batch = generator.generate(50);
+        tables.add_records(batch.data(), batch.size());
+        tables.end_update();
+        check_same_results(tables.partial_results().get_results(), tables.query_results());
+    }
+}
+
+TEST(TestPartialResults, TestMergeInAnyOrder)
+{
+    // Split a response among tables by id, numbering the records by their position in it
+    RecordGenerator generator;
+    std::vector<Record> response = generator.generate(200);
+    for (size_t i_record = 0; i_record < response.size(); i_record++)
+    {
+        response[i_record].has_id = true;
+        response[i_record].id = static_cast<int>(generator.below(60));
+    }
+    std::vector<Record> whole(response);
+    Tables expected;
+    expected.add_records(whole.data(), whole.size());
+
+    std::vector<Tables> parts(3);
+    std::vector<std::vector<Record>> part_records(parts.size());
+    std::vector<std::vector<size_t>> part_positions(parts.size());
+    for (size_t i_record = 0; i_record < response.size(); i_record++)
+    {
+        const size_t i_part = response[i_record].id % parts.size();
+        part_records[i_part].push_back(response[i_record]);
+        part_positions[i_part].push_back(i_record);
+    }
+    for (size_t i_part = 0; i_part < parts.size(); i_part++)
+    {
+        parts[i_part].add_records(part_records[i_part].data(), part_records[i_part].size(), part_positions[i_part].data());
+    }
+
+    PartialResults forwards;
+    for (size_t i_part = 0; i_part < parts.size(); i_part++)
+    {
+        forwards.merge(parts[i_part].partial_results());
+    }
+    PartialResults backwards;
+    for (size_t i_part = parts.size(); i_part > 0; i_part--)
+    {
+        backwards.merge(parts[i_part - 1].partial_results());
+    }
+    PartialResults nested = parts[2].partial_results();
+    PartialResults first_two = parts[1].partial_results();
+    first_two.merge(parts[0].partial_results());
+    nested.merge(first_two);
+
+    check_same_results(forwards.get_results(), expected.query_results());
+    check_same_results(backwards.get_results(), expected.query_results());
+    check_same_results(nested.get_results(), expected.query_results());
+}
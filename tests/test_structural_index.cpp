@@ -0,0 +1,166 @@
+/**
+ * \brief This file contains tests for the StructuralIndex class.
+ * 
+ * Every variant of classify() which this machine supports is checked against the one which goes a
+ * byte at a time, and the escapes and strings found from their masks against a byte at a time scan.
+*/
+
+#include "structural_index.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace
+{
+const StructuralIndex::Variant variants[] = {StructuralIndex::Variant::SCALAR, StructuralIndex::Variant::SSE2,
+                                             StructuralIndex::Variant::AVX2};
+
+/**
+ * \brief Returns a string of the characters of interest, mixed with others, including bytes above 0x7f
+*/
+std::string random_text(size_t size, uint64_t seed)
+{
+    static const char alphabet[] = "\"\\{}[] \t\n\r\v\fx:,\x80\xff";
+    std::string text(size, ' ');
+    uint64_t state = seed;
+    for (auto& c : text)
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        c = alphabet[(state >> 33) % (sizeof(alphabet) - 1)];
+    }
+    return text;
+}
+
+/**
+ * \brief Finds the escaped characters and those in strings of a whole text, a block at a time with the variant given
+*/
+void scan_blocks(const std::string& text, StructuralIndex::Variant variant, std::vector<bool>& escaped, std::vector<bool>& in_string)
+{
+    uint64_t escape_carry = 0;
+    uint64_t string_carry = 0;
+    for (size_t offset = 0; offset < text.size(); offset += StructuralIndex::BLOCK_SIZE)
+    {
+        const size_t size = std::min(StructuralIndex::BLOCK_SIZE, text.size() - offset);
+        const StructuralIndex::Masks masks = StructuralIndex::classify(text.data() + offset, size, variant);
+        const uint64_t block_escaped = StructuralIndex::find_escaped(masks.backslash, size, escape_carry);
+        const uint64_t block_in_string = StructuralIndex::find_in_string(masks.quote & ~block_escaped, string_carry);
+        for (size_t i_byte = 0; i_byte < size; i_byte++)
+        {
+            escaped.push_back((block_escaped >> i_byte) & 1);
+            in_string.push_back((block_in_string >> i_byte) & 1);
+        }
+    }
+}
+} // namespace
+
+TEST(TestStructuralIndex, VariantsClassifyTheSame)
+{
+    const std::string text = random_text(4 * StructuralIndex::BLOCK_SIZE, 1);
+    for (const auto variant : variants)
+    {
+        if (!StructuralIndex::is_supported(variant))
+        {
+            continue;
+        }
+        for (size_t offset = 0; offset < 2 * StructuralIndex::BLOCK_SIZE; offset += 7)
+        {
+            for (size_t size = 0; size <= StructuralIndex::BLOCK_SIZE; size++)
+            {
+                const auto expected = StructuralIndex::classify(text.data() + offset, size, StructuralIndex::Variant::SCALAR);
+                const auto masks = StructuralIndex::classify(text.data() + offset, size, variant);
+                const auto fastest = StructuralIndex::classify(text.data() + offset, size);
+                for (const auto* actual : {&masks, &fastest})
+                {
+                    EXPECT_EQ(actual->quote, expected.quote) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->backslash, expected.backslash) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->open_brace, expected.open_brace) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->close_brace, expected.close_brace) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->open_square, expected.open_square) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->close_square, expected.close_square) << "offset " << offset << " size " << size;
+                    EXPECT_EQ(actual->whitespace, expected.whitespace) << "offset " << offset << " size " << size;
+                }
+            }
+        }
+    }
+}
+
+TEST(TestStructuralIndex, ScalarVariantMatchesCharacters)
+{
+    const std::string text("\"\\{}[] \t\n\r\v\fx\x80\xff");
+    const auto masks = StructuralIndex::classify(text.data(), text.size(), StructuralIndex::Variant::SCALAR);
+    EXPECT_EQ(masks.quote, 1ULL << 0);
+    EXPECT_EQ(masks.backslash, 1ULL << 1);
+    EXPECT_EQ(masks.open_brace, 1ULL << 2);
+    EXPECT_EQ(masks.close_brace, 1ULL << 3);
+    EXPECT_EQ(masks.open_square, 1ULL << 4);
+    EXPECT_EQ(masks.close_square, 1ULL << 5);
+    EXPECT_EQ(masks.whitespace, 0x3fULL << 6) << "Space, tab, newline, carriage return, vertical tab and form feed";
+}
+
+TEST(TestStructuralIndex, EscapesAndStringsAcrossBlocks)
+{
+    // Runs of backslashes of every length end at, and cross, the boundaries between blocks, followed by quotes
+    std::vector<std::string> texts;
+    for (size_t run = 1; run <= 70; run++)
+    {
+        for (const size_t end : {StructuralIndex::BLOCK_SIZE - 1, StructuralIndex::BLOCK_SIZE, StructuralIndex::BLOCK_SIZE + 1,
+                                 2 * StructuralIndex::BLOCK_SIZE})
+        {
+            if (run >= end)
+            {
+                continue;
+            }
+            std::string text = "\"" + std::string(end - run - 1, 'x') + std::string(run, '\\') + "\"x\"";
+            text.resize(3 * StructuralIndex::BLOCK_SIZE + 5, 'x');
+            texts.push_back(text);
+        }
+    }
+    for (uint64_t seed = 1; seed <= 20; seed++)
+    {
+        texts.push_back(random_text(5 * StructuralIndex::BLOCK_SIZE + seed, seed));
+    }
+
+    for (const auto& text : texts)
+    {
+        // Byte at a time: the character after an odd length run of backslashes is escaped, and unescaped quotes toggle strings
+        std::vector<bool> expected_escaped;
+        std::vector<bool> expected_in_string;
+        size_t run = 0;
+        bool in_string = false;
+        for (const char c : text)
+        {
+            const bool escape = (c != '\\') && (run % 2 == 1);
+            expected_escaped.push_back(escape);
+            if ((c == '"') && !escape)
+            {
+                in_string = !in_string;
+            }
+            expected_in_string.push_back(in_string);
+            run = (c == '\\') ? run + 1 : 0;
+        }
+
+        for (const auto variant : variants)
+        {
+            if (!StructuralIndex::is_supported(variant))
+            {
+                continue;
+            }
+            std::vector<bool> escaped;
+            std::vector<bool> in_string_found;
+            scan_blocks(text, variant, escaped, in_string_found);
+            ASSERT_EQ(escaped, expected_escaped) << "variant " << static_cast<int>(variant) << " text " << text;
+            ASSERT_EQ(in_string_found, expected_in_string) << "variant " << static_cast<int>(variant) << " text " << text;
+        }
+    }
+}
+
+TEST(TestStructuralIndex, VariantsOfThisMachineAreSupported)
+{
+    EXPECT_TRUE(StructuralIndex::is_supported(StructuralIndex::Variant::SCALAR));
+#if defined(__x86_64__)
+    EXPECT_TRUE(StructuralIndex::is_supported(StructuralIndex::Variant::SSE2)) << "Every x86-64 machine has SSE2";
+#endif
+}
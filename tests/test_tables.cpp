@@ -1,6 +1,8 @@
 #include "tables.hpp"
 #include "data_objects.hpp"
 
+#include "compare_tables.hpp"
+
 #include "records.hpp"
 #include "parameterise_description.hpp"
 
@@ -8,12 +10,6 @@
 
 namespace
 {
-class TablesForTest : public Tables
-{
-public:
-    const std::map<unsigned int, Citizen>& get_citizen_table() { return m_citizen; };
-};
-
 const std::string Elijah_compact(R"({"id":600002,"name":"Elijah","city":"Palm Springs","age":43,)"
                                     R"("friends":[{"name":"Charlotte","hobbies":["Reading"]}]})");
 const std::string Elijah_compact_no_id(R"({"name":"Elijah","city":"Palm Springs","age":43,)"
@@ -165,3 +161,202 @@ TEST(TestTable, TestResults)
     // Most Common Hobby of all friends of users in all cities
     ASSERT_EQ(results.most_common_hobby, "Reading") << "The most common hobby was not determined correctly";
 }
+
+namespace
+{
+/**
+ * \brief Adds every record in the string to the tables
+*/
+void add_records(Tables& tables, std::string&& records)
+{
+    DataObjects data_objects(std::move(records));
+    auto rapidjson_result = data_objects.get_next_object();
+    while (rapidjson_result != nullptr)
+    {
+        tables.add_record(rapidjson_result);
+        rapidjson_result = data_objects.get_next_object();
+    }
+    ASSERT_EQ(data_objects.get_error(), DataObjects::ErrorType::NONE) << "This test json string is ill formatted";
+}
+
+const std::string Elijah_moved(R"({"id":600002,"name":"Elijah","city":"Washington","age":44,)"
+                                    R"("friends":[{"name":"Charlotte","hobbies":["Golf"]},{"name":"Nora","hobbies":["Golf"]},)"
+                                    R"({"name":"Luke","hobbies":["Golf"]}]})");
+} // namespace
+
+TEST(TestTable, TestUpdateMatchesRebuild)
+{
+    const std::string first_response = Elijah_compact + "\n" + Barry_compact + "\n" +
+                                       Paul_compact_no_id + "\n" + John_compact_no_id;
+    const std::string second_response = Elijah_moved + "\n" + Barry_compact + "\n" +
+                                         John_of_vegas_no_id;
+
+    TablesForTest CUT;
+    CUT.begin_update();
+    add_records(CUT, std::string(first_response));
+    CUT.end_update();
+    CUT.begin_update();
+    add_records(CUT, std::string(second_response));
+    CUT.end_update();
+
+    Tables rebuilt;
+    add_records(rebuilt, std::string(second_response));
+
+    check_same_results(CUT.query_results(), rebuilt.query_results());
+    ASSERT_EQ(CUT.get_citizen_table().size(), 3) << "Citizens missing from the latest response were not removed";
+
+    auto results = CUT.query_results();
+    ASSERT_EQ(results.cities.size(), 2) << "The city left empty by the update was not removed";
+    ASSERT_EQ(results.most_common_hobby, "Golf") << "Hobbies of replaced citizens were not updated";
+
+    // Citizens with as many friends as each other, unchanged but in a different order, one of them replaced and one repeated
+    const std::string Adam(R"({"id":1,"name":"Adam","city":"Austin","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    const std::string Barry(R"({"id":2,"name":"Barry","city":"Austin","age":40,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    const std::string Carl(R"({"id":3,"name":"Carl","city":"Boston","age":50,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    const std::string Carl_older(R"({"id":3,"name":"Carl","city":"Boston","age":51,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    const std::string Dora(R"({"id":4,"name":"Dora","city":"Boston","age":20,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    const std::string tied_response = Adam + "\n" + Barry + "\n" + Carl + "\n" + Dora;
+    const std::string reordered_response = Barry + "\n" + Adam + "\n" + Dora + "\n" + Carl_older + "\n" + Barry;
+
+    TablesForTest tied;
+    tied.begin_update();
+    add_records(tied, std::string(tied_response));
+    tied.end_update();
+    tied.begin_update();
+    add_records(tied, std::string(reordered_response));
+    tied.end_update();
+
+    Tables reordered;
+    add_records(reordered, std::string(reordered_response));
+
+    check_same_results(tied.query_results(), reordered.query_results());
+    results = tied.query_results();
+    ASSERT_EQ(results.cities.size(), 2u);
+    EXPECT_EQ(results.cities[0].user_with_most_friends, "Barry") << "The tie went to the first in the previous response";
+    EXPECT_EQ(results.cities[1].user_with_most_friends, "Dora") << "The tie went to the first in the previous response";
+}
+
+TEST(TestTable, TestDuplicateIdReplacesRecord)
+{
+    TablesForTest CUT;
+    add_records(CUT, Elijah_compact + "\n" + Elijah_moved);
+
+    Tables expected;
+    add_records(expected, std::string(Elijah_moved));
+
+    check_same_results(CUT.query_results(), expected.query_results());
+    ASSERT_EQ(CUT.get_citizen_table().size(), 1) << "The record did not replace the one with the same id";
+}
+
+TEST(TestTable, TestResultsInAlphabeticalOrder)
+{
+    // The strings are interned in reverse alphabetical order, but the cities are still listed in
+    // order of name, and ties between names or hobbies still go to the first in alphabetical order
+    const std::string response(R"({"id":1,"name":"Zoe","city":"Zurich","age":30,"friends":[{"name":"Yan","hobbies":["Zumba"]}]})"
+                               "\n"
+                               R"({"id":2,"name":"Adam","city":"Austin","age":40,"friends":[{"name":"Yan","hobbies":["Archery"]}]})");
+    TablesForTest CUT;
+    add_records(CUT, std::string(response));
+
+    const auto results = CUT.query_results();
+    ASSERT_EQ(results.cities.size(), 2u);
+    EXPECT_EQ(results.cities[0].city_name, "Austin");
+    EXPECT_EQ(results.cities[0].user_with_most_friends, "Adam");
+    EXPECT_EQ(results.cities[1].city_name, "Zurich");
+    EXPECT_EQ(results.cities[1].user_with_most_friends, "Zoe");
+    EXPECT_EQ(results.most_common_first_name, "Adam");
+    EXPECT_EQ(results.most_common_hobby, "Archery");
+}
+
+TEST(TestTable, TestMostFriendsTieGoesToFirstInResponse)
+{
+    // Adam is added first, but moves away and back, so the record putting him in Austin comes after Barry's
+    const std::string response(R"({"id":1,"name":"Adam","city":"Austin","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]}]})"
+                               "\n"
+                               R"({"id":2,"name":"Barry","city":"Austin","age":40,"friends":[{"name":"Yan","hobbies":["Golf"]}]})"
+                               "\n"
+                               R"({"id":1,"name":"Adam","city":"Boston","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]}]})"
+                               "\n"
+                               R"({"id":1,"name":"Adam","city":"Austin","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]}]})");
+    TablesForTest CUT;
+    add_records(CUT, std::string(response));
+
+    const auto results = CUT.query_results();
+    ASSERT_EQ(results.cities.size(), 1u) << "The city left empty was not removed";
+    EXPECT_EQ(results.cities[0].user_with_most_friends, "Barry");
+}
+
+TEST(TestTable, TestQueryFindsStaleCitiesOnce)
+{
+    // Without updates, the user with most friends losing friends leaves the city stale until a query finds the next one
+    const std::string response(R"({"id":1,"name":"Adam","city":"Austin","age":30,"friends":[{"name":"Yan","hobbies":["Golf"]},{"name":"Yan","hobbies":["Golf"]}]})"
+                               "\n"
+                               R"({"id":2,"name":"Barry","city":"Austin","age":40,"friends":[{"name":"Yan","hobbies":["Golf"]}]})"
+                               "\n"
+                               R"({"id":1,"name":"Adam","city":"Austin","age":30,"friends":[]})");
+    TablesForTest CUT;
+    add_records(CUT, std::string(response));
+    ASSERT_TRUE(CUT.has_stale_cities());
+
+    auto results = CUT.query_results();
+    ASSERT_EQ(results.cities.size(), 1u);
+    EXPECT_EQ(results.cities[0].user_with_most_friends, "Barry");
+    EXPECT_FALSE(CUT.has_stale_cities()) << "The query left the city stale, to be searched for by every query";
+    check_same_results(CUT.query_results(), CUT.results_from_citizens());
+
+    add_records(CUT, std::string(R"({"id":3,"name":"Carl","city":"Austin","age":50,"friends":[]})"));
+    EXPECT_FALSE(CUT.has_stale_cities());
+    check_same_results(CUT.partial_results().get_results(), CUT.results_from_citizens());
+}
+
+TEST(TestTable, TestTotalsMatchCitizens)
+{
+    RecordGenerator generator;
+    TablesForTest CUT;
+    for (int i_update = 0; i_update < 20; i_update++)
+    {
+        CUT.begin_update();
+        std::vector<Record> batch;
+        for (int i_record = 0; i_record < 40; i_record++)
+        {
+            batch.push_back(generator.generate());
+        }
+        CUT.add_records(batch.data(), batch.size());
+        for (int i_record = 0; i_record < 10; i_record++)
+        {
+            CUT.add_record(generator.generate());
+        }
+        CUT.end_update();
+        check_same_results(CUT.query_results(), CUT.results_from_citizens());
+
+        // Records replacing citizens outside of an update
+        for (int i_record = 0; i_record < 5; i_record++)
+        {
+            CUT.add_record(generator.generate());
+        }
+        check_same_results(CUT.query_results(), CUT.results_from_citizens());
+    }
+}
+
+TEST(TestTable, TestSearchOnThreadsMatchesSerial)
+{
+    // A range of a single row for each thread, so every search is split
+    RecordGenerator generator;
+    TablesForTest CUT;
+    CUT.set_search_threads(4, 1);
+    for (int i_update = 0; i_update < 20; i_update++)
+    {
+        CUT.begin_update();
+        for (int i_record = 0; i_record < 40; i_record++)
+        {
+            CUT.add_record(generator.generate());
+            if (i_record % 10 == 9)
+            {
+                // Query during the update, while cities can still be stale
+                check_same_results(CUT.query_results(), CUT.results_from_citizens());
+            }
+        }
+        CUT.end_update();
+        check_same_results(CUT.query_results(), CUT.results_from_citizens());
+    }
+}